@@ -0,0 +1,177 @@
+/*	Display backlight control
+
+	Drives the display backlight LED with hardware PWM without starting subprocesses.
+	Uses the kernel PWM interface (/sys/class/pwm, requires dtoverlay=pwm) when available, otherwise wiringPi hardware PWM (memory-mapped registers).
+	Brightness changes may fade smoothly, stepped by a timer that is waited on by the main event loop.
+	Define GPIO_NO_WIRINGPI to build without wiringPi fallback.
+*/
+
+#pragma once
+
+#include "eventloop.hpp"
+#include <cstdio> // provides snprintf
+#include <string> // provides std::string
+#include <fcntl.h> // provides open
+#include <unistd.h> // provides write, close, pwrite
+#ifndef GPIO_NO_WIRINGPI
+#include <wiringPi.h> // provides pwmWrite
+#endif
+
+#define BACKLIGHT_PWM_CHIP "/sys/class/pwm/pwmchip0" // Kernel PWM controller
+#define BACKLIGHT_PWM_PERIOD 200000 // PWM period in ns (5kHz)
+#define BACKLIGHT_WIRINGPI_RANGE 1024 // Default wiringPi PWM range
+#define BACKLIGHT_FADE_STEP_MS 20 // Time between fade steps
+
+/**	Backlight class sets display brightness through hardware PWM */
+class Backlight
+{
+public:
+    ~Backlight()
+    {
+        if(m_nDutyFd >= 0)
+            close(m_nDutyFd);
+    }
+
+    /**	Configure PWM output
+    *	@param	nChannel Kernel PWM channel (PWM0 is GPIO 12 or 18, PWM1 is GPIO 13 or 19)
+    *	@param	nGpio GPIO (BCM) number used if kernel PWM is unavailable
+    *	@retval	bool True if backlight can be controlled
+    */
+    bool Open(unsigned int nChannel, unsigned int nGpio)
+    {
+        std::string sChannel = std::string(BACKLIGHT_PWM_CHIP) + "/pwm" + std::to_string(nChannel);
+        if(access(sChannel.c_str(), F_OK) != 0)
+        {
+            WriteFile(std::string(BACKLIGHT_PWM_CHIP) + "/export", std::to_string(nChannel));
+            for(unsigned int nRetry = 0; nRetry < 20 && access((sChannel + "/duty_cycle").c_str(), W_OK) != 0; ++nRetry)
+                usleep(5000); // udev sets permissions after export
+        }
+        WriteFile(sChannel + "/duty_cycle", "0"); // Duty cycle must not exceed period whilst period is set
+        if(WriteFile(sChannel + "/period", std::to_string(BACKLIGHT_PWM_PERIOD)) && WriteFile(sChannel + "/enable", "1"))
+            m_nDutyFd = open((sChannel + "/duty_cycle").c_str(), O_WRONLY | O_CLOEXEC);
+        if(m_nDutyFd >= 0)
+        {
+            m_sBackend = "kernel pwm" + std::to_string(nChannel);
+            Write(m_nLevel);
+            return true;
+        }
+#ifndef GPIO_NO_WIRINGPI
+        // wiringPi must already be set up with BCM numbering (wiringPiSetupGpio)
+        pinMode(nGpio, PWM_OUTPUT);
+        m_nGpio = nGpio;
+        m_sBackend = "wiringPi gpio" + std::to_string(nGpio);
+        Write(m_nLevel);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**	Get name of interface used to drive backlight
+    *	@retval	string Description of backend or empty if not open
+    */
+    std::string GetBackend()
+    {
+        return m_sBackend;
+    }
+
+    /**	Set brightness
+    *	@param	nLevel Brightness in percent [0..100]
+    *	@param	nFade Duration of fade from current brightness in ms (0 for immediate change)
+    */
+    void Set(unsigned int nLevel, unsigned int nFade = 0)
+    {
+        if(nLevel > 100)
+            nLevel = 100;
+        m_nTarget = nLevel * 10;
+        unsigned int nSteps = nFade / BACKLIGHT_FADE_STEP_MS;
+        if(nSteps < 2 || m_nTarget == m_nLevel)
+        {
+            m_timer.Stop();
+            Write(m_nTarget);
+            return;
+        }
+        int nDistance = (int)m_nTarget - (int)m_nLevel;
+        m_nStep = nDistance / (int)nSteps;
+        if(!m_nStep)
+            m_nStep = (nDistance > 0) ? 1 : -1;
+        if(!m_timer.IsRunning())
+            m_timer.Start(BACKLIGHT_FADE_STEP_MS, true);
+    }
+
+    /**	Get brightness being faded to (or current brightness if not fading)
+    *	@retval	unsigned int Brightness in percent [0..100]
+    */
+    unsigned int Get()
+    {
+        return m_nTarget / 10;
+    }
+
+    /**	Check if a fade is in progress
+    *	@retval	bool True if fading
+    */
+    bool IsFading()
+    {
+        return m_timer.IsRunning();
+    }
+
+    /**	Step fade - call when file descriptor from GetFd is readable */
+    void Process()
+    {
+        m_timer.Clear();
+        int nLevel = (int)m_nLevel + m_nStep;
+        if((m_nStep > 0 && nLevel >= (int)m_nTarget) || (m_nStep < 0 && nLevel <= (int)m_nTarget))
+        {
+            m_timer.Stop();
+            nLevel = m_nTarget;
+        }
+        Write(nLevel);
+    }
+
+    /**	Get file descriptor that becomes readable when a fade step is due */
+    int GetFd()
+    {
+        return m_timer.GetFd();
+    }
+
+private:
+    /**	Write brightness to hardware
+    *	@param	nLevel Brightness in tenths of a percent [0..1000]
+    */
+    void Write(unsigned int nLevel)
+    {
+        m_nLevel = nLevel;
+        if(m_nDutyFd >= 0)
+        {
+            char sDuty[16];
+            int nLen = snprintf(sDuty, sizeof(sDuty), "%u", (unsigned int)((uint64_t)BACKLIGHT_PWM_PERIOD * nLevel / 1000));
+            if(pwrite(m_nDutyFd, sDuty, nLen, 0) != nLen)
+                return;
+        }
+#ifndef GPIO_NO_WIRINGPI
+        else if(m_nGpio >= 0)
+            pwmWrite(m_nGpio, nLevel * BACKLIGHT_WIRINGPI_RANGE / 1000);
+#endif
+    }
+
+    /**	Write a value to a sysfs file
+    *	@retval	bool True on success
+    */
+    bool WriteFile(std::string sPath, std::string sValue)
+    {
+        int nFd = open(sPath.c_str(), O_WRONLY | O_CLOEXEC);
+        if(nFd < 0)
+            return false;
+        bool bOk = write(nFd, sValue.c_str(), sValue.length()) == (ssize_t)sValue.length();
+        close(nFd);
+        return bOk;
+    }
+
+    int m_nDutyFd = -1; // Kernel PWM duty_cycle file (-1 if not using kernel PWM)
+    int m_nGpio = -1; // GPIO driven by wiringPi PWM (-1 if not using wiringPi)
+    std::string m_sBackend; // Description of interface driving backlight
+    unsigned int m_nLevel = 1000; // Current brightness in tenths of a percent
+    unsigned int m_nTarget = 1000; // Brightness being faded to in tenths of a percent
+    int m_nStep = 0; // Change in brightness per fade step in tenths of a percent
+    Timer m_timer; // Steps fade
+};
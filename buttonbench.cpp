@@ -0,0 +1,196 @@
+/*	Button handler benchmark - riban 2020 <brian@riban.co.uk>
+
+	Drives ButtonHandler from a SimulatedGpio with scripted, bouncing edges to check press / release / hold / repeat timing and measure processing cost.
+	Runs on a plain Linux box without GPIO hardware or wiringPi.
+	Usage: buttonbench [iterations]
+	Exits with non-zero status if any scenario produces unexpected events.
+*/
+
+#define GPIO_NO_WIRINGPI
+#include "buttonhandler.hpp"
+#include <cstdlib> // provides atoi
+#include <iostream> // provides cout
+#include <string> // provides std::string
+#include <time.h> // provides clock_gettime
+#include <vector> // provides std::vector
+
+using namespace std;
+
+#define BENCH_BUTTON 4 // GPIO of button under test
+#define BENCH_HOLD_BUTTON 27 // GPIO of button with hold handler
+#define BENCH_BOUNCE_US 300 // Interval between bounce edges
+#define BENCH_BOUNCES 4 // Quantity of bounce edge pairs on each transition
+
+/**	Event recorded by benchmark callbacks */
+struct BenchEvent
+{
+    char type; // 'P' = press, 'R' = release, 'H' = hold
+    unsigned int gpio; // GPIO that triggered event
+    uint64_t time; // Virtual time of event in us
+};
+
+SimulatedGpio g_gpio; // Simulated GPIO backend
+vector<BenchEvent> g_vEvents; // Events recorded since last reset
+
+void onPress(int nGpio)
+{
+    g_vEvents.push_back({'P', (unsigned int)nGpio, g_gpio.Now()});
+}
+
+void onRelease(int nGpio)
+{
+    g_vEvents.push_back({'R', (unsigned int)nGpio, g_gpio.Now()});
+}
+
+void onHold(int nGpio)
+{
+    g_vEvents.push_back({'H', (unsigned int)nGpio, g_gpio.Now()});
+}
+
+/**	Schedule a bouncing transition
+*	@param	nGpio GPIO number
+*	@param	nLevel Final level [0, 1]
+*	@param	nTime Time of first edge in us
+*/
+void injectBouncy(unsigned int nGpio, int nLevel, uint64_t nTime)
+{
+    for(unsigned int nBounce = 0; nBounce < BENCH_BOUNCES; ++nBounce)
+    {
+        g_gpio.Inject(nGpio, nLevel, nTime);
+        nTime += BENCH_BOUNCE_US;
+        g_gpio.Inject(nGpio, 1 - nLevel, nTime);
+        nTime += BENCH_BOUNCE_US;
+    }
+    g_gpio.Inject(nGpio, nLevel, nTime);
+}
+
+/**	Run virtual clock as an event loop would, processing on edges and on handler deadlines
+*	@param	buttonHandler Handler under test
+*	@param	nEnd Time to stop in us
+*	@retval	unsigned int Quantity of Process calls (wakes)
+*/
+unsigned int run(ButtonHandler& buttonHandler, uint64_t nEnd)
+{
+    unsigned int nWakes = 0;
+    while(true)
+    {
+        uint64_t nNext = g_gpio.GetNextEdge();
+        uint64_t nDeadline = buttonHandler.GetDeadline();
+        if(nDeadline && (!nNext || nDeadline < nNext))
+            nNext = nDeadline;
+        if(!nNext || nNext > nEnd)
+            break;
+        if(nNext > g_gpio.Now())
+            g_gpio.SetTime(nNext);
+        buttonHandler.Process();
+        ++nWakes;
+    }
+    g_gpio.SetTime(nEnd);
+    return nWakes;
+}
+
+/**	Compare recorded events with expected sequence
+*	@param	sName Name of scenario
+*	@param	sExpected Expected event types, e.g. "PR"
+*	@param	vTimes Expected time of each event in us
+*	@retval	bool True if events match
+*/
+bool check(string sName, string sExpected, vector<uint64_t> vTimes)
+{
+    string sActual;
+    bool bPass = (g_vEvents.size() == sExpected.size());
+    for(size_t nEvent = 0; nEvent < g_vEvents.size(); ++nEvent)
+    {
+        sActual += g_vEvents[nEvent].type;
+        if(nEvent < vTimes.size() && g_vEvents[nEvent].time != vTimes[nEvent])
+            bPass = false;
+    }
+    if(sActual != sExpected)
+        bPass = false;
+    cout << (bPass ? "PASS " : "FAIL ") << sName << ": expected " << sExpected << " got " << sActual;
+    if(!bPass)
+    {
+        cout << " at";
+        for(auto it = g_vEvents.begin(); it != g_vEvents.end(); ++it)
+            cout << " " << it->time;
+    }
+    cout << endl;
+    g_vEvents.clear();
+    return bPass;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int nIterations = (argc > 1) ? atoi(argv[1]) : 10000;
+    bool bPass = true;
+
+    ButtonHandler buttonHandler(&g_gpio);
+    buttonHandler.AddButton(BENCH_BUTTON, onPress, onRelease);
+    buttonHandler.AddButton(BENCH_HOLD_BUTTON, NULL, onRelease, onHold);
+    buttonHandler.SetRepeatPeriod(BENCH_BUTTON, 100);
+
+    // Bouncy press and release - one press at first edge, one release at first release edge
+    uint64_t nT = 1000000;
+    injectBouncy(BENCH_BUTTON, 0, nT);
+    injectBouncy(BENCH_BUTTON, 1, nT + 200000);
+    run(buttonHandler, nT + 500000);
+    bPass &= check("bounce", "PR", {nT, nT + 200000});
+
+    // Hold with auto-repeat - press, repeat after hold delay then every repeat period
+    nT = 2000000;
+    injectBouncy(BENCH_BUTTON, 0, nT);
+    injectBouncy(BENCH_BUTTON, 1, nT + 1350000);
+    run(buttonHandler, nT + 2000000);
+    bPass &= check("repeat", "PPPPR", {nT, nT + 1100000, nT + 1200000, nT + 1300000, nT + 1350000});
+
+    // Hold handler - hold after hold delay, release not reported after hold
+    nT = 5000000;
+    injectBouncy(BENCH_HOLD_BUTTON, 0, nT);
+    injectBouncy(BENCH_HOLD_BUTTON, 1, nT + 1500000);
+    run(buttonHandler, nT + 2000000);
+    bPass &= check("hold", "H", {nT + 1000000});
+
+    // Short press on hold button - release reported
+    nT = 8000000;
+    injectBouncy(BENCH_HOLD_BUTTON, 0, nT);
+    injectBouncy(BENCH_HOLD_BUTTON, 1, nT + 300000);
+    run(buttonHandler, nT + 1000000);
+    bPass &= check("short", "R", {nT + 300000});
+
+    // Release lands within debounce lockout - reconciled when lockout ends
+    nT = 10000000;
+    g_gpio.Inject(BENCH_BUTTON, 0, nT);
+    g_gpio.Inject(BENCH_BUTTON, 1, nT + 1000);
+    run(buttonHandler, nT + 100000);
+    bPass &= check("glitch", "PR", {nT, nT + BUTTON_DEBOUNCE_US});
+
+    // Throughput - repeated bouncy presses
+    nT = 20000000;
+    unsigned int nWakes = 0;
+    struct timespec tsStart, tsEnd;
+    clock_gettime(CLOCK_MONOTONIC, &tsStart);
+    for(unsigned int nIteration = 0; nIteration < nIterations; ++nIteration)
+    {
+        injectBouncy(BENCH_BUTTON, 0, nT);
+        injectBouncy(BENCH_BUTTON, 1, nT + 20000);
+        nT += 50000;
+        nWakes += run(buttonHandler, nT);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &tsEnd);
+    uint64_t nElapsed = (uint64_t)(tsEnd.tv_sec - tsStart.tv_sec) * 1000000000 + tsEnd.tv_nsec - tsStart.tv_nsec;
+    size_t nPresses = 0;
+    for(auto it = g_vEvents.begin(); it != g_vEvents.end(); ++it)
+        if(it->type == 'P')
+            ++nPresses;
+    g_vEvents.clear();
+    if(nPresses != nIterations)
+    {
+        cout << "FAIL throughput: expected " << nIterations << " presses got " << nPresses << endl;
+        bPass = false;
+    }
+    cout << nIterations << " bouncy press / release cycles (" << nIterations * (BENCH_BOUNCES * 2 + 1) * 2 << " edges) in " << nWakes << " wakes, " << nElapsed / 1000 << "us" << endl;
+    if(nWakes)
+        cout << "Process cost: " << nElapsed / nWakes << "ns per wake" << endl;
+
+    return bPass ? 0 : 1;
+}
@@ -1,14 +1,17 @@
 /*	Raspberry Pi Button Handler - riban 2020 <brian@riban.co.uk>
 
 	Provides handers for button press, release, hold and auto-repeat with associated debounce filters.
-        Depends on wiringPi.
+	GPIO is accessed via a GpioBackend (see gpio.hpp). Edges from the GPIO character device carry kernel timestamps which are debounced by time so that buttons need only be processed on edges and hold / repeat deadlines.
+	Backends that do not report edges (wiringPi) are polled and their level changes are debounced the same way.
 */
 
+#include "gpio.hpp"
 #include <map> // provides std::map
 #include <functional>   // provides std::function
-#include <wiringPi.h> // provides wiringPi gpio functions
 
 #define ALL_BUTTONS -1
+#define BUTTON_DEBOUNCE_US 5000 // Period after an accepted edge during which further edges are ignored (bounce)
+#define BUTTON_POLL_MS 2 // Period between samples when GPIO backend does not report edges
 
 enum
 {
@@ -30,34 +33,66 @@ public:
         m_nHoldDelay(holdDelay),
         m_nState(STATE_RELEASED)
     {
-        pinMode(m_nGpio, INPUT);
-        pullUpDnControl(m_nGpio, PUD_UP);
-        m_nLastPress = millis();
     }
 
-    void Process()
+    /**	Handle a change of GPIO level
+    *	@param	nLevel New level [0=pressed, 1=released]
+    *	@param	nTime Time of edge in us
+    *	@note	Edges within BUTTON_DEBOUNCE_US of the last accepted edge are bounce and are reconciled by Process after the lockout
+    */
+    void OnEdge(int nLevel, uint64_t nTime)
     {
-        m_cDebounce <<=1;
-        m_cDebounce |= digitalRead(m_nGpio);
-        switch(m_nState)
+        if(m_bLockout && nTime < m_nLockoutEnd)
+            return;
+        m_bLockout = false;
+        if(nLevel == m_nLevel)
+            return;
+        m_nLevel = nLevel;
+        m_bLockout = true;
+        m_nLockoutEnd = nTime + BUTTON_DEBOUNCE_US;
+        if(m_nLevel == 0)
         {
-        case STATE_RELEASED:
-            if(m_cDebounce == 0x80)
+            if(m_nState == STATE_RELEASED)
             {
                 m_nState = STATE_PRESSED;
-                m_nLastPress = millis();
+                m_nLastPress = nTime;
                 if(m_fnOnPress) m_fnOnPress(m_nGpio);
             }
+            return;
+        }
+        switch(m_nState)
+        {
+        case STATE_PRESSED:
+        case STATE_REPEAT:
+            m_nState = STATE_RELEASED;
+            if(m_fnOnRelease) m_fnOnRelease(m_nGpio);
             break;
+        case STATE_HELD:
+            m_nState = STATE_RELEASED;
+            break;
+        }
+    }
+
+    /**	Process debounce lockout expiry, hold and auto-repeat
+    *	@param	pGpio Pointer to GPIO backend used to read level after lockout
+    *	@param	nNow Current time in us
+    */
+    void Process(GpioBackend* pGpio, uint64_t nNow)
+    {
+        if(m_bLockout && nNow >= m_nLockoutEnd)
+        {
+            // Level may have changed during lockout without a subsequent edge
+            m_bLockout = false;
+            int nLevel = pGpio->Read(m_nGpio);
+            if(nLevel != m_nLevel)
+                OnEdge(nLevel, nNow);
+        }
+        switch(m_nState)
+        {
         case STATE_PRESSED:
-            if(m_cDebounce == 0x7F)
+            if(nNow - m_nLastPress >= (uint64_t)m_nHoldDelay * 1000)
             {
-                m_nState = STATE_RELEASED;
-                if(m_fnOnRelease) m_fnOnRelease(m_nGpio);
-            }
-            else if(millis() - m_nLastPress > m_nHoldDelay)
-            {
-                m_nLastPress = millis();
+                m_nLastPress += (uint64_t)m_nHoldDelay * 1000;
                 if(m_fnOnHold)
                 {
                     m_nState = STATE_HELD;
@@ -69,27 +104,41 @@ public:
                 }
             }
             break;
-        case STATE_HELD:
-            if(m_cDebounce == 0x7F)
-            {
-                m_nState = STATE_RELEASED;
-            }
-            break;
         case STATE_REPEAT:
-            if(m_cDebounce == 0x7F)
-            {
-                m_nState = STATE_RELEASED;
-                if(m_fnOnRelease) m_fnOnRelease(m_nGpio);
-            }
-            else if(m_nRepeatPeriod && (millis() - m_nLastPress > m_nRepeatPeriod))
+            if(m_nRepeatPeriod && (nNow - m_nLastPress >= (uint64_t)m_nRepeatPeriod * 1000))
             {
-                m_nLastPress = millis();
+                m_nLastPress += (uint64_t)m_nRepeatPeriod * 1000;
+                if(nNow - m_nLastPress >= (uint64_t)m_nRepeatPeriod * 1000)
+                    m_nLastPress = nNow; // Late - do not burst to catch up
                 if(m_fnOnPress) m_fnOnPress(m_nGpio);
             }
             break;
         }
     }
 
+    /**	Get time that Process next needs to be called
+    *	@retval	uint64_t Time in us or 0 if button is idle (waiting for edge)
+    */
+    uint64_t GetDeadline()
+    {
+        uint64_t nDeadline = 0;
+        if(m_nState == STATE_PRESSED)
+            nDeadline = m_nLastPress + (uint64_t)m_nHoldDelay * 1000;
+        else if(m_nState == STATE_REPEAT && m_nRepeatPeriod)
+            nDeadline = m_nLastPress + (uint64_t)m_nRepeatPeriod * 1000;
+        if(m_bLockout && (!nDeadline || m_nLockoutEnd < nDeadline))
+            nDeadline = m_nLockoutEnd;
+        return nDeadline;
+    }
+
+    /**	Get debounced level
+    *	@retval	int Level [0=pressed, 1=released]
+    */
+    int GetLevel()
+    {
+        return m_nLevel;
+    }
+
     /**	Set the delay before hold event or auto repeat triggers
     *	@param	delay Delay in ms
     */
@@ -111,8 +160,10 @@ private:
     std::function<void(int)> m_fnOnHold = 0; // Function called when button held
     unsigned int m_nHoldDelay = 1000; // Duration in ms for onHold trigger
     unsigned int m_nRepeatPeriod = 0; // Period between each auto-repeat - zero to disable auto-repeat
-    unsigned int m_nLastPress; // Time of last button press
-    unsigned char m_cDebounce = 0x7f; // Button debounce filter state
+    uint64_t m_nLastPress = 0; // Time of last button press (or hold / repeat trigger) in us
+    int m_nLevel = 1; // Debounced GPIO level [0=pressed, 1=released]
+    bool m_bLockout = false; // True whilst ignoring bounce after an accepted edge
+    uint64_t m_nLockoutEnd = 0; // Time that debounce lockout ends in us
     unsigned int m_nState = STATE_RELEASED; // Current state of button
 };
 
@@ -121,29 +172,98 @@ class ButtonHandler
 {
 public:
     /**	Instantiate handler
+    *	@param	pGpio Pointer to GPIO backend [Default: NULL to use GPIO character device or wiringPi if unavailable]
     	@note Call wiringPiSetupGpio() before creating an instance of ButtonHandler
+    	@note Caller retains ownership of pGpio which must remain valid for lifetime of ButtonHandler
     */
-    ButtonHandler()
+    ButtonHandler(GpioBackend* pGpio = NULL) :
+        m_pGpio(pGpio)
     {
+        if(m_pGpio)
+            return;
+        ChardevGpio* pChardev = new ChardevGpio();
+#ifndef GPIO_NO_WIRINGPI
+        if(!pChardev->IsOpen())
+        {
+            delete pChardev;
+            m_pGpio = new WiringPiGpio();
+            m_bOwnGpio = true;
+            return;
+        }
+#endif
+        m_pGpio = pChardev;
+        m_bOwnGpio = true;
     }
 
-    /**	Destructor cleans up when ButtonHandler object is deleted
-            ~ButtonHandler()
+    /**	Destructor cleans up when ButtonHandler object is deleted */
+    ~ButtonHandler()
     {
-    		for(auto it = m_mapButtons.begin(); it!= m_mapButtons.end(); ++it)
-    			delete it->second;
+        for(auto it = m_mapButtons.begin(); it!= m_mapButtons.end(); ++it)
+            delete it->second;
+        if(m_bOwnGpio)
+            delete m_pGpio;
     }
 
-    /**	Call Process() rapidly (approx. every 10ms) */
+    /**	Handle pending edges and timed events
+    *	@note	Call when GetFd() is readable and after GetTimeout() expires, or rapidly (approx. every 10ms)
+    */
     void Process()
     {
-        //!@todo Create thread to run process loop
+        GpioEdge edge;
+        while(m_pGpio->GetEdge(edge))
+        {
+            auto it = m_mapButtons.find(edge.gpio);
+            if(it != m_mapButtons.end())
+                it->second->OnEdge(edge.level, edge.time);
+        }
+        uint64_t nNow = m_pGpio->Now();
         for(auto it = m_mapButtons.begin(); it!= m_mapButtons.end(); ++it)
         {
-            it->second->Process();
+            if(m_pGpio->GetFd() < 0)
+                it->second->OnEdge(m_pGpio->Read(it->first), nNow); // Backend does not report edges so sample level
+            it->second->Process(m_pGpio, nNow);
         }
     }
 
+    /**	Get file descriptor that becomes readable when button edges are pending
+    *	@retval	int File descriptor or -1 if backend must be polled
+    */
+    int GetFd()
+    {
+        return m_pGpio->GetFd();
+    }
+
+    /**	Get time until Process next needs to be called (other than on edges)
+    *	@retval	int Timeout in ms or -1 if buttons are idle
+    */
+    int GetTimeout()
+    {
+        if(m_pGpio->GetFd() < 0)
+            return BUTTON_POLL_MS;
+        uint64_t nDeadline = GetDeadline();
+        if(!nDeadline)
+            return -1;
+        uint64_t nNow = m_pGpio->Now();
+        if(nDeadline <= nNow)
+            return 0;
+        return (nDeadline - nNow + 999) / 1000;
+    }
+
+    /**	Get time that Process next needs to be called (other than on edges)
+    *	@retval	uint64_t Time in us (GpioBackend::Now clock) or 0 if buttons are idle
+    */
+    uint64_t GetDeadline()
+    {
+        uint64_t nDeadline = 0;
+        for(auto it = m_mapButtons.begin(); it!= m_mapButtons.end(); ++it)
+        {
+            uint64_t nButtonDeadline = it->second->GetDeadline();
+            if(nButtonDeadline && (!nDeadline || nButtonDeadline < nDeadline))
+                nDeadline = nButtonDeadline;
+        }
+        return nDeadline;
+    }
+
     /**	Add a button to the handler
     *	@param gpio GPIO pin number
     *	@param onPress Name of function to call when button is pressed (also triggered by auto repeat)
@@ -155,6 +275,19 @@ public:
         auto it = m_mapButtons.find(gpio);
         if(it != m_mapButtons.end())
             delete it->second;
+#ifndef GPIO_NO_WIRINGPI
+        if(!m_pGpio->AddInput(gpio) && m_bOwnGpio && m_pGpio->GetFd() >= 0)
+        {
+            // GPIO character device cannot provide line events (e.g. line in use) so fall back to polling all buttons
+            delete m_pGpio;
+            m_pGpio = new WiringPiGpio();
+            for(auto itButton = m_mapButtons.begin(); itButton != m_mapButtons.end(); ++itButton)
+                m_pGpio->AddInput(itButton->first);
+            m_pGpio->AddInput(gpio);
+        }
+#else
+        m_pGpio->AddInput(gpio);
+#endif
         m_mapButtons[gpio] = new Button(gpio, onPress, onRelease, onHold);
     }
 
@@ -197,5 +330,7 @@ public:
 
 private:
     std::map<unsigned int, Button*> m_mapButtons;
+    GpioBackend* m_pGpio = NULL; // GPIO backend
+    bool m_bOwnGpio = false; // True if handler created (and must delete) GPIO backend
 };
 
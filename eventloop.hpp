@@ -0,0 +1,243 @@
+/*	Event loop
+
+	Waits on file descriptors with epoll and dispatches a handler for each that becomes ready so that the UI thread sleeps until there is work to do.
+	Timer wraps timerfd for timeouts, Notifier wraps eventfd to wake the loop from other threads and signals are received via signalfd.
+*/
+
+#pragma once
+
+#include <atomic> // provides std::atomic
+#include <cerrno> // provides errno
+#include <cstdint> // provides uint64_t
+#include <functional> // provides std::function
+#include <map> // provides std::map
+#include <vector> // provides std::vector
+#include <csignal> // provides sigset_t
+#include <pthread.h> // provides pthread_sigmask
+#include <unistd.h> // provides read, write, close
+#include <sys/epoll.h> // provides epoll
+#include <sys/eventfd.h> // provides eventfd
+#include <sys/signalfd.h> // provides signalfd
+#include <sys/timerfd.h> // provides timerfd
+
+#define EVENT_LOOP_MAX_EVENTS 16 // Maximum quantity of events dispatched per wait
+
+/**	Timer class provides a one-shot or periodic timer that may be waited on by EventLoop */
+class Timer
+{
+public:
+    Timer()
+    {
+        m_nFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    }
+
+    ~Timer()
+    {
+        if(m_nFd >= 0)
+            close(m_nFd);
+    }
+
+    /**	Start (or restart) the timer
+    *	@param	nPeriod Time until timer expires in ms
+    *	@param	bRepeat True to repeat every period, false for one-shot
+    */
+    void Start(unsigned int nPeriod, bool bRepeat = false)
+    {
+        struct itimerspec spec = {};
+        spec.it_value.tv_sec = nPeriod / 1000;
+        spec.it_value.tv_nsec = (nPeriod % 1000) * 1000000;
+        if(!nPeriod)
+            spec.it_value.tv_nsec = 1; // Zero would disarm
+        if(bRepeat)
+            spec.it_interval = spec.it_value;
+        timerfd_settime(m_nFd, 0, &spec, NULL);
+        m_bRunning = true;
+    }
+
+    /**	Stop the timer */
+    void Stop()
+    {
+        struct itimerspec spec = {};
+        timerfd_settime(m_nFd, 0, &spec, NULL);
+        Clear();
+        m_bRunning = false;
+    }
+
+    /**	Check if timer is armed
+    *	@retval	bool True if started and not stopped (one-shot timers remain running until cleared)
+    */
+    bool IsRunning()
+    {
+        return m_bRunning;
+    }
+
+    /**	Clear expiry - call from handler
+    *	@retval	unsigned int Quantity of expiries since last clear
+    */
+    unsigned int Clear()
+    {
+        uint64_t nCount = 0;
+        if(read(m_nFd, &nCount, sizeof(nCount)) != sizeof(nCount))
+            return 0;
+        struct itimerspec spec;
+        if(timerfd_gettime(m_nFd, &spec) == 0 && !spec.it_interval.tv_sec && !spec.it_interval.tv_nsec && !spec.it_value.tv_sec && !spec.it_value.tv_nsec)
+            m_bRunning = false; // One-shot has expired
+        return nCount;
+    }
+
+    /**	Get file descriptor to wait on */
+    int GetFd()
+    {
+        return m_nFd;
+    }
+
+private:
+    int m_nFd = -1; // timerfd file descriptor
+    bool m_bRunning = false; // True whilst timer is armed
+};
+
+/**	Notifier class wakes EventLoop from another thread
+*	@note	Repeated notifications before the loop clears the notifier result in a single wake
+*/
+class Notifier
+{
+public:
+    Notifier()
+    {
+        m_nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~Notifier()
+    {
+        if(m_nFd >= 0)
+            close(m_nFd);
+    }
+
+    /**	Wake the event loop - may be called from any thread */
+    void Notify()
+    {
+        if(m_bPending.exchange(true, std::memory_order_acq_rel))
+            return;
+        uint64_t nValue = 1;
+        if(write(m_nFd, &nValue, sizeof(nValue)) != sizeof(nValue))
+            m_bPending = false;
+    }
+
+    /**	Clear notification - call from handler before processing the work that was notified */
+    void Clear()
+    {
+        uint64_t nValue;
+        m_bPending.store(false, std::memory_order_release);
+        if(read(m_nFd, &nValue, sizeof(nValue)) != sizeof(nValue))
+            return;
+    }
+
+    /**	Get file descriptor to wait on */
+    int GetFd()
+    {
+        return m_nFd;
+    }
+
+private:
+    int m_nFd = -1; // eventfd file descriptor
+    std::atomic<bool> m_bPending = {false}; // True when notified but not yet cleared
+};
+
+/**	EventLoop class dispatches handlers when file descriptors become ready */
+class EventLoop
+{
+public:
+    EventLoop()
+    {
+        m_nFd = epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    ~EventLoop()
+    {
+        if(m_nSignalFd >= 0)
+            close(m_nSignalFd);
+        if(m_nFd >= 0)
+            close(m_nFd);
+    }
+
+    /**	Add a file descriptor to the loop
+    *	@param	nFd File descriptor
+    *	@param	fnHandler Function to call when file descriptor is ready
+    *	@param	nEvents epoll events to wait for [Default: EPOLLIN]
+    *	@retval	bool True on success
+    */
+    bool Add(int nFd, std::function<void()> fnHandler, uint32_t nEvents = EPOLLIN)
+    {
+        if(nFd < 0)
+            return false;
+        struct epoll_event event = {};
+        event.events = nEvents;
+        event.data.fd = nFd;
+        int nOp = m_mapHandlers.count(nFd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if(epoll_ctl(m_nFd, nOp, nFd, &event) != 0)
+            return false;
+        m_mapHandlers[nFd] = fnHandler;
+        return true;
+    }
+
+    /**	Remove a file descriptor from the loop
+    *	@param	nFd File descriptor
+    */
+    void Remove(int nFd)
+    {
+        if(!m_mapHandlers.erase(nFd))
+            return;
+        epoll_ctl(m_nFd, EPOLL_CTL_DEL, nFd, NULL);
+    }
+
+    /**	Receive signals via the loop instead of asynchronous handlers
+    *	@param	vSignals List of signals to handle
+    *	@param	fnHandler Function to call with signal number
+    *	@retval	bool True on success
+    *	@note	Call before creating other threads so that they inherit the blocked signal mask
+    */
+    bool AddSignals(const std::vector<int>& vSignals, std::function<void(int)> fnHandler)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for(auto it = vSignals.begin(); it != vSignals.end(); ++it)
+            sigaddset(&mask, *it);
+        if(pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0)
+            return false;
+        m_nSignalFd = signalfd(m_nSignalFd, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if(m_nSignalFd < 0)
+            return false;
+        int nFd = m_nSignalFd;
+        return Add(nFd, [nFd, fnHandler]() {
+            struct signalfd_siginfo info;
+            while(read(nFd, &info, sizeof(info)) == sizeof(info))
+                fnHandler(info.ssi_signo);
+        });
+    }
+
+    /**	Wait for events and dispatch their handlers
+    *	@param	nTimeout Maximum time to wait in ms or -1 to wait indefinitely
+    *	@retval	int Quantity of handlers called, 0 on timeout, -1 on error
+    */
+    int Wait(int nTimeout = -1)
+    {
+        struct epoll_event aEvents[EVENT_LOOP_MAX_EVENTS];
+        int nCount = epoll_wait(m_nFd, aEvents, EVENT_LOOP_MAX_EVENTS, nTimeout);
+        if(nCount < 0)
+            return (errno == EINTR) ? 0 : -1;
+        for(int nEvent = 0; nEvent < nCount; ++nEvent)
+        {
+            auto it = m_mapHandlers.find(aEvents[nEvent].data.fd);
+            if(it == m_mapHandlers.end() || !it->second)
+                continue;
+            std::function<void()> fnHandler = it->second; // Copy as handler may remove itself
+            fnHandler();
+        }
+        return nCount;
+    }
+
+private:
+    int m_nFd = -1; // epoll file descriptor
+    int m_nSignalFd = -1; // signalfd file descriptor
+    std::map<int, std::function<void()>> m_mapHandlers; // Handlers indexed by file descriptor
+};
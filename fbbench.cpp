@@ -0,0 +1,201 @@
+/*	Framebuffer kernel benchmark - riban 2020 <brian@riban.co.uk>
+
+	Compares per-pixel drawing (as ribanfblib plots each pixel) with the plain C++ and vector (NEON / SSE2) kernels in fbkernels.hpp.
+	Draws into an in-memory RGB565 buffer the size of the fluidbox display so it runs on any Linux box without a framebuffer.
+	Usage: fbbench [iterations]
+	Exits with non-zero status if the kernels do not produce the same pixels as per-pixel drawing.
+*/
+
+#include "fbkernels.hpp"
+#include <cstdlib> // provides atoi, rand
+#include <cstring> // provides memcmp, memset
+#include <functional> // provides std::function
+#include <iostream> // provides cout
+#include <string> // provides std::string
+#include <time.h> // provides clock_gettime
+#include <vector> // provides std::vector
+
+using namespace std;
+
+#define BENCH_WIDTH 160 // Display width in pixels
+#define BENCH_HEIGHT 128 // Display height in pixels
+#define BENCH_STRIDE (BENCH_WIDTH * 2) // Bytes per display row
+#define BENCH_CHECKS 1000 // Quantity of random rectangles used to check kernels
+
+vector<uint8_t> g_vScreen(BENCH_STRIDE * BENCH_HEIGHT); // Simulated framebuffer
+vector<uint8_t> g_vBitmap24(BENCH_WIDTH * 3 * BENCH_HEIGHT); // Bitmap as loaded from file (BGR)
+vector<uint8_t> g_vBitmap16(BENCH_STRIDE * BENCH_HEIGHT); // Bitmap converted to framebuffer format
+
+/**	Get RGB565 pixel from 24-bit RGB colour */
+uint16_t pack(uint32_t nColour)
+{
+    return ((nColour >> 8) & 0xF800) | ((nColour >> 5) & 0x07E0) | ((nColour >> 3) & 0x001F);
+}
+
+/**	Draw a pixel as a per-pixel graphics library would - bounds check, colour conversion and address calculation for every pixel */
+__attribute__((noinline)) void drawPixel(int nX, int nY, uint32_t nColour)
+{
+    if(nX < 0 || nY < 0 || nX >= BENCH_WIDTH || nY >= BENCH_HEIGHT)
+        return;
+    *(uint16_t*)(g_vScreen.data() + nY * BENCH_STRIDE + nX * 2) = pack(nColour);
+}
+
+/**	Fill rectangle pixel by pixel (inclusive coordinates) */
+void fillPerPixel(int nX1, int nY1, int nX2, int nY2, uint32_t nColour)
+{
+    for(int nY = nY1; nY <= nY2; ++nY)
+        for(int nX = nX1; nX <= nX2; ++nX)
+            drawPixel(nX, nY, nColour);
+}
+
+/**	Fill rectangle with a kernel (inclusive coordinates) */
+void fillKernel(int nX1, int nY1, int nX2, int nY2, uint32_t nColour, bool bVector)
+{
+    uint8_t* pDst = g_vScreen.data() + nY1 * BENCH_STRIDE + nX1 * 2;
+    uint32_t nPattern = fbPattern(pack(nColour), 16);
+    if(bVector)
+        fbFill(pDst, BENCH_STRIDE, (nX2 - nX1 + 1) * 2, nY2 - nY1 + 1, nPattern);
+    else
+        fbFillScalar(pDst, BENCH_STRIDE, (nX2 - nX1 + 1) * 2, nY2 - nY1 + 1, nPattern);
+}
+
+/**	Draw 24-bit bitmap pixel by pixel */
+void blitPerPixel()
+{
+    const uint8_t* pSrc = g_vBitmap24.data();
+    for(int nY = 0; nY < BENCH_HEIGHT; ++nY)
+        for(int nX = 0; nX < BENCH_WIDTH; ++nX, pSrc += 3)
+            drawPixel(nX, nY, pSrc[2] << 16 | pSrc[1] << 8 | pSrc[0]);
+}
+
+/**	Time a drawing operation
+*	@param	fnDraw Function to draw
+*	@param	nIterations Quantity of times to draw
+*	@retval	uint64_t Average time in nanoseconds
+*/
+uint64_t measure(function<void()> fnDraw, unsigned int nIterations)
+{
+    struct timespec tsStart, tsEnd;
+    clock_gettime(CLOCK_MONOTONIC, &tsStart);
+    for(unsigned int nIteration = 0; nIteration < nIterations; ++nIteration)
+    {
+        fnDraw();
+        asm volatile("" : : "r"(g_vScreen.data()) : "memory"); // Stop compiler removing repeated draws
+    }
+    clock_gettime(CLOCK_MONOTONIC, &tsEnd);
+    return ((uint64_t)(tsEnd.tv_sec - tsStart.tv_sec) * 1000000000 + tsEnd.tv_nsec - tsStart.tv_nsec) / nIterations;
+}
+
+/**	Benchmark and compare three implementations of a drawing operation
+*	@param	sName Name of operation
+*	@param	nPixels Quantity of pixels drawn by operation
+*	@param	fnPerPixel Per-pixel implementation
+*	@param	fnScalar Plain C++ kernel implementation
+*	@param	fnVector Vector kernel implementation
+*	@param	nIterations Quantity of times to draw each implementation
+*	@retval	bool True if all implementations produce the same pixels
+*/
+bool compare(string sName, unsigned int nPixels, function<void()> fnPerPixel, function<void()> fnScalar, function<void()> fnVector, unsigned int nIterations)
+{
+    vector<uint8_t> vExpected;
+    memset(g_vScreen.data(), 0x55, g_vScreen.size());
+    fnPerPixel();
+    vExpected = g_vScreen;
+    bool bPass = true;
+    for(auto fn : {fnScalar, fnVector})
+    {
+        memset(g_vScreen.data(), 0x55, g_vScreen.size());
+        fn();
+        if(g_vScreen != vExpected)
+            bPass = false;
+    }
+    uint64_t nPerPixel = measure(fnPerPixel, nIterations);
+    uint64_t nScalar = measure(fnScalar, nIterations);
+    uint64_t nVector = measure(fnVector, nIterations);
+    printf("%s %-12s %6u px: per-pixel %7luns, scalar %7luns, %s %7luns (%.1fx per-pixel)\n", bPass ? "PASS" : "FAIL", sName.c_str(), nPixels,
+        (unsigned long)nPerPixel, (unsigned long)nScalar, fbKernelName(), (unsigned long)nVector, nVector ? (double)nPerPixel / nVector : 0.0);
+    return bPass;
+}
+
+/**	Check vector kernels match plain C++ kernels for random rectangles, including odd widths and offsets
+*	@retval	bool True if all rectangles match
+*/
+bool checkRandom()
+{
+    vector<uint8_t> vExpected;
+    for(unsigned int nCheck = 0; nCheck < BENCH_CHECKS; ++nCheck)
+    {
+        int nX1 = rand() % BENCH_WIDTH;
+        int nY1 = rand() % BENCH_HEIGHT;
+        int nX2 = nX1 + rand() % (BENCH_WIDTH - nX1);
+        int nY2 = nY1 + rand() % (BENCH_HEIGHT - nY1);
+        uint32_t nColour = rand() & 0xFFFFFF;
+        unsigned int nCopyBytes = (nX2 - nX1 + 1) / 2 * 2; // Copy bitmap over left half so fill remains on right half
+        unsigned int nOffset = nY1 * BENCH_STRIDE + nX1 * 2;
+        memset(g_vScreen.data(), 0, g_vScreen.size());
+        fillKernel(nX1, nY1, nX2, nY2, nColour, false);
+        fbCopyScalar(g_vScreen.data() + nOffset, BENCH_STRIDE, g_vBitmap16.data() + nOffset, BENCH_STRIDE, nCopyBytes, nY2 - nY1 + 1);
+        vExpected = g_vScreen;
+        memset(g_vScreen.data(), 0, g_vScreen.size());
+        fillKernel(nX1, nY1, nX2, nY2, nColour, true);
+        fbCopy(g_vScreen.data() + nOffset, BENCH_STRIDE, g_vBitmap16.data() + nOffset, BENCH_STRIDE, nCopyBytes, nY2 - nY1 + 1);
+        if(g_vScreen != vExpected)
+        {
+            printf("FAIL random rectangle %d,%d %d,%d\n", nX1, nY1, nX2, nY2);
+            return false;
+        }
+    }
+    printf("PASS %u random rectangles\n", BENCH_CHECKS);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int nIterations = (argc > 1) ? atoi(argv[1]) : 2000;
+    if(nIterations < 1)
+        nIterations = 1;
+    bool bPass = true;
+
+    // Gradient bitmap, converted to framebuffer format as FbScreen::LoadBitmap does
+    for(unsigned int nY = 0; nY < BENCH_HEIGHT; ++nY)
+    {
+        for(unsigned int nX = 0; nX < BENCH_WIDTH; ++nX)
+        {
+            uint8_t* pPixel = g_vBitmap24.data() + (nY * BENCH_WIDTH + nX) * 3;
+            pPixel[0] = nX * 255 / BENCH_WIDTH;
+            pPixel[1] = nY * 255 / BENCH_HEIGHT;
+            pPixel[2] = (nX + nY) & 0xFF;
+            *(uint16_t*)(g_vBitmap16.data() + nY * BENCH_STRIDE + nX * 2) = pack(pPixel[2] << 16 | pPixel[1] << 8 | pPixel[0]);
+        }
+    }
+
+    printf("Framebuffer kernels: %ux%u RGB565, %s, %u iterations\n", BENCH_WIDTH, BENCH_HEIGHT, fbKernelName(), nIterations);
+    bPass &= compare("clear", BENCH_WIDTH * BENCH_HEIGHT,
+        []() {fillPerPixel(0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x8B0000);},
+        []() {fillKernel(0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x8B0000, false);},
+        []() {fillKernel(0, 0, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x8B0000, true);},
+        nIterations);
+    bPass &= compare("data area", BENCH_WIDTH * (BENCH_HEIGHT - 16),
+        []() {fillPerPixel(0, 16, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x000000);},
+        []() {fillKernel(0, 16, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x000000, false);},
+        []() {fillKernel(0, 16, BENCH_WIDTH - 1, BENCH_HEIGHT - 1, 0x000000, true);},
+        nIterations);
+    bPass &= compare("list row", (BENCH_WIDTH - 2) * 16,
+        []() {fillPerPixel(2, 32, BENCH_WIDTH - 1, 47, 0x00008B);},
+        []() {fillKernel(2, 32, BENCH_WIDTH - 1, 47, 0x00008B, false);},
+        []() {fillKernel(2, 32, BENCH_WIDTH - 1, 47, 0x00008B, true);},
+        nIterations);
+    bPass &= compare("fader", 7 * 100,
+        []() {fillPerPixel(17, 20, 23, 119, 0x808080);},
+        []() {fillKernel(17, 20, 23, 119, 0x808080, false);},
+        []() {fillKernel(17, 20, 23, 119, 0x808080, true);},
+        nIterations);
+    bPass &= compare("bitmap", BENCH_WIDTH * BENCH_HEIGHT,
+        []() {blitPerPixel();},
+        []() {fbCopyScalar(g_vScreen.data(), BENCH_STRIDE, g_vBitmap16.data(), BENCH_STRIDE, BENCH_STRIDE, BENCH_HEIGHT);},
+        []() {fbCopy(g_vScreen.data(), BENCH_STRIDE, g_vBitmap16.data(), BENCH_STRIDE, BENCH_STRIDE, BENCH_HEIGHT);},
+        nIterations);
+    bPass &= checkRandom();
+
+    return bPass ? 0 : 1;
+}
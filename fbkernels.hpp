@@ -0,0 +1,211 @@
+/*	Framebuffer pixel kernels
+
+	Fill and copy rectangles of framebuffer memory a whole row at a time instead of pixel by pixel.
+	Uses NEON on ARM, SSE2 on x86 (e.g. for benchmarking on a desktop) and plain C++ elsewhere.
+	32-bit ARM builds only enable NEON when compiled with -mfpu=neon (or neon-vfpv4). It is always available on aarch64.
+	Kernels work on bytes so the same code serves 16-bit (RGB565) and 32-bit framebuffers.
+*/
+
+#pragma once
+
+#include <cstdint> // provides uint8_t, uint32_t
+#include <cstring> // provides memcpy
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h> // provides NEON intrinsics
+#define FB_KERNEL_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h> // provides SSE2 intrinsics
+#define FB_KERNEL_SSE2
+#endif
+
+/**	Get name of instruction set used by kernels
+*	@retval	const char* Name of instruction set
+*/
+inline const char* fbKernelName()
+{
+#if defined(FB_KERNEL_NEON)
+    return "NEON";
+#elif defined(FB_KERNEL_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+/**	Get 32-bit fill pattern for a pixel
+*	@param	nPixel Pixel value in framebuffer format
+*	@param	nBpp Bits per pixel [16, 32]
+*	@retval	uint32_t Pattern that repeats the pixel to fill 32 bits
+*/
+inline uint32_t fbPattern(uint32_t nPixel, unsigned int nBpp)
+{
+    return (nBpp == 16) ? ((nPixel & 0xFFFF) | (nPixel << 16)) : nPixel;
+}
+
+/**	Fill rectangle with a repeating pattern - plain C++
+*	@param	pDst Pointer to top left of rectangle
+*	@param	nStride Bytes between start of each row
+*	@param	nBytes Bytes per row (must be a multiple of pixel size)
+*	@param	nRows Quantity of rows
+*	@param	nPattern Pattern from fbPattern
+*/
+inline void fbFillScalar(uint8_t* pDst, unsigned int nStride, unsigned int nBytes, unsigned int nRows, uint32_t nPattern)
+{
+    for(unsigned int nRow = 0; nRow < nRows; ++nRow)
+    {
+        unsigned int nOffset = 0;
+        for(; nOffset + 4 <= nBytes; nOffset += 4)
+            memcpy(pDst + nOffset, &nPattern, 4);
+        if(nOffset < nBytes)
+            memcpy(pDst + nOffset, &nPattern, 2); // Odd 16-bit pixel
+        pDst += nStride;
+    }
+}
+
+/**	Copy rectangle - plain C++
+*	@param	pDst Pointer to top left of destination
+*	@param	nDstStride Bytes between start of each destination row
+*	@param	pSrc Pointer to top left of source
+*	@param	nSrcStride Bytes between start of each source row
+*	@param	nBytes Bytes per row
+*	@param	nRows Quantity of rows
+*/
+inline void fbCopyScalar(uint8_t* pDst, unsigned int nDstStride, const uint8_t* pSrc, unsigned int nSrcStride, unsigned int nBytes, unsigned int nRows)
+{
+    for(unsigned int nRow = 0; nRow < nRows; ++nRow)
+    {
+        memcpy(pDst, pSrc, nBytes);
+        pDst += nDstStride;
+        pSrc += nSrcStride;
+    }
+}
+
+/**	Fill rectangle with a repeating pattern using vector stores
+*	@param	pDst Pointer to top left of rectangle
+*	@param	nStride Bytes between start of each row
+*	@param	nBytes Bytes per row (must be a multiple of pixel size)
+*	@param	nRows Quantity of rows
+*	@param	nPattern Pattern from fbPattern
+*	@note	Contiguous rows (e.g. full screen clear) are filled as a single run
+*/
+inline void fbFill(uint8_t* pDst, unsigned int nStride, unsigned int nBytes, unsigned int nRows, uint32_t nPattern)
+{
+    if(nStride == nBytes)
+    {
+        nBytes *= nRows;
+        nRows = 1;
+    }
+#if defined(FB_KERNEL_NEON) || defined(FB_KERNEL_SSE2)
+#if defined(FB_KERNEL_NEON)
+    uint8x16_t vPattern = vreinterpretq_u8_u32(vdupq_n_u32(nPattern));
+#else
+    __m128i vPattern = _mm_set1_epi32((int)nPattern);
+#endif
+    for(unsigned int nRow = 0; nRow < nRows; ++nRow)
+    {
+        uint8_t* pPos = pDst;
+        uint8_t* pEnd = pDst + nBytes;
+        for(; pPos + 64 <= pEnd; pPos += 64)
+        {
+#if defined(FB_KERNEL_NEON)
+            vst1q_u8(pPos, vPattern);
+            vst1q_u8(pPos + 16, vPattern);
+            vst1q_u8(pPos + 32, vPattern);
+            vst1q_u8(pPos + 48, vPattern);
+#else
+            _mm_storeu_si128((__m128i*)pPos, vPattern);
+            _mm_storeu_si128((__m128i*)(pPos + 16), vPattern);
+            _mm_storeu_si128((__m128i*)(pPos + 32), vPattern);
+            _mm_storeu_si128((__m128i*)(pPos + 48), vPattern);
+#endif
+        }
+        for(; pPos + 16 <= pEnd; pPos += 16)
+        {
+#if defined(FB_KERNEL_NEON)
+            vst1q_u8(pPos, vPattern);
+#else
+            _mm_storeu_si128((__m128i*)pPos, vPattern);
+#endif
+        }
+        if(pPos + 8 <= pEnd)
+        {
+#if defined(FB_KERNEL_NEON)
+            vst1_u8(pPos, vget_low_u8(vPattern));
+#else
+            _mm_storel_epi64((__m128i*)pPos, vPattern);
+#endif
+            pPos += 8;
+        }
+        if(pPos + 4 <= pEnd)
+        {
+            memcpy(pPos, &nPattern, 4);
+            pPos += 4;
+        }
+        if(pPos < pEnd)
+            memcpy(pPos, &nPattern, 2); // Odd 16-bit pixel
+        pDst += nStride;
+    }
+#else
+    fbFillScalar(pDst, nStride, nBytes, nRows, nPattern);
+#endif
+}
+
+/**	Copy rectangle using vector loads and stores
+*	@param	pDst Pointer to top left of destination
+*	@param	nDstStride Bytes between start of each destination row
+*	@param	pSrc Pointer to top left of source
+*	@param	nSrcStride Bytes between start of each source row
+*	@param	nBytes Bytes per row
+*	@param	nRows Quantity of rows
+*	@note	Source and destination must not overlap. Contiguous rows (e.g. full screen bitmap) are copied as a single run
+*/
+inline void fbCopy(uint8_t* pDst, unsigned int nDstStride, const uint8_t* pSrc, unsigned int nSrcStride, unsigned int nBytes, unsigned int nRows)
+{
+    if(nDstStride == nBytes && nSrcStride == nBytes)
+    {
+        nBytes *= nRows;
+        nRows = 1;
+    }
+#if defined(FB_KERNEL_NEON) || defined(FB_KERNEL_SSE2)
+    for(unsigned int nRow = 0; nRow < nRows; ++nRow)
+    {
+        unsigned int nOffset = 0;
+        for(; nOffset + 64 <= nBytes; nOffset += 64)
+        {
+#if defined(FB_KERNEL_NEON)
+            uint8x16_t v0 = vld1q_u8(pSrc + nOffset);
+            uint8x16_t v1 = vld1q_u8(pSrc + nOffset + 16);
+            uint8x16_t v2 = vld1q_u8(pSrc + nOffset + 32);
+            uint8x16_t v3 = vld1q_u8(pSrc + nOffset + 48);
+            vst1q_u8(pDst + nOffset, v0);
+            vst1q_u8(pDst + nOffset + 16, v1);
+            vst1q_u8(pDst + nOffset + 32, v2);
+            vst1q_u8(pDst + nOffset + 48, v3);
+#else
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(pSrc + nOffset));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(pSrc + nOffset + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(pSrc + nOffset + 32));
+            __m128i v3 = _mm_loadu_si128((const __m128i*)(pSrc + nOffset + 48));
+            _mm_storeu_si128((__m128i*)(pDst + nOffset), v0);
+            _mm_storeu_si128((__m128i*)(pDst + nOffset + 16), v1);
+            _mm_storeu_si128((__m128i*)(pDst + nOffset + 32), v2);
+            _mm_storeu_si128((__m128i*)(pDst + nOffset + 48), v3);
+#endif
+        }
+        for(; nOffset + 16 <= nBytes; nOffset += 16)
+        {
+#if defined(FB_KERNEL_NEON)
+            vst1q_u8(pDst + nOffset, vld1q_u8(pSrc + nOffset));
+#else
+            _mm_storeu_si128((__m128i*)(pDst + nOffset), _mm_loadu_si128((const __m128i*)(pSrc + nOffset)));
+#endif
+        }
+        if(nOffset < nBytes)
+            memcpy(pDst + nOffset, pSrc + nOffset, nBytes - nOffset);
+        pDst += nDstStride;
+        pSrc += nSrcStride;
+    }
+#else
+    fbCopyScalar(pDst, nDstStride, pSrc, nSrcStride, nBytes, nRows);
+#endif
+}
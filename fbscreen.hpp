@@ -0,0 +1,531 @@
+/*	Framebuffer screen
+
+	FbScreen extends ribanfblib to draw directly into the memory mapped framebuffer:
+	  DrawText blits pre-rasterized, anti-aliased glyphs instead of rendering each character through FreeType.
+	  Glyphs are rasterized once per font, size, rotation and character (lazily or via Preload) and blended directly into the framebuffer.
+	  SetFont only selects which cached glyphs are used so switching sizes (e.g. mixer labels) does not reconfigure FreeType.
+	  Clear and filled, square-cornered DrawRect fill whole rows with vector kernels (see fbkernels.hpp) instead of plotting each pixel.
+	  Bitmaps are converted to framebuffer pixel format when loaded so DrawBitmap copies rows with vector kernels.
+	Falls back to ribanfblib drawing if the framebuffer format is not supported or a font or bitmap cannot be loaded.
+*/
+
+#pragma once
+
+#include "ribanfblib/ribanfblib.h"
+#include "fbkernels.hpp"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cmath> // provides sin, cos
+#include <algorithm> // provides std::min, std::max
+#include <cstdint> // provides uint8_t, uint32_t
+#include <cstdlib> // provides abs
+#include <fstream> // provides std::ifstream
+#include <map> // provides std::map
+#include <string> // provides std::string
+#include <unordered_map> // provides std::unordered_map
+#include <vector> // provides std::vector
+#include <fcntl.h> // provides open
+#include <unistd.h> // provides close
+#include <sys/ioctl.h> // provides ioctl
+#include <sys/mman.h> // provides mmap
+#include <linux/fb.h> // provides framebuffer interface
+
+/**	Rasterized glyph */
+struct CachedGlyph
+{
+    int left = 0; // Offset from pen position to left of bitmap
+    int top = 0; // Offset from pen position up to top of bitmap
+    unsigned int width = 0; // Width of bitmap in pixels
+    unsigned int height = 0; // Height of bitmap in pixels
+    long advanceX = 0; // Pen advance in 26.6 fixed point (rotated)
+    long advanceY = 0; // Pen advance in 26.6 fixed point (rotated, y up)
+    std::vector<uint8_t> alpha; // Coverage of each pixel [0..255], row by row
+};
+
+/**	GlyphCache class holds FreeType faces and rasterized glyphs */
+class GlyphCache
+{
+public:
+    GlyphCache()
+    {
+        if(FT_Init_FreeType(&m_pLibrary))
+            m_pLibrary = NULL;
+    }
+
+    ~GlyphCache()
+    {
+        for(auto it = m_vFaces.begin(); it != m_vFaces.end(); ++it)
+            FT_Done_Face(*it);
+        if(m_pLibrary)
+            FT_Done_FreeType(m_pLibrary);
+    }
+
+    /**	Get identifier of a font, loading it if necessary
+    *	@param	sFont Path to font file
+    *	@retval	int Font identifier or -1 if font cannot be loaded
+    */
+    int GetFont(const std::string& sFont)
+    {
+        auto it = m_mapFontIds.find(sFont);
+        if(it != m_mapFontIds.end())
+            return it->second;
+        FT_Face pFace = NULL;
+        if(!m_pLibrary || FT_New_Face(m_pLibrary, sFont.c_str(), 0, &pFace))
+        {
+            m_mapFontIds[sFont] = -1; // Remember failures so that they are not retried
+            return -1;
+        }
+        m_vFaces.push_back(pFace);
+        m_mapFontIds[sFont] = m_vFaces.size() - 1;
+        return m_vFaces.size() - 1;
+    }
+
+    /**	Get a glyph, rasterizing it if not already cached
+    *	@param	nFont Font identifier from GetFont
+    *	@param	nWidth Font width in pixels
+    *	@param	nHeight Font height in pixels (0 for same as width)
+    *	@param	nAngle Rotation in degrees anticlockwise
+    *	@param	nChar Character code
+    *	@retval	const CachedGlyph* Pointer to glyph or NULL if invalid font
+    */
+    const CachedGlyph* GetGlyph(int nFont, unsigned int nWidth, unsigned int nHeight, unsigned int nAngle, uint32_t nChar)
+    {
+        nAngle %= 360;
+        // Key packs font (14 bits), width (10), height (10), angle (9) and character (21)
+        uint64_t nKey = ((uint64_t)(nFont & 0x3FFF) << 50) | ((uint64_t)(nWidth & 0x3FF) << 40) | ((uint64_t)(nHeight & 0x3FF) << 30) | ((uint64_t)nAngle << 21) | (nChar & 0x1FFFFF);
+        auto it = m_mapGlyphs.find(nKey);
+        if(it != m_mapGlyphs.end())
+            return &(it->second);
+        if(nFont < 0 || nFont >= (int)m_vFaces.size())
+            return NULL;
+        FT_Face pFace = m_vFaces[nFont];
+        ++m_nMisses;
+        // Only reconfigure face when size or rotation differs from last rasterized glyph
+        if(pFace != m_pActiveFace || nWidth != m_nActiveWidth || nHeight != m_nActiveHeight)
+        {
+            FT_Set_Pixel_Sizes(pFace, nWidth, nHeight);
+            m_nActiveWidth = nWidth;
+            m_nActiveHeight = nHeight;
+        }
+        if(pFace != m_pActiveFace || nAngle != m_nActiveAngle)
+        {
+            double dAngle = nAngle * M_PI / 180.0;
+            FT_Matrix matrix;
+            matrix.xx = (FT_Fixed)(cos(dAngle) * 0x10000L);
+            matrix.xy = (FT_Fixed)(-sin(dAngle) * 0x10000L);
+            matrix.yx = (FT_Fixed)(sin(dAngle) * 0x10000L);
+            matrix.yy = (FT_Fixed)(cos(dAngle) * 0x10000L);
+            FT_Set_Transform(pFace, &matrix, NULL);
+            m_nActiveAngle = nAngle;
+        }
+        m_pActiveFace = pFace;
+        CachedGlyph& glyph = m_mapGlyphs[nKey];
+        if(FT_Load_Char(pFace, nChar, FT_LOAD_RENDER))
+            return &glyph; // Empty glyph so that missing characters are not retried
+        FT_GlyphSlot pSlot = pFace->glyph;
+        glyph.left = pSlot->bitmap_left;
+        glyph.top = pSlot->bitmap_top;
+        glyph.width = pSlot->bitmap.width;
+        glyph.height = pSlot->bitmap.rows;
+        glyph.advanceX = pSlot->advance.x;
+        glyph.advanceY = pSlot->advance.y;
+        glyph.alpha.resize(glyph.width * glyph.height);
+        for(unsigned int nRow = 0; nRow < glyph.height; ++nRow)
+            for(unsigned int nCol = 0; nCol < glyph.width; ++nCol)
+                glyph.alpha[nRow * glyph.width + nCol] = pSlot->bitmap.buffer[nRow * pSlot->bitmap.pitch + nCol];
+        m_nBytes += glyph.alpha.size();
+        return &glyph;
+    }
+
+    /**	Rasterize printable ASCII characters in advance
+    *	@param	sFont Path to font file
+    *	@param	nWidth Font width in pixels
+    *	@param	nHeight Font height in pixels (0 for same as width)
+    *	@param	nAngle Rotation in degrees anticlockwise
+    *	@retval	bool True if font loaded
+    */
+    bool Preload(const std::string& sFont, unsigned int nWidth, unsigned int nHeight = 0, unsigned int nAngle = 0)
+    {
+        int nFont = GetFont(sFont);
+        if(nFont < 0)
+            return false;
+        for(uint32_t nChar = 32; nChar < 127; ++nChar)
+            GetGlyph(nFont, nWidth, nHeight, nAngle, nChar);
+        return true;
+    }
+
+    /**	Get quantity of cached glyphs */
+    size_t GetCount()
+    {
+        return m_mapGlyphs.size();
+    }
+
+    /**	Get quantity of bytes used by glyph bitmaps */
+    size_t GetBytes()
+    {
+        return m_nBytes;
+    }
+
+    /**	Get quantity of glyphs rasterized (cache misses) */
+    unsigned int GetMisses()
+    {
+        return m_nMisses;
+    }
+
+private:
+    FT_Library m_pLibrary = NULL; // FreeType library instance
+    std::map<std::string, int> m_mapFontIds; // Font identifiers indexed by font path (-1 if font failed to load)
+    std::vector<FT_Face> m_vFaces; // FreeType faces indexed by font identifier
+    std::unordered_map<uint64_t, CachedGlyph> m_mapGlyphs; // Rasterized glyphs indexed by packed font, size, angle and character
+    FT_Face m_pActiveFace = NULL; // Face last configured for rasterizing
+    unsigned int m_nActiveWidth = 0; // Width last set on active face
+    unsigned int m_nActiveHeight = 0; // Height last set on active face
+    unsigned int m_nActiveAngle = 0; // Rotation last set on active face
+    size_t m_nBytes = 0; // Size of all glyph bitmaps
+    unsigned int m_nMisses = 0; // Quantity of glyphs rasterized
+};
+
+/**	Bitmap converted to framebuffer pixel format */
+struct FbBitmap
+{
+    unsigned int width = 0; // Width in pixels
+    unsigned int height = 0; // Height in pixels
+    unsigned int stride = 0; // Bytes per row
+    std::vector<uint8_t> pixels; // Pixels in framebuffer format, top row first
+};
+
+/**	FbScreen class is a ribanfblib that draws text from a glyph cache and fills and copies with vector kernels */
+class FbScreen : public ribanfblib
+{
+public:
+    /**	Instantiate screen
+    *	@param	sDevice Path to framebuffer device
+    */
+    FbScreen(const char* sDevice = "/dev/fb1") :
+        ribanfblib(sDevice)
+    {
+        int nFd = open(sDevice, O_RDWR | O_CLOEXEC);
+        if(nFd < 0)
+            return;
+        struct fb_var_screeninfo varInfo;
+        struct fb_fix_screeninfo fixInfo;
+        if(ioctl(nFd, FBIOGET_VSCREENINFO, &varInfo) == 0 && ioctl(nFd, FBIOGET_FSCREENINFO, &fixInfo) == 0
+            && (varInfo.bits_per_pixel == 16 || varInfo.bits_per_pixel == 32))
+        {
+            void* pBuffer = mmap(NULL, fixInfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+            if(pBuffer != MAP_FAILED)
+            {
+                m_pBuffer = (uint8_t*)pBuffer;
+                m_nBufferSize = fixInfo.smem_len;
+                m_nStride = fixInfo.line_length;
+                m_nWidth = varInfo.xres;
+                m_nHeight = varInfo.yres;
+                m_nBpp = varInfo.bits_per_pixel;
+                m_red = varInfo.red;
+                m_green = varInfo.green;
+                m_blue = varInfo.blue;
+            }
+        }
+        close(nFd);
+    }
+
+    ~FbScreen()
+    {
+        if(m_pBuffer)
+            munmap(m_pBuffer, m_nBufferSize);
+    }
+
+    /**	Select font
+    *	@param	nWidth Font width in pixels
+    *	@param	nHeight Font height in pixels (0 for same as width)
+    *	@param	sPath Path to font file (empty to keep current font)
+    *	@retval	bool True on success
+    */
+    bool SetFont(unsigned int nWidth, unsigned int nHeight = 0, std::string sPath = "")
+    {
+        m_nFontWidth = nWidth;
+        m_nFontHeight = nHeight;
+        if(!sPath.empty())
+            m_sFont = sPath;
+        m_bBaseFontStale = true;
+        return true;
+    }
+
+    /**	Select font
+    *	@param	nSize Font size in pixels
+    *	@param	sPath Path to font file
+    *	@retval	bool True on success
+    */
+    bool SetFont(unsigned int nSize, std::string sPath)
+    {
+        return SetFont(nSize, 0, sPath);
+    }
+
+    /**	Draw text
+    *	@param	sText Text to draw
+    *	@param	nX X coordinate of start of baseline
+    *	@param	nY Y coordinate of baseline
+    *	@param	nColour Colour as 24-bit RGB
+    *	@param	nAngle Rotation in degrees anticlockwise
+    */
+    void DrawText(std::string sText, int nX, int nY, uint32_t nColour = WHITE, unsigned int nAngle = 0)
+    {
+        int nFont = m_sFont.empty() ? -1 : m_glyphCache.GetFont(m_sFont);
+        if(!m_bCache || !m_pBuffer || nFont < 0)
+        {
+            if(m_bBaseFontStale)
+            {
+                if(m_sFont.empty())
+                    ribanfblib::SetFont(m_nFontWidth, m_nFontHeight);
+                else
+                    ribanfblib::SetFont(m_nFontWidth, m_nFontHeight, m_sFont);
+                m_bBaseFontStale = false;
+            }
+            ribanfblib::DrawText(sText, nX, nY, nColour, nAngle);
+            return;
+        }
+        uint32_t nRed = (nColour >> 16) & 0xFF;
+        uint32_t nGreen = (nColour >> 8) & 0xFF;
+        uint32_t nBlue = nColour & 0xFF;
+        long nPenX = (long)nX * 64; // 26.6 fixed point
+        long nPenY = (long)nY * 64;
+        for(size_t nIndex = 0; nIndex < sText.size(); ++nIndex)
+        {
+            const CachedGlyph* pGlyph = m_glyphCache.GetGlyph(nFont, m_nFontWidth, m_nFontHeight, nAngle, (unsigned char)sText[nIndex]);
+            if(!pGlyph)
+                break;
+            int nLeft = ((nPenX + 32) >> 6) + pGlyph->left;
+            int nTop = ((nPenY + 32) >> 6) - pGlyph->top;
+            Blend(pGlyph, nLeft, nTop, nRed, nGreen, nBlue);
+            nPenX += pGlyph->advanceX;
+            nPenY -= pGlyph->advanceY; // FreeType y axis points up
+        }
+    }
+
+    /**	Rasterize printable ASCII characters of current font in advance
+    *	@param	nAngle Rotation in degrees anticlockwise
+    */
+    void PreloadFont(unsigned int nAngle = 0)
+    {
+        if(!m_sFont.empty())
+            m_glyphCache.Preload(m_sFont, m_nFontWidth, m_nFontHeight, nAngle);
+    }
+
+    /**	Enable or disable glyph cache, e.g. to compare performance
+    *	@param	bEnable True to draw from cache, false to use ribanfblib text rendering
+    */
+    void EnableCache(bool bEnable)
+    {
+        m_bCache = bEnable;
+    }
+
+    /**	Get glyph cache */
+    GlyphCache& GetGlyphCache()
+    {
+        return m_glyphCache;
+    }
+
+    /**	Clear screen
+    *	@param	nColour Colour as 24-bit RGB
+    */
+    void Clear(uint32_t nColour = BLACK)
+    {
+        if(!m_bKernels || !m_pBuffer)
+        {
+            ribanfblib::Clear(nColour);
+            return;
+        }
+        fbFill(m_pBuffer, m_nStride, m_nWidth * m_nBpp / 8, m_nHeight, fbPattern(PackRgb(nColour), m_nBpp));
+    }
+
+    /**	Draw rectangle
+    *	@param	nX1, nY1 Coordinates of one corner (inclusive)
+    *	@param	nX2, nY2 Coordinates of opposite corner (inclusive)
+    *	@param	nColour Border colour as 24-bit RGB
+    *	@param	nBorder Border width in pixels (0 for no border)
+    *	@param	nFill Fill colour as 24-bit RGB (-1 for no fill)
+    *	@param	nQuadrants Bitmask of corners to round
+    *	@param	nRadius Corner radius in pixels (0 for square corners)
+    *	@note	Square-cornered fills are drawn with vector kernels, the border (if any) and rounded rectangles by ribanfblib
+    */
+    void DrawRect(int nX1, int nY1, int nX2, int nY2, uint32_t nColour = WHITE, unsigned int nBorder = 1, uint32_t nFill = -1, uint8_t nQuadrants = QUADRANT_ALL, unsigned int nRadius = 0)
+    {
+        if(!m_bKernels || !m_pBuffer || nRadius || nFill == (uint32_t)-1)
+        {
+            ribanfblib::DrawRect(nX1, nY1, nX2, nY2, nColour, nBorder, nFill, nQuadrants, nRadius);
+            return;
+        }
+        int nLeft = std::max(std::min(nX1, nX2), 0);
+        int nTop = std::max(std::min(nY1, nY2), 0);
+        int nRight = std::min(std::max(nX1, nX2), (int)m_nWidth - 1);
+        int nBottom = std::min(std::max(nY1, nY2), (int)m_nHeight - 1);
+        if(nLeft <= nRight && nTop <= nBottom)
+        {
+            unsigned int nBytesPerPixel = m_nBpp / 8;
+            fbFill(m_pBuffer + nTop * m_nStride + nLeft * nBytesPerPixel, m_nStride, (nRight - nLeft + 1) * nBytesPerPixel, nBottom - nTop + 1, fbPattern(PackRgb(nFill), m_nBpp));
+        }
+        if(nBorder)
+            ribanfblib::DrawRect(nX1, nY1, nX2, nY2, nColour, nBorder, -1, nQuadrants, 0);
+    }
+
+    /**	Load a bitmap from file
+    *	@param	sFilename Path to bitmap file
+    *	@param	sName Name used to draw bitmap
+    *	@retval	bool True on success
+    *	@note	Uncompressed 24-bit and 32-bit bitmaps are converted to framebuffer format for drawing with vector kernels
+    */
+    bool LoadBitmap(std::string sFilename, std::string sName)
+    {
+        bool bLoaded = ribanfblib::LoadBitmap(sFilename, sName);
+        m_mapBitmaps.erase(sName);
+        if(!m_pBuffer)
+            return bLoaded;
+        std::ifstream file(sFilename, std::ios::binary);
+        std::vector<uint8_t> vFile((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto read32 = [&vFile](size_t nOffset) {return (uint32_t)vFile[nOffset] | (uint32_t)vFile[nOffset + 1] << 8 | (uint32_t)vFile[nOffset + 2] << 16 | (uint32_t)vFile[nOffset + 3] << 24;};
+        if(vFile.size() < 54 || vFile[0] != 'B' || vFile[1] != 'M')
+            return bLoaded;
+        uint32_t nOffset = read32(10);
+        int32_t nWidth = read32(18);
+        int32_t nHeight = read32(22); // Negative for top row first
+        unsigned int nBits = vFile[28] | vFile[29] << 8;
+        uint32_t nCompression = read32(30);
+        if(nWidth <= 0 || nHeight == 0 || (nBits != 24 && nBits != 32) || nCompression != 0)
+            return bLoaded;
+        unsigned int nRows = abs(nHeight);
+        unsigned int nFileStride = (nWidth * nBits / 8 + 3) & ~3;
+        if(nOffset + (uint64_t)nFileStride * nRows > vFile.size())
+            return bLoaded;
+        FbBitmap& bitmap = m_mapBitmaps[sName];
+        bitmap.width = nWidth;
+        bitmap.height = nRows;
+        bitmap.stride = nWidth * m_nBpp / 8;
+        bitmap.pixels.resize(bitmap.stride * nRows);
+        for(unsigned int nRow = 0; nRow < nRows; ++nRow)
+        {
+            const uint8_t* pSrc = vFile.data() + nOffset + (nHeight > 0 ? nRows - 1 - nRow : nRow) * nFileStride;
+            uint8_t* pDst = bitmap.pixels.data() + nRow * bitmap.stride;
+            for(int nCol = 0; nCol < nWidth; ++nCol, pSrc += nBits / 8)
+            {
+                uint32_t nPixel = Pack(pSrc[2], pSrc[1], pSrc[0]); // Bitmap pixels are stored BGR
+                if(m_nBpp == 16)
+                    ((uint16_t*)pDst)[nCol] = nPixel;
+                else
+                    ((uint32_t*)pDst)[nCol] = nPixel;
+            }
+        }
+        return true;
+    }
+
+    /**	Draw a bitmap
+    *	@param	sName Name of bitmap passed to LoadBitmap
+    *	@param	nX X coordinate of left of bitmap
+    *	@param	nY Y coordinate of top of bitmap
+    *	@retval	bool True on success
+    */
+    bool DrawBitmap(std::string sName, int nX, int nY)
+    {
+        auto it = m_mapBitmaps.find(sName);
+        if(!m_bKernels || !m_pBuffer || it == m_mapBitmaps.end())
+            return ribanfblib::DrawBitmap(sName, nX, nY);
+        const FbBitmap& bitmap = it->second;
+        int nLeft = std::max(nX, 0);
+        int nTop = std::max(nY, 0);
+        int nRight = std::min(nX + (int)bitmap.width, (int)m_nWidth);
+        int nBottom = std::min(nY + (int)bitmap.height, (int)m_nHeight);
+        if(nLeft >= nRight || nTop >= nBottom)
+            return true;
+        unsigned int nBytesPerPixel = m_nBpp / 8;
+        fbCopy(m_pBuffer + nTop * m_nStride + nLeft * nBytesPerPixel, m_nStride,
+               bitmap.pixels.data() + (nTop - nY) * bitmap.stride + (nLeft - nX) * nBytesPerPixel, bitmap.stride,
+               (nRight - nLeft) * nBytesPerPixel, nBottom - nTop);
+        return true;
+    }
+
+    /**	Enable or disable vector kernels, e.g. to compare performance
+    *	@param	bEnable True to fill and copy with vector kernels, false to use ribanfblib drawing
+    */
+    void EnableKernels(bool bEnable)
+    {
+        m_bKernels = bEnable;
+    }
+
+private:
+    /**	Blend a glyph into the framebuffer, clipped to screen
+    *	@param	pGlyph Pointer to glyph
+    *	@param	nLeft X coordinate of left of glyph bitmap
+    *	@param	nTop Y coordinate of top of glyph bitmap
+    *	@param	nRed, nGreen, nBlue Text colour components [0..255]
+    */
+    void Blend(const CachedGlyph* pGlyph, int nLeft, int nTop, uint32_t nRed, uint32_t nGreen, uint32_t nBlue)
+    {
+        unsigned int nBytesPerPixel = m_nBpp / 8;
+        for(unsigned int nRow = 0; nRow < pGlyph->height; ++nRow)
+        {
+            int nY = nTop + nRow;
+            if(nY < 0 || nY >= (int)m_nHeight)
+                continue;
+            const uint8_t* pAlpha = pGlyph->alpha.data() + nRow * pGlyph->width;
+            uint8_t* pLine = m_pBuffer + nY * m_nStride;
+            for(unsigned int nCol = 0; nCol < pGlyph->width; ++nCol)
+            {
+                uint32_t nAlpha = pAlpha[nCol];
+                int nX = nLeft + nCol;
+                if(!nAlpha || nX < 0 || nX >= (int)m_nWidth)
+                    continue;
+                uint8_t* pPixel = pLine + nX * nBytesPerPixel;
+                uint32_t nPixel = (m_nBpp == 16) ? *(uint16_t*)pPixel : *(uint32_t*)pPixel;
+                if(nAlpha < 255)
+                {
+                    uint32_t nInv = 255 - nAlpha;
+                    nPixel = Pack((nRed * nAlpha + Unpack(nPixel, m_red) * nInv) / 255,
+                                  (nGreen * nAlpha + Unpack(nPixel, m_green) * nInv) / 255,
+                                  (nBlue * nAlpha + Unpack(nPixel, m_blue) * nInv) / 255);
+                }
+                else
+                {
+                    nPixel = Pack(nRed, nGreen, nBlue);
+                }
+                if(m_nBpp == 16)
+                    *(uint16_t*)pPixel = nPixel;
+                else
+                    *(uint32_t*)pPixel = nPixel;
+            }
+        }
+    }
+
+    /**	Get 8-bit colour component from framebuffer pixel */
+    static uint32_t Unpack(uint32_t nPixel, const struct fb_bitfield& field)
+    {
+        uint32_t nValue = (nPixel >> field.offset) & ((1 << field.length) - 1);
+        return (nValue << (8 - field.length)) | (nValue >> (2 * field.length - 8)); // Replicate high bits into low bits
+    }
+
+    /**	Get framebuffer pixel from 8-bit colour components */
+    uint32_t Pack(uint32_t nRed, uint32_t nGreen, uint32_t nBlue)
+    {
+        return ((nRed >> (8 - m_red.length)) << m_red.offset) | ((nGreen >> (8 - m_green.length)) << m_green.offset) | ((nBlue >> (8 - m_blue.length)) << m_blue.offset);
+    }
+
+    /**	Get framebuffer pixel from 24-bit RGB colour */
+    uint32_t PackRgb(uint32_t nColour)
+    {
+        return Pack((nColour >> 16) & 0xFF, (nColour >> 8) & 0xFF, nColour & 0xFF);
+    }
+
+    GlyphCache m_glyphCache; // Rasterized glyphs
+    bool m_bCache = true; // True to draw text from glyph cache
+    bool m_bKernels = true; // True to fill and copy with vector kernels
+    std::map<std::string, FbBitmap> m_mapBitmaps; // Bitmaps in framebuffer format indexed by name
+    std::string m_sFont; // Path to current font file
+    unsigned int m_nFontWidth = 12; // Current font width in pixels
+    unsigned int m_nFontHeight = 0; // Current font height in pixels
+    bool m_bBaseFontStale = true; // True if ribanfblib font differs from current font
+    uint8_t* m_pBuffer = NULL; // Mapped framebuffer (NULL if unsupported)
+    size_t m_nBufferSize = 0; // Size of mapped framebuffer in bytes
+    unsigned int m_nStride = 0; // Bytes per framebuffer line
+    unsigned int m_nWidth = 0; // Screen width in pixels
+    unsigned int m_nHeight = 0; // Screen height in pixels
+    unsigned int m_nBpp = 0; // Bits per pixel
+    struct fb_bitfield m_red = {}, m_green = {}, m_blue = {}; // Position of colour components within pixel
+};
@@ -9,6 +9,7 @@
 #include <dirent.h> //provides directory management
 #include <unistd.h> //provides pause, alarm
 #include <signal.h> //provides signal handling
+#include <algorithm> //provides stable_sort
 
 void showScreen(int nScreen)
 {
@@ -32,10 +33,7 @@ void showScreen(int nScreen)
     case SCREEN_PERFORMANCE:
         refreshPresetList();
         pScreen->SetSelection(getPresetIndex(g_pCurrentPreset));
-        if(g_bDirty)
-            g_mapScreens[SCREEN_PERFORMANCE]->SetTitle("  *riban Fluidbox");
-        else
-            g_mapScreens[SCREEN_PERFORMANCE]->SetTitle("   riban Fluidbox");
+        pScreen->SetTitle(g_bDirty ? "  *riban Fluidbox" : "   riban Fluidbox");
         break;
     case SCREEN_EDIT_VALUE:
         g_mapScreens[SCREEN_EDIT_VALUE]->SetTitle(g_mapParams[g_nCurrentParam].name);
@@ -45,9 +43,22 @@ void showScreen(int nScreen)
         break;
     case SCREEN_SOUNDFONT_LIST:
         populateSoundfontList();
+        break;
+    case SCREEN_DIAGNOSTICS:
+        populateDiagnostics();
+        break;
     }
-    pScreen->Draw();
+    // Redraw only changed rows when refreshing the current screen unless other drawing may have overwritten it
+    if(nScreen != g_nCurrentScreen || g_nLoadProgress >= 0 || g_nImportProgress >= 0 || g_bCalibrationToast || nScreen == SCREEN_MIXER || nScreen == SCREEN_PRESET_NAME || nScreen == SCREEN_EDIT_VALUE || nScreen == SCREEN_ALERT)
+        pScreen->Draw();
+    else
+        pScreen->Update();
     g_nCurrentScreen = nScreen;
+    g_nLoadProgress = -1; // Any load progress toast has been overwritten
+    g_nImportProgress = -1; // Any import progress toast has been overwritten
+    g_bCalibrationToast = false; // Any calibration toast has been overwritten
+    if(g_calibration.IsActive())
+        g_nCalibrationShown = 0; // Show progress again
 
     // Action after showing ListScreen
     switch(nScreen)
@@ -56,6 +67,11 @@ void showScreen(int nScreen)
         g_nCurrentChannel = 16;
         for(unsigned int nChannel = 0; nChannel < 17; ++nChannel)
             drawMixerChannel(nChannel);
+        // Fall through to start meters
+    case SCREEN_PRESET_PROGRAM:
+        for(unsigned int nChannel = 0; nChannel <= METER_MASTER; ++nChannel)
+            g_anMeterDrawn[nChannel] = -1;
+        g_renderQueue.Post(RENDER_METERS);
         break;
     case SCREEN_PRESET_NAME:
         g_nCurrentChar = 0;
@@ -165,7 +181,12 @@ string toLower(string sString)
 
 bool isUsbMounted()
 {
-    return (system("mount | grep /media/usb > /dev/null") == 0);
+    return g_hotplug.IsUsbMounted();
+}
+
+string getUsbPath(string sFilename)
+{
+    return g_hotplug.GetUsbMount() + "/" + sFilename;
 }
 
 int getPresetIndex(Preset* pPreset)
@@ -183,7 +204,8 @@ void panic(int nMode, int nChannel)
 {
     if(nMode == PANIC_RESET)
     {
-        fluid_synth_system_reset(g_pSynth);
+        g_synthQueue.Send(SYNTH_SYSTEM_RESET);
+        g_synthQueue.Post(onSyncSynthState, (void*)-1);
         return;
     }
     int nMin = nChannel;
@@ -198,10 +220,10 @@ void panic(int nMode, int nChannel)
         switch(nMode)
         {
         case PANIC_NOTES:
-            fluid_synth_all_notes_off(g_pSynth, i);
+            g_synthQueue.Send(SYNTH_ALL_NOTES_OFF, i);
             break;
         case PANIC_SOUNDS:
-            fluid_synth_all_sounds_off(g_pSynth, i);
+            g_synthQueue.Send(SYNTH_ALL_SOUNDS_OFF, i);
             break;
         }
         drawMixerChannel(i);
@@ -210,16 +232,7 @@ void panic(int nMode, int nChannel)
 
 void refreshPresetList()
 {
-    g_mapScreens[SCREEN_PERFORMANCE]->ClearList();
-    for(auto it = g_vPresets.begin(); it != g_vPresets.end(); ++it)
-    {
-        Preset* pPreset = *it;
-        string sName;
-        if(pPreset->dirty)
-            sName += "*";
-        sName += pPreset->name;
-        g_mapScreens[SCREEN_PERFORMANCE]->Add(sName, showScreen, SCREEN_EDIT);
-    }
+    // Entries are read from g_vPresets when drawn so only the selection needs checking
     g_mapScreens[SCREEN_PERFORMANCE]->SetSelection(g_mapScreens[SCREEN_PERFORMANCE]->GetSelection()); // Sets to end if overrun
 }
 
@@ -233,7 +246,10 @@ void setDirty(Preset* pPreset, bool bDirty)
     if(bDirty)
         g_bDirty = true;
     if(g_nCurrentScreen == SCREEN_PERFORMANCE)
-        showScreen(SCREEN_PERFORMANCE);
+    {
+        g_mapScreens[SCREEN_PERFORMANCE]->SetTitle(g_bDirty ? "  *riban Fluidbox" : "   riban Fluidbox");
+        g_mapScreens[SCREEN_PERFORMANCE]->UpdateEntry(getPresetIndex(pPreset));
+    }
 }
 
 bool saveConfig(string sFilename)
@@ -249,7 +265,22 @@ bool saveConfig(string sFilename)
     // Save global configurations
     fileConfig << "[global]" << endl;
     fileConfig << "screen_brightness=" << g_nBacklight << endl;
-    fileConfig << "gain=" << fluid_synth_get_gain(g_pSynth) << endl;
+    fileConfig << "screen_dim_timeout=" << g_nDimTimeout << endl;
+    fileConfig << "screen_dim_brightness=" << g_nDimLevel << endl;
+    fileConfig << "gain=" << g_synthState.GetGain() << endl;
+    fileConfig << "soundfont_cache_mb=" << g_sfCache.GetBudget() << endl;
+    fileConfig << "soundfont_mmap=" << g_sfLoader.GetMmapMode() << endl;
+    fileConfig << "render_fps=" << g_renderQueue.GetRate() << endl;
+    fileConfig << "polyphony=" << g_governor.GetPolyphony() << endl;
+    fileConfig << "dsp_load_ceiling=" << g_governor.GetCeiling() << endl;
+    fileConfig << "dsp_load_hysteresis=" << g_governor.GetHysteresis() << endl;
+    int nPeriodSize = 0, nPeriods = 0;
+    if(fluid_settings_getint(g_pSettings, "audio.period-size", &nPeriodSize) == FLUID_OK && fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods) == FLUID_OK)
+    {
+        fileConfig << "audio_period_size=" << nPeriodSize << endl;
+        fileConfig << "audio_periods=" << nPeriods << endl;
+    }
+    fileConfig << "xruns_lifetime=" << g_xruns.GetLifetime() << endl;
     fileConfig << "style_font=" << g_sFont << endl;
     fileConfig << "style_canvas=0x" << hex << g_style.canvas << endl;
     fileConfig << "style_title_background=0x" << g_style.title_background << endl;
@@ -299,6 +330,76 @@ bool saveConfig(string sFilename)
     return true;
 }
 
+bool updateConfig(const map<string, string>& mapValues, string sFilename)
+{
+    vector<string> vLines;
+    ifstream fileIn(sFilename, ios::in);
+    string sLine;
+    while(getline(fileIn, sLine))
+        vLines.push_back(sLine);
+    fileIn.close();
+
+    // Replace existing values in global group and note where group ends
+    set<string> setDone;
+    string sGroup;
+    int nGlobalEnd = -1;
+    for(unsigned int nLine = 0; nLine < vLines.size(); ++nLine)
+    {
+        size_t nStart = vLines[nLine].find_first_not_of(" \t");
+        if(nStart == string::npos || vLines[nLine][nStart] == '#')
+            continue;
+        if(vLines[nLine][nStart] == '[')
+        {
+            sGroup = vLines[nLine].substr(nStart + 1, vLines[nLine].find_first_of(']') - nStart - 1);
+            if(sGroup == "global")
+                nGlobalEnd = nLine + 1;
+            continue;
+        }
+        if(sGroup != "global")
+            continue;
+        nGlobalEnd = nLine + 1;
+        size_t nDelim = vLines[nLine].find_first_of("=");
+        if(nDelim == string::npos)
+            continue;
+        auto it = mapValues.find(vLines[nLine].substr(nStart, nDelim - nStart));
+        if(it == mapValues.end())
+            continue;
+        vLines[nLine] = it->first + "=" + it->second;
+        setDone.insert(it->first);
+    }
+
+    // Add values that were not already in file
+    vector<string> vNew;
+    for(auto it = mapValues.begin(); it != mapValues.end(); ++it)
+        if(setDone.find(it->first) == setDone.end())
+            vNew.push_back(it->first + "=" + it->second);
+    if(nGlobalEnd < 0)
+    {
+        vNew.insert(vNew.begin(), "[global]");
+        vNew.push_back("");
+        nGlobalEnd = 0;
+    }
+    vLines.insert(vLines.begin() + nGlobalEnd, vNew.begin(), vNew.end());
+
+    // Write to temporary file then replace so that a failed write does not lose configuration
+    string sTemp = sFilename + ".tmp";
+    ofstream fileOut(sTemp, ios::out);
+    if(!fileOut.is_open())
+    {
+        printf("Error: Failed to open configuration: %s\n", sTemp.c_str());
+        return false;
+    }
+    for(auto it = vLines.begin(); it != vLines.end(); ++it)
+        fileOut << *it << endl;
+    fileOut.close();
+    if(fileOut.fail() || rename(sTemp.c_str(), sFilename.c_str()) != 0)
+    {
+        remove(sTemp.c_str());
+        return false;
+    }
+    return true;
+}
+
 void admin(unsigned int nAction)
 {
     string sCommand, sMessage;
@@ -333,7 +434,8 @@ void admin(unsigned int nAction)
         return;
     case SAVE_BACKUP:
         if(isUsbMounted())
-            saveConfig("/media/usb/fluidbox.config");
+            saveConfig(getUsbPath("fluidbox.config"));
+        updateUsbEntries(); // Backup may now be restored
         showScreen(SCREEN_PERFORMANCE);
         g_mapScreens[SCREEN_EDIT]->SetSelection(0);
         return;
@@ -345,7 +447,7 @@ void admin(unsigned int nAction)
         return;
     case LOAD_BACKUP:
         if(isUsbMounted())
-            loadConfig("/media/usb/fluidbox.config");
+            loadConfig(getUsbPath("fluidbox.config"));
         showScreen(SCREEN_PERFORMANCE);
         g_mapScreens[SCREEN_EDIT]->SetSelection(0);
         return;
@@ -408,82 +510,95 @@ double adjustParam(unsigned int nParam, int nChange)
     switch(nParam)
     {
     case REVERB_DAMPING:
-        dValue = fluid_synth_get_reverb_damp(g_pSynth);
+        dValue = g_synthState.GetParam(REVERB_DAMPING);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_reverb_damp(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_REVERB_DAMP, 0, 0, 0, dValue);
+        g_synthState.SetParam(REVERB_DAMPING, dValue);
         g_pCurrentPreset->reverb.damping = dValue;
         break;
     case REVERB_LEVEL:
-        dValue = fluid_synth_get_reverb_level(g_pSynth);
+        dValue = g_synthState.GetParam(REVERB_LEVEL);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_reverb_level(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_REVERB_LEVEL, 0, 0, 0, dValue);
+        g_synthState.SetParam(REVERB_LEVEL, dValue);
         g_pCurrentPreset->reverb.level = dValue;
         break;
     case REVERB_ROOMSIZE:
-        dValue = fluid_synth_get_reverb_roomsize(g_pSynth);
+        dValue = g_synthState.GetParam(REVERB_ROOMSIZE);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_reverb_roomsize(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_REVERB_ROOMSIZE, 0, 0, 0, dValue);
+        g_synthState.SetParam(REVERB_ROOMSIZE, dValue);
         g_pCurrentPreset->reverb.roomsize = dValue;
         break;
     case REVERB_WIDTH:
-        dValue = fluid_synth_get_reverb_width(g_pSynth);
+        dValue = g_synthState.GetParam(REVERB_WIDTH);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_reverb_width(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_REVERB_WIDTH, 0, 0, 0, dValue);
+        g_synthState.SetParam(REVERB_WIDTH, dValue);
         g_pCurrentPreset->reverb.width = dValue;
         break;
     case CHORUS_DEPTH:
-        dValue = fluid_synth_get_chorus_depth(g_pSynth);
+        dValue = g_synthState.GetParam(CHORUS_DEPTH);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_chorus_depth(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_CHORUS_DEPTH, 0, 0, 0, dValue);
+        g_synthState.SetParam(CHORUS_DEPTH, dValue);
         g_pCurrentPreset->chorus.depth = dValue;
         break;
     case CHORUS_LEVEL:
-        dValue = fluid_synth_get_chorus_level(g_pSynth);
+        dValue = g_synthState.GetParam(CHORUS_LEVEL);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_chorus_level(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_CHORUS_LEVEL, 0, 0, 0, dValue);
+        g_synthState.SetParam(CHORUS_LEVEL, dValue);
         g_pCurrentPreset->chorus.level = dValue;
         break;
     case CHORUS_SPEED:
-        dValue = fluid_synth_get_chorus_speed(g_pSynth);
+        dValue = g_synthState.GetParam(CHORUS_SPEED);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_chorus_speed(g_pSynth, dValue);
+        g_synthQueue.Send(SYNTH_CHORUS_SPEED, 0, 0, 0, dValue);
+        g_synthState.SetParam(CHORUS_SPEED, dValue);
         g_pCurrentPreset->chorus.speed = dValue;
         break;
     case CHORUS_TYPE:
     {
         if(nChange > 0)
-            fluid_synth_set_chorus_type(g_pSynth, FLUID_CHORUS_MOD_TRIANGLE);
+        {
+            g_synthQueue.Send(SYNTH_CHORUS_TYPE, 0, FLUID_CHORUS_MOD_TRIANGLE);
+            g_synthState.SetParam(CHORUS_TYPE, FLUID_CHORUS_MOD_TRIANGLE);
+        }
         else if(nChange < 0)
-            fluid_synth_set_chorus_type(g_pSynth, FLUID_CHORUS_MOD_SINE);
-        nValue = fluid_synth_get_chorus_type(g_pSynth);
+        {
+            g_synthQueue.Send(SYNTH_CHORUS_TYPE, 0, FLUID_CHORUS_MOD_SINE);
+            g_synthState.SetParam(CHORUS_TYPE, FLUID_CHORUS_MOD_SINE);
+        }
+        nValue = g_synthState.GetParam(CHORUS_TYPE);
         g_pCurrentPreset->chorus.type = nValue;
         string sText = "Chorus type       ";
         sText += (nValue==FLUID_CHORUS_MOD_SINE)?"SINE":" TRI";
@@ -491,13 +606,14 @@ double adjustParam(unsigned int nParam, int nChange)
         return nValue;
     }
     case CHORUS_VOICES:
-        dValue = fluid_synth_get_chorus_nr(g_pSynth);
+        dValue = g_synthState.GetParam(CHORUS_VOICES);
         dValue += nChange * dDelta;
         if(dValue > dMax)
             dValue = dMax;
         else if(dValue < dMin)
             dValue = dMin;
-        fluid_synth_set_chorus_nr(g_pSynth, (int)dValue);
+        g_synthQueue.Send(SYNTH_CHORUS_NR, 0, (int)dValue);
+        g_synthState.SetParam(CHORUS_VOICES, dValue);
         g_pCurrentPreset->chorus.voicecount = dValue;
         break;
 	case BACKLIGHT_BRIGHTNESS:
@@ -529,7 +645,8 @@ void enableEffect(unsigned int nEffect, bool bEnable)
     string sText;
     if(nEffect == REVERB_ENABLE)
     {
-        fluid_synth_set_reverb_on(g_pSynth, bEnable);
+        g_synthQueue.Send(SYNTH_REVERB_ON, 0, bEnable);
+        g_synthState.SetParam(REVERB_ENABLE, bEnable);
         if(g_pCurrentPreset->reverb.enable != bEnable)
             setDirty();
         g_pCurrentPreset->reverb.enable = bEnable;
@@ -537,7 +654,8 @@ void enableEffect(unsigned int nEffect, bool bEnable)
     }
     else if(nEffect == CHORUS_ENABLE)
     {
-        fluid_synth_set_chorus_on(g_pSynth, bEnable);
+        g_synthQueue.Send(SYNTH_CHORUS_ON, 0, bEnable);
+        g_synthState.SetParam(CHORUS_ENABLE, bEnable);
         if(g_pCurrentPreset->chorus.enable != bEnable)
             setDirty();
         g_pCurrentPreset->chorus.enable = bEnable;
@@ -558,13 +676,13 @@ void editParam(unsigned int nParam)
     case REVERB_ENABLE:
         {
             enableEffect(nParam, !(g_pCurrentPreset->reverb.enable));
-            g_mapScreens[SCREEN_EFFECTS]->Draw();
+            g_mapScreens[SCREEN_EFFECTS]->Update();
             return;
         }
     case CHORUS_ENABLE:
         {
             enableEffect(nParam, !(g_pCurrentPreset->chorus.enable));
-            g_mapScreens[SCREEN_EFFECTS]->Draw();
+            g_mapScreens[SCREEN_EFFECTS]->Update();
             return;
         }
     case CHORUS_VOICES:
@@ -593,28 +711,19 @@ void setPresetProgram(int nBankProgram)
     int nProgram = nBankProgram & 0xFF;
     g_pCurrentPreset->program[g_nCurrentChannel].bank = nBank;
     g_pCurrentPreset->program[g_nCurrentChannel].program = nProgram;
-    fluid_synth_bank_select(g_pSynth, g_nCurrentChannel, nBank);
-    fluid_synth_program_change(g_pSynth, g_nCurrentChannel, nProgram);
+    g_synthQueue.Send(SYNTH_PROGRAM_SELECT, g_nCurrentChannel, g_nCurrentSoundfont, nBankProgram); // Several soundfonts may be loaded so bind channel to current soundfont
+    setChannelProgram(g_nCurrentChannel, nBank, nProgram);
     setDirty();
+    if(g_sfCache.Find(getLoadPath(g_pCurrentPreset->soundfont, g_pCurrentPreset)) != g_nCurrentSoundfont)
+        loadSoundfont(g_pCurrentPreset->soundfont); // Program is not in slimmed copy so load whole soundfont
 }
 
 void populateProgram(int nChannel)
 {
-    g_mapScreens[SCREEN_PROGRAM]->ClearList();
     g_nCurrentChannel = nChannel;
-    fluid_sfont_t* pFont = fluid_synth_get_sfont_by_id(g_pSynth, g_nCurrentSoundfont);
-
-    fluid_preset_t* pProgram;
-    fluid_sfont_iteration_start(pFont);
-    int nBank, nProgram;
-    while((pProgram = fluid_sfont_iteration_next(pFont)))
-    {
-        nBank = fluid_preset_get_banknum(pProgram);
-        nProgram = fluid_preset_get_num(pProgram);
-        int nEntry = g_mapScreens[SCREEN_PROGRAM]->Add(fluid_preset_get_name(pProgram), setPresetProgram, (nBank << 8) + nProgram);
-        if(g_pCurrentPreset->program[g_nCurrentChannel].bank == nBank && g_pCurrentPreset->program[g_nCurrentChannel].program == nProgram)
-            g_mapScreens[SCREEN_PROGRAM]->SetSelection(nEntry);
-    }
+    g_presetIndex.Load(getSoundfontPath(g_pCurrentPreset->soundfont)); // List entries are read from index when drawn
+    int nEntry = g_presetIndex.Find(g_pCurrentPreset->program[g_nCurrentChannel].bank, g_pCurrentPreset->program[g_nCurrentChannel].program);
+    g_mapScreens[SCREEN_PROGRAM]->SetSelection(nEntry < 0 ? 0 : nEntry);
     showScreen(SCREEN_PROGRAM);
 }
 
@@ -622,16 +731,24 @@ string getProgramName(unsigned int nChannel)
 {
     if(nChannel > 15)
         return "";
-    int nSfId, nBank, nProgram;
-    fluid_synth_get_program(g_pSynth, nChannel, &nSfId, &nBank, &nProgram);
-    fluid_sfont_t* pSoundfont = fluid_synth_get_sfont_by_id(g_pSynth, nSfId);
-    if(pSoundfont)
-    {
-        fluid_preset_t* pPreset = fluid_sfont_get_preset(pSoundfont, nBank, nProgram);
-        if(pPreset)
-            return fluid_preset_get_name(pPreset);
-    }
-    return "";
+    return g_channelProgram[nChannel].name;
+}
+
+void setChannelProgram(unsigned int nChannel, unsigned int nBank, unsigned int nProgram)
+{
+    if(nChannel > 15)
+        return;
+    g_channelProgram[nChannel].bank = nBank;
+    g_channelProgram[nChannel].program = nProgram;
+    g_channelProgram[nChannel].name = g_presetIndex.GetName(nBank, nProgram);
+}
+
+void refreshChannelPrograms()
+{
+    if(!g_pCurrentPreset)
+        return;
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        setChannelProgram(nChannel, g_pCurrentPreset->program[nChannel].bank, g_pCurrentPreset->program[nChannel].program);
 }
 
 void showEditProgram(unsigned int)
@@ -649,23 +766,57 @@ void showEditProgram(unsigned int)
     showScreen(SCREEN_PRESET_PROGRAM);
 }
 
-void showMidiActivity(int nChannel)
+int meterLength(float fLevel, int nLength)
 {
-    if(g_nCurrentScreen == SCREEN_PRESET_PROGRAM && nChannel >= g_mapScreens[SCREEN_PRESET_PROGRAM]->GetFirstShown() && nChannel <= g_mapScreens[SCREEN_PRESET_PROGRAM]->GetFirstShown() + 6)
+    if(fLevel <= 0.0f)
+        return 0;
+    float fDb = 20.0f * log10(fLevel);
+    int nPixels = (fDb - METER_FLOOR_DB) * nLength / -METER_FLOOR_DB;
+    if(nPixels < 0)
+        return 0;
+    if(nPixels > nLength)
+        return nLength;
+    return nPixels;
+}
+
+void drawMeter(unsigned int nChannel)
+{
+    if(nChannel > METER_MASTER)
+        return;
+    MeterLevel level = g_meters.Read(nChannel, getMicros() / 1000);
+    if(g_nCurrentScreen == SCREEN_PRESET_PROGRAM)
     {
-        int nY = 16 + (nChannel - g_mapScreens[SCREEN_PRESET_PROGRAM]->GetFirstShown()) * 16; //Upper left corner of channel indicator
+        int nFirst = g_mapScreens[SCREEN_PRESET_PROGRAM]->GetFirstShown();
+        if(nChannel == METER_MASTER || (int)nChannel < nFirst || (int)nChannel > nFirst + 6)
+            return;
+        int nLevel = meterLength(level.rms, 15);
+        int nHold = meterLength(level.hold, 15);
+        int nDrawn = nLevel | nHold << 8 | (nChannel - nFirst) << 16; // Row is included so scrolling redraws
+        if(nDrawn == g_anMeterDrawn[nChannel])
+            return;
+        g_anMeterDrawn[nChannel] = nDrawn;
+        int nY = 16 + (nChannel - nFirst) * 16; //Upper left corner of channel indicator
         g_pScreen->DrawRect(0,nY, 1,nY+15, BLACK, 0, g_style.canvas); // Clear the indicator
-        int nCount = (g_nNoteCount[nChannel] < 16)?g_nNoteCount[nChannel]:15; // Limit max note indication to 15
-        if(nCount)
-            g_pScreen->DrawRect(0, nY + 15, 1, nY + 15-nCount, RED, 0, RED); // Draw indicator
+        if(nLevel)
+            g_pScreen->DrawRect(0, nY + 15, 1, nY + 16 - nLevel, RED, 0, RED); // Draw level
+        if(nHold > nLevel)
+            g_pScreen->DrawRect(0, nY + 16 - nHold, 1, nY + 16 - nHold, WHITE, 0, WHITE); // Draw peak hold
     }
     else if(g_nCurrentScreen == SCREEN_MIXER)
     {
-        int nX = 15 + nChannel * 9; //Upper left corner of channel indicator
-        g_pScreen->DrawRect(nX, 126, nX + 9, 127, BLACK, 0, g_style.canvas); // Clear the indicator
-        int nCount = (g_nNoteCount[nChannel] < 10)?g_nNoteCount[nChannel]:9; // Limit max note indication to 9
-        if(nCount)
-            g_pScreen->DrawRect(nX, 126, nX + nCount, 127, RED, 0, RED); // Draw indicator
+        int nX = (nChannel == METER_MASTER) ? 0 : 15 + nChannel * 9; //Left of channel indicator
+        int nLevel = meterLength(level.rms, 9);
+        int nHold = meterLength(level.hold, 9);
+        int nDrawn = nLevel | nHold << 8 | level.clip << 16;
+        if(nDrawn == g_anMeterDrawn[nChannel])
+            return;
+        g_anMeterDrawn[nChannel] = nDrawn;
+        g_pScreen->DrawRect(nX, 126, nX + 8, 127, BLACK, 0, g_style.canvas); // Clear the indicator
+        uint32_t nColour = level.clip ? RED : GREEN;
+        if(nLevel)
+            g_pScreen->DrawRect(nX, 126, nX + nLevel - 1, 127, nColour, 0, nColour); // Draw level
+        if(nHold > nLevel)
+            g_pScreen->DrawRect(nX + nHold - 1, 126, nX + nHold - 1, 127, WHITE, 0, WHITE); // Draw peak hold
     }
 }
 
@@ -681,12 +832,13 @@ void drawMixerChannel(unsigned int nChannel)
     if(nChannel == 16)
     {
         // Master volume
-        nLevel = fluid_synth_get_gain(g_pSynth) * 400;
+        nLevel = g_synthState.GetGain() * 400;
         nX = 0;
     }
     else
     {
-        if(FLUID_FAILED == fluid_synth_get_cc(g_pSynth, nChannel, 7, &nLevel))
+        nLevel = g_synthState.GetCC(nChannel, 7);
+        if(nLevel < 0)
           return;
         nLevel = (nLevel * 100) / 127;
     }
@@ -726,56 +878,71 @@ void listSoundfont(int nAction)
     showScreen(SCREEN_SOUNDFONT_LIST);
 }
 
-void copyFile(string sSource, string sDest)
+void importSoundfont(string sSource, string sDest)
 {
-    int nSrc = open(sSource.c_str(), O_RDONLY, 0);
-    if(nSrc == -1)
-        return;
-    int nDst = open(sDest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR); //!@todo File is created with wrong permissions
-    if(nDst == -1)
-    {
-        close(nSrc);
-        return;
-    }
-    struct stat fileStat;
-    stat(sSource.c_str(), &fileStat);
-    if(fileStat.st_blocks < 1)
+    g_importer.Import(sSource, sDest, true);
+    g_mapScreens[SCREEN_SOUNDFONT]->Enable(2); // Cancel import
+}
+
+void cancelImport(unsigned int)
+{
+    g_importer.Cancel();
+}
+
+void processImports()
+{
+    FileImport result;
+    while(g_importer.GetResult(result))
     {
-        close(nSrc);
-        close(nDst);
-        return;
-    }
-    size_t nBlocks = fileStat.st_blocks * 512 / fileStat.st_blksize; // Quantity of blocks based on file system block size
-    float fX = 0;
-    float fDx =  159.0 / nBlocks;
-    int nX = 0;
-    char* pBuffer = (char*)malloc(sizeof(char)*fileStat.st_blksize);
-    g_pScreen->DrawRect(0,100, 159,127, WHITE, 1, GREY);
-    size_t nSize;
-    while(g_nRunState && ((nSize = read(nSrc, pBuffer, fileStat.st_blksize)) > 0))
-    {
-        write(nDst, pBuffer, nSize);
-        // Update progress bar
-        fX += fDx;
-        if(int(fX) > nX)
+        bool bRefresh = g_nImportProgress >= 0 || g_nCurrentScreen == SCREEN_SOUNDFONT_LIST || g_nCurrentScreen == SCREEN_PRESET_SF; // Remove progress toast, show new soundfont
+        if(result.success)
         {
-            nX = fX;
-            g_pScreen->DrawRect(0,100, nX,127, WHITE, 1, GREEN);
+            cout << "Imported soundfont " << result.source << " to " << result.dest << endl;
+            g_mapLoadPaths.clear(); // Slimmed copy of replaced soundfont is no longer current
+            if(result.dest != getSoundfontPath(g_pCurrentPreset->soundfont))
+                g_sfCache.Unload(result.dest); // Release previous version of replaced soundfont unless it is playing
+        }
+        else
+        {
+            cerr << "Failed to import soundfont " << result.source << ": " << result.error << endl;
+            if(result.error != "Cancelled")
+            {
+                alert(result.error, " IMPORT FAILED", NULL, 5);
+                bRefresh = false;
+            }
         }
+        if(bRefresh)
+            showScreen(g_nCurrentScreen);
     }
-    g_pScreen->DrawText("Flushing file...", 5, 120, BLACK);
-    close(nDst); // There is a delay whilst file is flushed to disk
-    close(nSrc);
-    free(pBuffer);
+    if(!g_importer.IsBusy())
+        g_mapScreens[SCREEN_SOUNDFONT]->Enable(2, false); // Cancel import
+}
+
+void showImportProgress()
+{
+    if(g_nCurrentScreen == SCREEN_LOGO || g_nCurrentScreen == SCREEN_ALERT || !g_sLoadingSoundfont.empty())
+        return; // Soundfont load progress takes priority
+    int nProgress = g_importer.GetProgress();
+    if(nProgress < 0 || nProgress == g_nImportProgress)
+        return;
+    g_nImportProgress = nProgress;
+    g_pScreen->DrawRect(2,100, 157,124, g_colourToastBg, 5, g_colourToastBg, QUADRANT_ALL, 5);
+    g_pScreen->DrawText("Importing soundfont", 4, 116, WHITE);
+    g_pScreen->DrawRect(8,119, 8 + nProgress * 143 / 100,121, WHITE, 0, WHITE);
 }
 
 void deleteFile()
 {
+    string sFilename = g_mapScreens[SCREEN_SOUNDFONT_LIST]->GetEntryText(g_mapScreens[SCREEN_SOUNDFONT_LIST]->GetSelection());
+    string sPath = getSoundfontPath(sFilename);
+    if(sPath != getSoundfontPath(g_pCurrentPreset->soundfont))
+        g_sfCache.Unload(sPath); // Release memory of deleted soundfont unless it is playing
     string sCommand = "sudo rm sf2/'";
-    sCommand += g_mapScreens[SCREEN_SOUNDFONT_LIST]->GetEntryText(g_mapScreens[SCREEN_SOUNDFONT_LIST]->GetSelection());
+    sCommand += sFilename;
     sCommand += "'";
     system(sCommand.c_str());
     cout << sCommand << endl;
+    g_mapLoadPaths.clear(); // Slimmed copy is no longer current
 }
 
 void alert(string sMessage, string sTitle, function<void(void)>  pFunction, unsigned int nTimeout)
@@ -793,25 +960,204 @@ void alert(string sMessage, string sTitle, function<void(void)>  pFunction, unsi
     g_pScreen->SetFont(DEFAULT_FONT_SIZE);
     g_pAlertCallback = pFunction;
     if(nTimeout)
-        alarm(nTimeout);
+        g_timerIdle.Start(nTimeout * 1000);
 }
 
-bool loadSoundfont(string sFilename)
+string getSoundfontPath(string sFilename)
 {
-    if(g_nCurrentSoundfont >= 0)
-    {
-        fluid_synth_sfunload(g_pSynth, g_nCurrentSoundfont, 0);
-        g_nCurrentSoundfont = -1;
-    }
     string sPath = SF_ROOT;
     if(sFilename[0] == '~')
         sFilename = "default/" + sFilename.substr(1);
     sPath += sFilename;
+    return sPath;
+}
+
+string getLoadPath(string sFilename, Preset* pPreset)
+{
+    string sPath = getSoundfontPath(sFilename);
+    if(!pPreset)
+        return sPath;
+    // Key includes programs so that changing a preset's programs resolves its path again
+    string sKey = sFilename;
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        sKey += " " + to_string(pPreset->program[nChannel].bank) + ":" + to_string(pPreset->program[nChannel].program);
+    auto it = g_mapLoadPaths.find(sKey);
+    if(it != g_mapLoadPaths.end())
+        return it->second;
+    string& sLoadPath = g_mapLoadPaths[sKey];
+    sLoadPath = sPath;
+    string sSlimPath = SoundfontSlimmer::GetSlimPath(sPath.substr(strlen(SF_ROOT)));
+    if(!SoundfontSlimmer::IsCurrent(sPath, sSlimPath) || !g_slimIndex.Load(sSlimPath))
+        return sLoadPath;
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        if(g_slimIndex.Find(pPreset->program[nChannel].bank, pPreset->program[nChannel].program) < 0)
+            return sLoadPath; // Program selected since soundfont was slimmed
+    sLoadPath = sSlimPath;
+    return sLoadPath;
+}
+
+void checkSlimCopies()
+{
+    uint64_t nModified = 0;
+    struct stat dirStat;
+    for(const char* sDir : {SF_SLIM_ROOT, SF_SLIM_ROOT "default"})
+        if(stat(sDir, &dirStat) == 0)
+            nModified = max(nModified, (uint64_t)dirStat.st_mtim.tv_sec * 1000000000 + dirStat.st_mtim.tv_nsec);
+    if(nModified != g_nSlimModified)
+        g_mapLoadPaths.clear();
+    g_nSlimModified = nModified;
+}
+
+bool loadSoundfont(string sFilename)
+{
+    string sPath = getLoadPath(sFilename, g_pCurrentPreset);
+    if(g_setPrefetch.insert(sPath).second)
+    {
+        // Path differs from that chosen when prefetch target was set, e.g. program not in slimmed copy, so must not be evicted or dropped from loader
+        g_sfCache.SetProtected(g_setPrefetch);
+        g_sfLoader.Retain(g_setPrefetch);
+    }
+    int nSoundfont = g_sfCache.Find(sPath);
+    if(nSoundfont >= 0)
+    {
+        // Already resident so just swap programs
+        g_nCurrentSoundfont = nSoundfont;
+        g_sLoadingSoundfont = "";
+        g_presetIndex.Load(getSoundfontPath(sFilename)); // Program names and lists always show the whole soundfont
+        refreshChannelPrograms();
+        queueProgramSwap(g_pCurrentPreset);
+        return true;
+    }
+    struct stat fileStat;
+    if(stat(sPath.c_str(), &fileStat) != 0)
+        return false;
+    g_presetIndex.Load(getSoundfontPath(sFilename));
+    refreshChannelPrograms();
+    g_sLoadingSoundfont = sPath;
+    g_nLoadProgress = -1;
+    g_sfLoader.Request(sPath, true);
+    return true;
+}
+
+void setPrefetchTarget(int nPreset)
+{
+    checkSlimCopies();
+    g_setPrefetch.clear();
+    for(int nIndex = nPreset - PREFETCH_DISTANCE; nIndex <= nPreset + PREFETCH_DISTANCE; ++nIndex)
+        if(nIndex >= 0 && nIndex < g_vPresets.size())
+            g_setPrefetch.insert(getLoadPath(g_vPresets[nIndex]->soundfont, g_vPresets[nIndex]));
+    g_sfCache.SetProtected(g_setPrefetch);
+    g_sfLoader.Retain(g_setPrefetch);
+}
+
+void prefetchPresets()
+{
+    g_sfCache.Evict();
+    for(auto it = g_setPrefetch.begin(); it != g_setPrefetch.end(); ++it)
+    {
+        if(g_sfCache.IsResident(*it) || *it == g_sLoadingSoundfont)
+            continue;
+        struct stat fileStat;
+        if(stat((*it).c_str(), &fileStat) != 0)
+            continue;
+        if(g_sfCache.Evict(fileStat.st_size))
+            g_sfLoader.Request(*it);
+    }
+}
+
+void processSoundfontLoads()
+{
+    SoundfontLoad result;
+    while(g_sfLoader.GetResult(result))
+    {
+        int nSoundfont = g_sfCache.Add(result.path, result.sfont);
+        cout << "Loaded soundfont " << result.path << " in " << result.duration << "ms" << endl;
+        if(result.path != g_sLoadingSoundfont)
+            continue;
+        g_sLoadingSoundfont = "";
+        if(nSoundfont < 0)
+            cerr << "Failed to load soundfont " << result.path << endl;
+        else
+        {
+            g_nCurrentSoundfont = nSoundfont;
+            queueProgramSwap(g_pCurrentPreset);
+        }
+        showScreen(g_nCurrentScreen); // Remove progress toast
+    }
+    if(g_bEvictPending && !g_bProgramSwapPending)
+    {
+        // New programs are playing so old soundfonts may be retired and neighbours loaded
+        prefetchPresets();
+        g_bEvictPending = false;
+    }
+}
+
+void showLoadProgress()
+{
+    if(g_sLoadingSoundfont.empty() || g_nCurrentScreen == SCREEN_LOGO)
+        return;
+    int nProgress = g_sfLoader.GetProgress(g_sLoadingSoundfont);
+    if(nProgress < 0)
+        nProgress = 0; // Waiting behind another load
+    if(nProgress == g_nLoadProgress)
+        return;
+    g_nLoadProgress = nProgress;
     g_pScreen->DrawRect(2,100, 157,124, g_colourToastBg, 5, g_colourToastBg, QUADRANT_ALL, 5);
-    g_pScreen->DrawText("Loading soundfont", 4, 118, WHITE);
-    g_nCurrentSoundfont = fluid_synth_sfload(g_pSynth, sPath.c_str(), 1);
-    showScreen(g_nCurrentScreen);
-    return (g_nCurrentSoundfont >= 0);
+    g_pScreen->DrawText("Loading soundfont", 4, 116, WHITE);
+    g_pScreen->DrawRect(8,119, 8 + nProgress * 143 / 100,121, WHITE, 0, WHITE);
+}
+
+void logGovernor()
+{
+    GovernorEvent event;
+    while(g_governor.GetEvent(event))
+    {
+        printf("Polyphony %s from %u to %u: DSP load %u%% (block %u%%) with %u voices in preset '%s'\n",
+            event.to < event.from ? "reduced" : "restored", event.from, event.to, event.load, event.peak, event.voices,
+            g_pCurrentPreset ? g_pCurrentPreset->name.c_str() : "");
+    }
+}
+
+void logDroppedCommands()
+{
+    unsigned int nDropped = g_synthQueue.GetDropped();
+    if(nDropped)
+        cerr << "Synth command queue full: dropped " << nDropped << " commands" << endl;
+}
+
+void queueProgramSwap(Preset* pPreset)
+{
+    if(!pPreset)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutexProgramSwap);
+        g_programSwap.soundfont = g_nCurrentSoundfont;
+        for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        {
+            g_programSwap.bank[nChannel] = pPreset->program[nChannel].bank;
+            g_programSwap.program[nChannel] = pPreset->program[nChannel].program;
+            g_programSwap.level[nChannel] = pPreset->program[nChannel].level;
+            g_programSwap.balance[nChannel] = pPreset->program[nChannel].balance;
+        }
+        g_bProgramSwapPending = true;
+    }
+    g_bEvictPending = true;
+}
+
+void applyProgramSwap()
+{
+    if(!g_bProgramSwapPending || !g_mutexProgramSwap.try_lock())
+        return;
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+    {
+        fluid_synth_program_select(g_pSynth, nChannel, g_programSwap.soundfont, g_programSwap.bank[nChannel], g_programSwap.program[nChannel]);
+        fluid_synth_cc(g_pSynth, nChannel, 7, g_programSwap.level[nChannel]);
+        fluid_synth_cc(g_pSynth, nChannel, 8, g_programSwap.balance[nChannel]);
+        g_synthState.SetCC(nChannel, 7, g_programSwap.level[nChannel]);
+        g_synthState.SetCC(nChannel, 8, g_programSwap.balance[nChannel]);
+    }
+    g_bProgramSwapPending = false;
+    g_mutexProgramSwap.unlock();
 }
 
 void onSelectSoundfont(int nAction)
@@ -822,11 +1168,8 @@ void onSelectSoundfont(int nAction)
     {
     case SF_ACTION_COPY:
     {
-        string sSrc = "/media/usb/";
-        sSrc += sFilename;
-        string sDst = "sf2/";
-        sDst += sFilename;
-        copyFile(sSrc, sDst);
+        string sSrc = getUsbPath(sFilename);
+        importSoundfont(sSrc, SF_ROOT + sFilename);
         showScreen(g_mapScreens[SCREEN_SOUNDFONT_LIST]->GetParent());
         break;
     }
@@ -849,13 +1192,14 @@ void populateSoundfontList()
     struct dirent *ent;
 
     ListScreen* pScreen = g_mapScreens[SCREEN_SOUNDFONT_LIST];
-    pScreen->ClearList();
+    g_vSoundfontFiles.clear();
+    int nSelection = 0;
     vector<string> vPaths;
 
     switch(g_nSoundfontAction)
     {
     case SF_ACTION_COPY:
-        vPaths.push_back("/media/usb");
+        vPaths.push_back(g_hotplug.GetUsbMount());
         pScreen->SetTitle("Copy soundfont");
         pScreen->SetParent(SCREEN_SOUNDFONT);
         break;
@@ -882,59 +1226,368 @@ void populateSoundfontList()
                     continue; // not the sf2 file we are looking for...
                 if((*it) == "sf2/default")
                     sFilename = "~" + sFilename;
-                int nEntry = pScreen->Add(sFilename, onSelectSoundfont, g_nSoundfontAction);
+                g_vSoundfontFiles.push_back(sFilename);
                 if(g_pCurrentPreset->soundfont == sFilename)
-                    pScreen->SetSelection(nEntry);
+                    nSelection = g_vSoundfontFiles.size() - 1;
             }
+            closedir(dir);
         }
     }
+    pScreen->SetSelection(nSelection);
 }
 
-int onMidiEvent(void* pData, fluid_midi_event_t* pEvent)
+LATENCY_TYPE getLatencyType(int nType)
 {
-    fluid_synth_handle_midi_event(pData, pEvent);
-    int nChannel = fluid_midi_event_get_channel(pEvent);
-    int nType = fluid_midi_event_get_type(pEvent);
     switch(nType)
     {
-    case 0xC0: //PROGRAM_CHANGE
+    case 0x80:
+        return LATENCY_NOTE_OFF;
+    case 0x90:
+        return LATENCY_NOTE_ON;
+    case 0xB0:
+        return LATENCY_CONTROL;
+    case 0xC0:
+        return LATENCY_PROGRAM;
+    case 0xE0:
+        return LATENCY_PITCHBEND;
+    }
+    return LATENCY_OTHER;
+}
+
+int onMidiInput(void* pData, fluid_midi_event_t* pEvent)
+{
+    // fluidsynth does not expose ALSA sequencer timestamps so driver callback is earliest point we can measure
+    g_nMidiArrival = getMicros();
+    return fluid_midi_router_handle_midi_event(pData, pEvent);
+}
+
+int onMidiEvent(void* pData, fluid_midi_event_t* pEvent)
+{
+    g_synthQueue.HandleMidiEvent(pEvent);
+    MidiActivity activity;
+    activity.type = fluid_midi_event_get_type(pEvent);
+    if(g_nMidiArrival)
     {
-        int nProgram = fluid_midi_event_get_program(pEvent);
-        g_pCurrentPreset->program[nChannel].program = nProgram;
-        setDirty();
-        if(g_nCurrentScreen == SCREEN_PRESET_PROGRAM)
-            showEditProgram();
-        break;
+        LATENCY_TYPE nLatencyType = getLatencyType(activity.type);
+        g_latencyHandle[nLatencyType].Add(getMicros() - g_nMidiArrival);
+        uint64_t nPending = 0;
+        g_nLatencyPending[nLatencyType].compare_exchange_strong(nPending, g_nMidiArrival); // Only oldest unrendered event is tracked
+        g_nMidiArrival = 0;
     }
-    case 0x80: //NOTE_OFF
-        if(g_nNoteCount[nChannel] > 0)
-            g_nNoteCount[nChannel]--;
-        showMidiActivity(nChannel);
-        break;
-    case 0x90: //NOTE_ON
-        if(fluid_midi_event_get_value(pEvent))
-            g_nNoteCount[nChannel]++;
-        else if(g_nNoteCount[nChannel] > 0)
-            g_nNoteCount[nChannel]--;
-        showMidiActivity(nChannel);
+    activity.channel = fluid_midi_event_get_channel(pEvent);
+    switch(activity.type)
+    {
+    case 0xC0: //PROGRAM_CHANGE
+        activity.value1 = fluid_midi_event_get_program(pEvent);
         break;
     case 0xB0: //CONTROL_CHANGE
-        switch(fluid_midi_event_get_control(pEvent))
+        activity.value1 = fluid_midi_event_get_control(pEvent);
+        activity.value2 = fluid_midi_event_get_value(pEvent);
+        if(activity.value1 == 121)
+            g_synthQueue.Post(onSyncSynthState, (void*)(intptr_t)activity.channel, false); // Reset all controllers - synth decides which are reset
+        else
+            g_synthState.SetCC(activity.channel, activity.value1, activity.value2);
+        if(activity.value1 != 7)
+            return 0; // Not of interest to UI
+        break;
+    case 0xFF: //SYSTEM_RESET
+        g_synthQueue.Post(onSyncSynthState, (void*)-1, false);
+        return 0;
+    default:
+        return 0;
+    }
+    g_midiQueue.Push(activity); // Drop event if queue is full - UI will catch up
+    g_renderQueue.Post(RENDER_MIDI);
+    return 0;
+}
+
+void processMidiQueue()
+{
+    MidiActivity activity;
+    unsigned int nMixer = 0; // Bitmask of channels with changed level
+    bool bDirty = false;
+    bool bProgram = false;
+    while(g_midiQueue.Pop(activity))
+    {
+        unsigned int nChannel = activity.channel & 0x0F;
+        switch(activity.type)
         {
-        case 7:
-            g_pCurrentPreset->program[nChannel].level = fluid_midi_event_get_value(pEvent);
-            drawMixerChannel(nChannel);
-            setDirty();
+        case 0xC0: //PROGRAM_CHANGE
+            g_pCurrentPreset->program[nChannel].program = activity.value1;
+            setChannelProgram(nChannel, g_pCurrentPreset->program[nChannel].bank, activity.value1);
+            nMixer |= 1 << nChannel;
+            bDirty = true;
+            bProgram = true;
             break;
-        case 120: // All sound off
-        case 123: // All notes off
-            g_nNoteCount[nChannel] = 0;
-            showMidiActivity(nChannel);
+        case 0xB0: //CONTROL_CHANGE
+            if(activity.value1 == 7)
+            {
+                g_pCurrentPreset->program[nChannel].level = activity.value2;
+                nMixer |= 1 << nChannel;
+                bDirty = true;
+            }
             break;
         }
-        break;
     }
-    return 0;
+    // Redraw each affected element once per frame, however many events were queued
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+    {
+        if(nMixer & (1 << nChannel))
+            g_renderQueue.Post(RENDER_MIXER, nChannel);
+    }
+    if(bDirty && !(g_pCurrentPreset && g_pCurrentPreset->dirty))
+        setDirty();
+    if(bProgram && g_nCurrentScreen == SCREEN_PRESET_PROGRAM)
+        showEditProgram();
+    if(bProgram && g_sfCache.Find(getLoadPath(g_pCurrentPreset->soundfont, g_pCurrentPreset)) != g_nCurrentSoundfont)
+        loadSoundfont(g_pCurrentPreset->soundfont); // Program is not in slimmed copy so load whole soundfont
+}
+
+int onAudio(void* pData, int nLen, int nFx, float* pFx[], int nOut, float* pOut[])
+{
+    // Events already handled are rendered in this block, those arriving during render are left for next block
+    uint64_t aPending[LATENCY_EOL];
+    for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+        aPending[nType] = g_nLatencyPending[nType].exchange(0, std::memory_order_relaxed);
+    uint64_t nStart = getMicros();
+    if(g_xruns.Check(nStart))
+        g_notifier.Notify(); // Wake UI to log xrun
+    g_synthQueue.Process();
+    applyProgramSwap();
+    int nResult = renderAudio((fluid_synth_t*)pData, nLen, pOut[0], pOut[1]);
+    uint64_t nNow = getMicros();
+    unsigned int nPolyphony = g_governor.Update(nNow - nStart, nLen * 1000000.0 / g_dSampleRate, fluid_synth_get_active_voice_count((fluid_synth_t*)pData), nNow / 1000);
+    if(nPolyphony)
+    {
+        fluid_synth_set_polyphony((fluid_synth_t*)pData, nPolyphony);
+        g_notifier.Notify(); // Wake UI to log change
+    }
+    for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+        if(aPending[nType])
+            g_latencyRender[nType].Add(nNow - aPending[nType]);
+    return nResult;
+}
+
+int renderAudio(fluid_synth_t* pSynth, int nLen, float* pLeft, float* pRight)
+{
+    float* apFx[4] = {pLeft, pRight, pLeft, pRight}; // Mix reverb and chorus into main output
+    float** ppChannels = g_meters.GetBuffers(nLen);
+    if(!ppChannels)
+    {
+        // Block larger than meter buffers - render all channels directly to output
+        float* apOut[2] = {pLeft, pRight};
+        int nResult = fluid_synth_process(pSynth, nLen, 4, apFx, 2, apOut);
+        g_meters.ProcessMaster(nLen, pLeft, pRight);
+        return nResult;
+    }
+    // Each MIDI channel is rendered to its own audio group then measured and mixed to output
+    int nResult = fluid_synth_process(pSynth, nLen, 4, apFx, METER_CHANNELS * 2, ppChannels);
+    g_meters.Process(nLen, pLeft, pRight);
+    return nResult;
+}
+
+void initAudio(fluid_settings_t* pSettings)
+{
+    int nPeriod = 64;
+    int nPeriods = 16;
+    fluid_settings_getint(pSettings, "audio.period-size", &nPeriod);
+    fluid_settings_getint(pSettings, "audio.periods", &nPeriods);
+    fluid_settings_getnum(pSettings, "synth.sample-rate", &g_dSampleRate);
+    g_meters.Init(nPeriod, g_dSampleRate);
+    g_xruns.SetPeriod(nPeriod, nPeriods, g_dSampleRate);
+}
+
+bool startAudio()
+{
+    if(g_pAudioDriver)
+        return true;
+    initAudio(g_pSettings);
+    g_pAudioDriver = new_fluid_audio_driver2(g_pSettings, onAudio, g_pSynth);
+    g_synthQueue.SetRunning(g_pAudioDriver != NULL);
+    return g_pAudioDriver != NULL;
+}
+
+void stopAudio()
+{
+    if(!g_pAudioDriver)
+        return;
+    delete_fluid_audio_driver(g_pAudioDriver);
+    g_pAudioDriver = NULL;
+    g_synthQueue.SetRunning(false);
+}
+
+void setAudioPeriod(int nPeriodSize, int nPeriods)
+{
+    int nCurrentSize = 0, nCurrentPeriods = 0;
+    fluid_settings_getint(g_pSettings, "audio.period-size", &nCurrentSize);
+    fluid_settings_getint(g_pSettings, "audio.periods", &nCurrentPeriods);
+    if(nPeriodSize == nCurrentSize && nPeriods == nCurrentPeriods)
+        return;
+    bool bRunning = (g_pAudioDriver != NULL);
+    stopAudio();
+    fluid_settings_setint(g_pSettings, "audio.period-size", nPeriodSize);
+    fluid_settings_setint(g_pSettings, "audio.periods", nPeriods);
+    if(bRunning && !startAudio())
+        cerr << "Failed to restart audio driver with period " << nPeriodSize << "x" << nPeriods << endl;
+}
+
+void logXruns()
+{
+    unsigned int nDetected = g_xruns.GetDetected();
+    if(nDetected == g_nXrunsLogged)
+        return;
+    int nPeriodSize = 0, nPeriods = 0;
+    fluid_settings_getint(g_pSettings, "audio.period-size", &nPeriodSize);
+    fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
+    printf("Audio xrun x%u with period %dx%d: %u this session, %llu total\n", nDetected - g_nXrunsLogged, nPeriodSize, nPeriods,
+        g_xruns.GetSession(), (unsigned long long)g_xruns.GetLifetime());
+    g_nXrunsLogged = nDetected;
+    if(!g_calibration.IsActive())
+        return;
+    // Period size under test is too small
+    g_timerCalibrate.Stop();
+    g_calibration.Fail();
+    finishCalibration();
+}
+
+void startCalibration(unsigned int)
+{
+    if(g_calibration.IsActive() || !g_pAudioDriver)
+        return;
+    int nPeriods = 16;
+    fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
+    g_calibration.Start();
+    g_xruns.SetCounting(false); // Xruns are expected whilst calibrating
+    setAudioPeriod(g_calibration.GetSize(), nPeriods);
+    g_nXrunsLogged = g_xruns.GetDetected();
+    g_timerCalibrate.Start(CALIBRATE_STEP_MS);
+    g_nCalibrationShown = 0;
+}
+
+void onCalibrationStep()
+{
+    g_timerCalibrate.Clear();
+    logXruns(); // An xrun may be waiting to be logged
+    if(!g_calibration.IsActive())
+        return;
+    if(g_calibration.Pass())
+    {
+        int nPeriods = 16;
+        fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
+        setAudioPeriod(g_calibration.GetSize(), nPeriods);
+        g_nXrunsLogged = g_xruns.GetDetected();
+        g_timerCalibrate.Start(CALIBRATE_STEP_MS);
+        return;
+    }
+    finishCalibration(); // Reached smallest period size without xruns
+}
+
+void finishCalibration()
+{
+    int nPeriods = 16;
+    fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
+    g_xruns.SetCounting(true);
+    setAudioPeriod(g_calibration.GetResult(), nPeriods);
+    g_nXrunsLogged = g_xruns.GetDetected(); // Ignore any xrun caused by restarting audio
+    map<string, string> mapValues;
+    mapValues["audio_period_size"] = to_string(g_calibration.GetResult());
+    mapValues["audio_periods"] = to_string(nPeriods);
+    if(!updateConfig(mapValues))
+        cerr << "Failed to save audio period size" << endl;
+    printf("Latency calibration chose period %ux%d (%0.1fms)\n", g_calibration.GetResult(), nPeriods, 1000.0 * g_calibration.GetResult() * nPeriods / g_dSampleRate);
+    g_nCalibrationShown = 0; // Show result
+}
+
+void showCalibration()
+{
+    if(g_nCurrentScreen == SCREEN_LOGO)
+        return;
+    unsigned int nSize = g_calibration.IsActive() ? g_calibration.GetSize() : g_calibration.GetResult();
+    if(!nSize || nSize == g_nCalibrationShown)
+        return;
+    g_nCalibrationShown = nSize;
+    char sText[32];
+    snprintf(sText, sizeof(sText), g_calibration.IsActive() ? "Testing %u frames" : "Period %u frames", nSize);
+    g_pScreen->DrawRect(2,100, 157,124, g_colourToastBg, 5, g_colourToastBg, QUADRANT_ALL, 5);
+    g_pScreen->DrawText(sText, 4, 116, WHITE);
+    g_bCalibrationToast = true;
+}
+
+void onSyncSynthState(fluid_synth_t* pSynth, void* pChannel)
+{
+    g_synthState.Sync(pSynth, (intptr_t)pChannel);
+}
+
+void populateDiagnostics()
+{
+    static const char* asTypes[LATENCY_EOL] = {"On  ", "Off ", "CC  ", "Prog", "Bend", "Misc"};
+    ListScreen* pScreen = g_mapScreens[SCREEN_DIAGNOSTICS];
+    int nSelection = pScreen->GetSelection();
+    pScreen->ClearList();
+    char sLine[32];
+    pScreen->Add("MIDI p50/p99/max us", onDiagnostics, 0);
+    for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+    {
+        snprintf(sLine, sizeof(sLine), "%s%5u/%5u/%5u", asTypes[nType], g_latencyHandle[nType].GetPercentile(50), g_latencyHandle[nType].GetPercentile(99), g_latencyHandle[nType].GetMax());
+        pScreen->Add(sLine, onDiagnostics, 0);
+    }
+    pScreen->Add("Audio p50/p99/max ms", onDiagnostics, 0);
+    for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+    {
+        snprintf(sLine, sizeof(sLine), "%s%5.1f/%5.1f/%5.1f", asTypes[nType], g_latencyRender[nType].GetPercentile(50) / 1000.0, g_latencyRender[nType].GetPercentile(99) / 1000.0, g_latencyRender[nType].GetMax() / 1000.0);
+        pScreen->Add(sLine, onDiagnostics, 0);
+    }
+    snprintf(sLine, sizeof(sLine), "Soundfonts %u %uMB", g_sfCache.GetCount(), (unsigned int)(g_sfCache.GetSize() / 1024 / 1024));
+    pScreen->Add(sLine, onDiagnostics, 0);
+    snprintf(sLine, sizeof(sLine), "Prefetch hits %u/%u", g_nPrefetchHits, g_nSoundfontSwitches);
+    pScreen->Add(sLine, onDiagnostics, 0);
+    snprintf(sLine, sizeof(sLine), "Frames %u/%u posts", g_renderQueue.GetFrames(), g_renderQueue.GetPosted());
+    pScreen->Add(sLine, onDiagnostics, 0);
+    snprintf(sLine, sizeof(sLine), "DSP %u%% poly %u/%u", g_governor.GetLoad(), g_governor.GetCap(), g_governor.GetPolyphony());
+    pScreen->Add(sLine, onDiagnostics, 0);
+    snprintf(sLine, sizeof(sLine), "Poly changes %u", g_governor.GetInterventions());
+    pScreen->Add(sLine, onDiagnostics, 0);
+    snprintf(sLine, sizeof(sLine), "Xruns %u/%llu total", g_xruns.GetSession(), (unsigned long long)g_xruns.GetLifetime());
+    pScreen->Add(sLine, onDiagnostics, 0);
+    int nPeriodSize = 0, nPeriods = 0;
+    fluid_settings_getint(g_pSettings, "audio.period-size", &nPeriodSize);
+    fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
+    snprintf(sLine, sizeof(sLine), "Period %dx%d %0.1fms", nPeriodSize, nPeriods, 1000.0 * nPeriodSize * nPeriods / g_dSampleRate);
+    pScreen->Add(sLine, onDiagnostics, 0);
+    pScreen->Add("Reset statistics", onDiagnostics, 1);
+    if(nSelection >= 0)
+        pScreen->SetSelection(nSelection);
+}
+
+void onDiagnostics(int nAction)
+{
+    if(nAction == 1)
+    {
+        for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+        {
+            g_latencyHandle[nType].Reset();
+            g_latencyRender[nType].Reset();
+        }
+        g_nSoundfontSwitches = 0;
+        g_nPrefetchHits = 0;
+        g_renderQueue.ResetStats();
+        g_governor.ResetStats();
+        g_xruns.ResetSession();
+    }
+    showScreen(SCREEN_DIAGNOSTICS);
+}
+
+void dumpDiagnostics()
+{
+    static const char* asTypes[LATENCY_EOL] = {"note on", "note off", "control", "program", "pitchbend", "other"};
+    printf("MIDI latency (us)   handled: count p50 p99 max   rendered: count p50 p99 max\n");
+    for(unsigned int nType = 0; nType < LATENCY_EOL; ++nType)
+        printf("  %-10s %8u %6u %6u %6u   %8u %6u %6u %6u\n", asTypes[nType],
+               g_latencyHandle[nType].GetCount(), g_latencyHandle[nType].GetPercentile(50), g_latencyHandle[nType].GetPercentile(99), g_latencyHandle[nType].GetMax(),
+               g_latencyRender[nType].GetCount(), g_latencyRender[nType].GetPercentile(50), g_latencyRender[nType].GetPercentile(99), g_latencyRender[nType].GetMax());
+    printf("Soundfonts resident: %u (%uMB)  prefetch hits: %u of %u soundfont changes\n", g_sfCache.GetCount(), (unsigned int)(g_sfCache.GetSize() / 1024 / 1024), g_nPrefetchHits, g_nSoundfontSwitches);
+    printf("Display frames: %u for %u draw intents (max %u fps)\n", g_renderQueue.GetFrames(), g_renderQueue.GetPosted(), g_renderQueue.GetRate());
+    fflush(stdout);
 }
 
 void setBacklight(unsigned int nLevel)
@@ -942,8 +1595,67 @@ void setBacklight(unsigned int nLevel)
 	if(nLevel > 100)
 		nLevel = 100;
 	g_nBacklight = nLevel;
-	string sCommand = "gpio pwm " + to_string(DISPLAY_LED) + " " + to_string(g_nBacklight * 10);
-		system(sCommand.c_str());
+	if(g_bHeadless)
+		return;
+	g_backlight.Set(g_nBacklight, BACKLIGHT_ADJUST_MS);
+	wakeBacklight();
+}
+
+void wakeBacklight()
+{
+	if(g_bHeadless)
+		return;
+	if(g_backlight.Get() != g_nBacklight)
+		g_backlight.Set(g_nBacklight, BACKLIGHT_WAKE_MS);
+	if(g_nDimTimeout)
+		g_timerDim.Start(g_nDimTimeout * 1000);
+	else
+		g_timerDim.Stop();
+}
+
+void onDimTimeout()
+{
+	g_timerDim.Clear();
+	if(g_nDimLevel < g_nBacklight)
+		g_backlight.Set(g_nDimLevel, BACKLIGHT_DIM_MS);
+}
+
+void updateUsbEntries()
+{
+    bool bMounted = isUsbMounted();
+    g_mapScreens[SCREEN_CONFIG]->Enable(1, bMounted); // Backup
+    g_mapScreens[SCREEN_CONFIG]->Enable(2, bMounted && access(getUsbPath("fluidbox.config").c_str(), R_OK) == 0); // Restore
+    g_mapScreens[SCREEN_SOUNDFONT]->Enable(0, bMounted); // Copy from USB
+    if(g_nCurrentScreen == SCREEN_SOUNDFONT_LIST && g_nSoundfontAction == SF_ACTION_COPY && !bMounted)
+        showScreen(SCREEN_SOUNDFONT); // Listed files are no longer available
+    else if(g_nCurrentScreen == SCREEN_CONFIG || g_nCurrentScreen == SCREEN_SOUNDFONT)
+        showScreen(g_nCurrentScreen);
+}
+
+void onUevent()
+{
+    unsigned int nChanges = g_hotplug.ProcessUevents();
+    if(nChanges & HOTPLUG_STORAGE)
+        cout << "USB storage attached or removed" << endl; // Mount table change follows when mounted or unmounted
+    if(nChanges & HOTPLUG_SOUND)
+        cout << "Sound device attached or removed" << endl;
+}
+
+void onMountChange()
+{
+    if(!g_hotplug.ProcessMounts())
+        return;
+    if(isUsbMounted())
+        cout << "USB storage mounted at " << g_hotplug.GetUsbMount() << endl;
+    else
+        cout << "USB storage unmounted" << endl;
+    updateUsbEntries();
+}
+
+void onMidiPortChange()
+{
+    if(g_midiPorts.Process())
+        cout << "Connected MIDI input " << g_midiPorts.GetLastConnected() << endl;
 }
 
 bool loadConfig(string sFilename)
@@ -960,6 +1672,9 @@ bool loadConfig(string sFilename)
     g_vPresets.clear();
     Preset* pPreset = NULL;
     string sLine, sGroup;
+    int nPeriodSize = 0, nPeriods = 0;
+    fluid_settings_getint(g_pSettings, "audio.period-size", &nPeriodSize);
+    fluid_settings_getint(g_pSettings, "audio.periods", &nPeriods);
     while(getline(fileConfig, sLine))
     {
         //Skip blank lines
@@ -995,8 +1710,33 @@ bool loadConfig(string sFilename)
         {
             if(sParam == "screen_brightness")
                 setBacklight(validateInt(sValue, 1, 1023));
+            if(sParam == "screen_dim_timeout")
+                g_nDimTimeout = validateInt(sValue, 0, 3600);
+            if(sParam == "screen_dim_brightness")
+                g_nDimLevel = validateInt(sValue, 0, 100);
             if(sParam == "gain")
-                fluid_synth_set_gain(g_pSynth, stof(sValue));
+            {
+                g_synthQueue.Send(SYNTH_GAIN, 0, 0, 0, stof(sValue));
+                g_synthState.SetGain(stof(sValue));
+            }
+            if(sParam == "soundfont_cache_mb")
+                g_sfCache.SetBudget(validateInt(sValue, 0, 4096));
+            if(sParam == "soundfont_mmap")
+                g_sfLoader.SetMmapMode(validateInt(sValue, MMAP_OFF, MMAP_LAZY));
+            if(sParam == "render_fps")
+                g_renderQueue.SetRate(validateInt(sValue, 1, RENDER_MAX_FPS));
+            if(sParam == "polyphony")
+                g_governor.SetPolyphony(validateInt(sValue, GOVERNOR_MIN_POLYPHONY, GOVERNOR_MAX_POLYPHONY));
+            if(sParam == "dsp_load_ceiling")
+                g_governor.SetCeiling(validateInt(sValue, 10, 100));
+            if(sParam == "dsp_load_hysteresis")
+                g_governor.SetHysteresis(validateInt(sValue, 1, 50));
+            if(sParam == "audio_period_size")
+                nPeriodSize = validateInt(sValue, CALIBRATE_MIN_PERIOD, 8192);
+            if(sParam == "audio_periods")
+                nPeriods = validateInt(sValue, 2, 64);
+            if(sParam == "xruns_lifetime")
+                g_xruns.SetLifetime(strtoull(sValue.c_str(), NULL, 10));
             if(sParam == "style_font")
             {
                 g_sFont = sValue;
@@ -1094,6 +1834,7 @@ bool loadConfig(string sFilename)
     }
     fileConfig.close();
     g_bDirty = false;
+    setAudioPeriod(nPeriodSize, nPeriods);
     return true;
 }
 
@@ -1103,25 +1844,38 @@ bool selectPreset(Preset* pPreset)
     if(nPreset == -1)
         return false;
     cout << "Select preset " << nPreset << endl;
-    bool bSoundfontChanged = (g_pCurrentPreset && pPreset->soundfont != g_pCurrentPreset->soundfont);
+    if(g_pCurrentPreset && pPreset->soundfont != g_pCurrentPreset->soundfont)
+    {
+        ++g_nSoundfontSwitches;
+        if(g_sfCache.IsResident(getLoadPath(pPreset->soundfont, pPreset)))
+            ++g_nPrefetchHits;
+    }
     g_pCurrentPreset = pPreset;
+    setPrefetchTarget(nPreset);
     g_mapScreens[SCREEN_PERFORMANCE]->SetSelection(getPresetIndex(g_pCurrentPreset));
-    fluid_synth_set_reverb(g_pSynth, pPreset->reverb.roomsize, pPreset->reverb.damping, pPreset->reverb.width, pPreset->reverb.level);
+    g_synthQueue.Send(SYNTH_REVERB_ROOMSIZE, 0, 0, 0, pPreset->reverb.roomsize);
+    g_synthQueue.Send(SYNTH_REVERB_DAMP, 0, 0, 0, pPreset->reverb.damping);
+    g_synthQueue.Send(SYNTH_REVERB_WIDTH, 0, 0, 0, pPreset->reverb.width);
+    g_synthQueue.Send(SYNTH_REVERB_LEVEL, 0, 0, 0, pPreset->reverb.level);
+    g_synthState.SetParam(REVERB_ROOMSIZE, pPreset->reverb.roomsize);
+    g_synthState.SetParam(REVERB_DAMPING, pPreset->reverb.damping);
+    g_synthState.SetParam(REVERB_WIDTH, pPreset->reverb.width);
+    g_synthState.SetParam(REVERB_LEVEL, pPreset->reverb.level);
     enableEffect(REVERB_ENABLE, g_pCurrentPreset->reverb.enable);
-    fluid_synth_set_chorus(g_pSynth, pPreset->chorus.voicecount,  pPreset->chorus.level,  pPreset->chorus.speed,  pPreset->chorus.depth,  pPreset->chorus.type);
+    g_synthQueue.Send(SYNTH_CHORUS_NR, 0, pPreset->chorus.voicecount);
+    g_synthQueue.Send(SYNTH_CHORUS_LEVEL, 0, 0, 0, pPreset->chorus.level);
+    g_synthQueue.Send(SYNTH_CHORUS_SPEED, 0, 0, 0, pPreset->chorus.speed);
+    g_synthQueue.Send(SYNTH_CHORUS_DEPTH, 0, 0, 0, pPreset->chorus.depth);
+    g_synthQueue.Send(SYNTH_CHORUS_TYPE, 0, pPreset->chorus.type);
+    g_synthState.SetParam(CHORUS_VOICES, pPreset->chorus.voicecount);
+    g_synthState.SetParam(CHORUS_LEVEL, pPreset->chorus.level);
+    g_synthState.SetParam(CHORUS_SPEED, pPreset->chorus.speed);
+    g_synthState.SetParam(CHORUS_DEPTH, pPreset->chorus.depth);
+    g_synthState.SetParam(CHORUS_TYPE, pPreset->chorus.type);
     enableEffect(CHORUS_ENABLE, g_pCurrentPreset->chorus.enable);
     for(unsigned int nParam = REVERB_ENABLE; nParam <= CHORUS_TYPE; ++nParam)
         adjustParam(nParam);
-    if(bSoundfontChanged || g_nCurrentSoundfont < 0)
-        if(!loadSoundfont(pPreset->soundfont))
-            return false;
-    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
-    {
-        fluid_synth_program_select(g_pSynth, nChannel, g_nCurrentSoundfont, pPreset->program[nChannel].bank, pPreset->program[nChannel].program);
-        fluid_synth_cc(g_pSynth, nChannel, 7, pPreset->program[nChannel].level);
-        fluid_synth_cc(g_pSynth, nChannel, 8, pPreset->program[nChannel].balance);
-    }
-    return true;
+    return loadSoundfont(pPreset->soundfont);
 }
 
 Preset* createPreset()
@@ -1211,6 +1965,7 @@ void requestDeletePreset(unsigned int)
 
 void onButton(unsigned int nButton)
 {
+    wakeBacklight();
     switch(g_nCurrentScreen)
     {
     case SCREEN_LOGO:
@@ -1251,18 +2006,21 @@ void onButton(unsigned int nButton)
             {
                 if(g_nCurrentChannel == 16)
                 {
-                    float fGain = fluid_synth_get_gain(g_pSynth);
-                    fluid_synth_set_gain(g_pSynth, fGain + ((fGain > 0.1)?0.01:0.001));
+                    float fGain = g_synthState.GetGain();
+                    fGain += (fGain > 0.1)?0.01:0.001;
+                    g_synthQueue.Send(SYNTH_GAIN, 0, 0, 0, fGain);
+                    g_synthState.SetGain(fGain);
                     g_bDirty = true;
                 }
                 else
                 {
-                    int nLevel;
-                    if(FLUID_FAILED == fluid_synth_get_cc(g_pSynth, g_nCurrentChannel, 7, &nLevel))
+                    int nLevel = g_synthState.GetCC(g_nCurrentChannel, 7);
+                    if(nLevel < 0)
                         return;
                     if(nLevel >= 127)
                         return;
-                    fluid_synth_cc(g_pSynth, g_nCurrentChannel, 7, ++nLevel);
+                    g_synthQueue.Send(SYNTH_CC, g_nCurrentChannel, 7, ++nLevel);
+                    g_synthState.SetCC(g_nCurrentChannel, 7, nLevel);
                     g_pCurrentPreset->program[g_nCurrentChannel].level = nLevel;
                     setDirty();
                 }
@@ -1273,18 +2031,21 @@ void onButton(unsigned int nButton)
             {
                 if(g_nCurrentChannel == 16)
                 {
-                    float fGain = fluid_synth_get_gain(g_pSynth);
-                    fluid_synth_set_gain(g_pSynth, fGain - ((fGain > 0.1)?0.01:0.001));
+                    float fGain = g_synthState.GetGain();
+                    fGain -= (fGain > 0.1)?0.01:0.001;
+                    g_synthQueue.Send(SYNTH_GAIN, 0, 0, 0, fGain);
+                    g_synthState.SetGain(fGain);
                     g_bDirty = true;
                 }
                 else
                 {
-                    int nLevel;
-                    if(FLUID_FAILED == fluid_synth_get_cc(g_pSynth, g_nCurrentChannel, 7, &nLevel))
+                    int nLevel = g_synthState.GetCC(g_nCurrentChannel, 7);
+                    if(nLevel < 0)
                         return;
                     if(nLevel < 1)
                         return;
-                    fluid_synth_cc(g_pSynth, g_nCurrentChannel, 7, --nLevel);
+                    g_synthQueue.Send(SYNTH_CC, g_nCurrentChannel, 7, --nLevel);
+                    g_synthState.SetCC(g_nCurrentChannel, 7, nLevel);
                     g_pCurrentPreset->program[g_nCurrentChannel].level = nLevel;
                     setDirty();
                 }
@@ -1390,6 +2151,7 @@ void onButton(unsigned int nButton)
 
 void onLeftHold(unsigned int nGpio)
 {
+    wakeBacklight();
     switch(g_nCurrentScreen)
     {
     case SCREEN_PERFORMANCE:
@@ -1404,6 +2166,7 @@ void onLeftHold(unsigned int nGpio)
 
 void onRightHold(unsigned int nGpio)
 {
+    wakeBacklight();
     switch(g_nCurrentScreen)
     {
     case SCREEN_PRESET_NAME:
@@ -1418,16 +2181,6 @@ void onSignal(int nSignal)
 {
     switch(nSignal)
     {
-    case SIGALRM:
-        // We use alarm to drop back to performance screen after idle delay
-        if(g_nCurrentScreen == SCREEN_LOGO)
-            showScreen(SCREEN_PERFORMANCE);
-        else if(g_nCurrentScreen == SCREEN_ALERT)
-        {
-            g_pAlertCallback = NULL;
-            showScreen(g_mapScreens[SCREEN_ALERT]->GetParent());
-        }
-        break;
     case SIGINT:
     case SIGTERM:
         printf("\nReceived signal to quit...\n");
@@ -1435,34 +2188,310 @@ void onSignal(int nSignal)
         break;
     case SIGHUP:
         loadConfig();
+        if(g_mapScreens.count(g_nCurrentScreen))
+            g_mapScreens[g_nCurrentScreen]->Invalidate(); // Font may have changed
         showScreen(g_nCurrentScreen);
         break;
+    case SIGUSR1:
+        dumpDiagnostics();
+        break;
+    }
+}
+
+void onIdleTimeout()
+{
+    g_timerIdle.Clear();
+    // Drop back to performance screen after idle delay
+    if(g_nCurrentScreen == SCREEN_LOGO)
+        showScreen(SCREEN_PERFORMANCE);
+    else if(g_nCurrentScreen == SCREEN_ALERT)
+    {
+        g_pAlertCallback = NULL;
+        showScreen(g_mapScreens[SCREEN_ALERT]->GetParent());
+    }
+}
+
+
+fluid_settings_t* createSettings()
+{
+    fluid_settings_t* pSettings = new_fluid_settings();
+    fluid_settings_setint(pSettings, "midi.autoconnect", 1);
+    fluid_settings_setint(pSettings, "synth.cpu-cores", 3);
+    fluid_settings_setint(pSettings, "synth.threadsafe-api", 0); // Synth is only accessed by audio thread via g_synthQueue
+    fluid_settings_setint(pSettings, "synth.chorus.active", 0);
+    fluid_settings_setint(pSettings, "synth.reverb.active", 0);
+    fluid_settings_setint(pSettings, "synth.audio-channels", METER_CHANNELS); // Render each MIDI channel to its own buffers for metering
+    fluid_settings_setint(pSettings, "synth.audio-groups", METER_CHANNELS);
+    fluid_settings_setint(pSettings, "synth.polyphony", GOVERNOR_MAX_POLYPHONY); // Allocate all voices at start - polyphony is capped below this by config and governor
+    fluid_settings_setstr(pSettings, "audio.driver", "alsa");
+    fluid_settings_setstr(pSettings, "midi.driver", "alsa_seq");
+    fluid_settings_setstr(pSettings, "midi.alsa_seq.id", MIDI_CLIENT_ID);
+    return pSettings;
+}
+
+/** MIDI event in a benchmark workload */
+struct BenchEvent
+{
+    unsigned int frame; // Frame offset from start of workload
+    unsigned char type; // MIDI status (upper nibble)
+    unsigned char channel;
+    int value1;
+    int value2;
+};
+
+int runBenchmark(int nPreset, unsigned int nSeconds)
+{
+    g_bHeadless = true;
+    fluid_settings_t* pSettings = createSettings();
+    g_pSettings = pSettings;
+    g_pSynth = new_fluid_synth(pSettings);
+    if(!g_pSynth)
+    {
+        cerr << "Failed to create synth engine" << endl;
+        return 1;
+    }
+    g_synthQueue.SetSynth(g_pSynth);
+    if(!loadConfig())
+        return 1;
+    g_synthQueue.Poll(); // Apply settings queued by config, e.g. gain
+    if(nPreset >= 0 && nPreset < g_vPresets.size())
+        g_pCurrentPreset = g_vPresets[nPreset];
+    if(!g_pCurrentPreset)
+    {
+        cerr << "No preset to benchmark" << endl;
+        return 1;
+    }
+    Preset* pPreset = g_pCurrentPreset;
+
+    // Configure synth as selectPreset would, without touching screens
+    uint64_t nStart = getMicros();
+    int nSoundfont = fluid_synth_sfload(g_pSynth, getLoadPath(pPreset->soundfont, pPreset).c_str(), 1);
+    if(nSoundfont < 0)
+    {
+        cerr << "Failed to load soundfont " << pPreset->soundfont << endl;
+        return 1;
+    }
+    unsigned int nLoadTime = getMicros() - nStart;
+    fluid_synth_set_reverb(g_pSynth, pPreset->reverb.roomsize, pPreset->reverb.damping, pPreset->reverb.width, pPreset->reverb.level);
+    fluid_synth_set_reverb_on(g_pSynth, pPreset->reverb.enable);
+    fluid_synth_set_chorus(g_pSynth, pPreset->chorus.voicecount, pPreset->chorus.level, pPreset->chorus.speed, pPreset->chorus.depth, pPreset->chorus.type);
+    fluid_synth_set_chorus_on(g_pSynth, pPreset->chorus.enable);
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+    {
+        fluid_synth_program_select(g_pSynth, nChannel, nSoundfont, pPreset->program[nChannel].bank, pPreset->program[nChannel].program);
+        fluid_synth_cc(g_pSynth, nChannel, 7, pPreset->program[nChannel].level);
+        fluid_synth_cc(g_pSynth, nChannel, 8, pPreset->program[nChannel].balance);
     }
+
+    int nBlockSize = 64;
+    double dSampleRate = 44100.0;
+    fluid_settings_getint(pSettings, "audio.period-size", &nBlockSize);
+    fluid_settings_getnum(pSettings, "synth.sample-rate", &dSampleRate);
+    initAudio(pSettings);
+    unsigned int nPhaseFrames = nSeconds * dSampleRate;
+
+    // Build scripted workload: chord stacks, polyphony ramp then controller sweeps
+    vector<BenchEvent> vEvents;
+    unsigned int nFrame = 0;
+    static const int anChord[] = {0, 4, 7, 11, 14};
+    for(unsigned int nChord = 0; nFrame < nPhaseFrames; ++nChord, nFrame += dSampleRate / 2)
+    {
+        int nRoot = 36 + (nChord * 5) % 36;
+        for(unsigned int nChannel = 0; nChannel < 4; ++nChannel)
+            for(unsigned int nNote = 0; nNote < 5; ++nNote)
+            {
+                vEvents.push_back({nFrame, 0x90, (unsigned char)nChannel, nRoot + 12 * (int)nChannel / 2 + anChord[nNote], 100});
+                vEvents.push_back({nFrame + (unsigned int)(dSampleRate * 0.4), 0x80, (unsigned char)nChannel, nRoot + 12 * (int)nChannel / 2 + anChord[nNote], 0});
+            }
+    }
+    nFrame = nPhaseFrames;
+    for(unsigned int nNote = 0; nFrame < 2 * nPhaseFrames; ++nNote, nFrame += nPhaseFrames / 300)
+        vEvents.push_back({nFrame, 0x90, (unsigned char)(nNote % 16), 24 + (int)(nNote * 7) % 84, 64 + (int)nNote % 63});
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        vEvents.push_back({2 * nPhaseFrames, 0xB0, (unsigned char)nChannel, 123, 0});
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        for(unsigned int nNote = 0; nNote < 3; ++nNote)
+            vEvents.push_back({2 * nPhaseFrames, 0x90, (unsigned char)nChannel, 48 + (int)nChannel + anChord[nNote], 90});
+    for(nFrame = 2 * nPhaseFrames; nFrame < 3 * nPhaseFrames; nFrame += nBlockSize)
+    {
+        int nSweep = (nFrame / nBlockSize) % 254;
+        int nValue = (nSweep < 127) ? nSweep : 253 - nSweep;
+        unsigned char nChannel = (nFrame / nBlockSize) % 16;
+        vEvents.push_back({nFrame, 0xB0, nChannel, 1, nValue});
+        vEvents.push_back({nFrame, 0xB0, nChannel, 74, nValue});
+        vEvents.push_back({nFrame, 0xB0, nChannel, 10, 127 - nValue});
+        vEvents.push_back({nFrame, 0xE0, nChannel, nValue * 128, 0});
+    }
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        vEvents.push_back({3 * nPhaseFrames, 0xB0, (unsigned char)nChannel, 123, 0});
+    stable_sort(vEvents.begin(), vEvents.end(), [](const BenchEvent& a, const BenchEvent& b) {return a.frame < b.frame;});
+
+    // Render workload
+    cout << "Benchmarking preset '" << pPreset->name << "' soundfont '" << pPreset->soundfont << "' (loaded in " << nLoadTime / 1000 << "ms)" << endl;
+    vector<float> vLeft(nBlockSize), vRight(nBlockSize);
+    LatencyHistogram blockTime;
+    int nPeakVoices = 0;
+    unsigned int nOverruns = 0;
+    unsigned int nDeadline = 1000000.0 * nBlockSize / dSampleRate;
+    auto itEvent = vEvents.begin();
+    nStart = getMicros();
+    for(nFrame = 0; nFrame < 3 * nPhaseFrames + dSampleRate; nFrame += nBlockSize)
+    {
+        for(; itEvent != vEvents.end() && itEvent->frame < nFrame + nBlockSize; ++itEvent)
+        {
+            switch(itEvent->type)
+            {
+            case 0x80:
+                fluid_synth_noteoff(g_pSynth, itEvent->channel, itEvent->value1);
+                break;
+            case 0x90:
+                fluid_synth_noteon(g_pSynth, itEvent->channel, itEvent->value1, itEvent->value2);
+                break;
+            case 0xB0:
+                fluid_synth_cc(g_pSynth, itEvent->channel, itEvent->value1, itEvent->value2);
+                break;
+            case 0xE0:
+                fluid_synth_pitch_bend(g_pSynth, itEvent->channel, itEvent->value1);
+                break;
+            }
+        }
+        uint64_t nBlockStart = getMicros();
+        memset(vLeft.data(), 0, nBlockSize * sizeof(float));
+        memset(vRight.data(), 0, nBlockSize * sizeof(float));
+        renderAudio(g_pSynth, nBlockSize, vLeft.data(), vRight.data());
+        unsigned int nTime = getMicros() - nBlockStart;
+        blockTime.Add(nTime);
+        if(nTime > nDeadline)
+            ++nOverruns;
+        int nVoices = fluid_synth_get_active_voice_count(g_pSynth);
+        if(nVoices > nPeakVoices)
+            nPeakVoices = nVoices;
+    }
+    double dElapsed = (getMicros() - nStart) / 1000000.0;
+    double dRendered = nFrame / dSampleRate;
+
+    printf("Rendered %0.1fs of audio in %0.2fs: real-time factor %0.1fx\n", dRendered, dElapsed, dRendered / dElapsed);
+    printf("Block size %d frames, deadline %uus\n", nBlockSize, nDeadline);
+    printf("Block render time (us): p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n", blockTime.GetPercentile(50), blockTime.GetPercentile(90), blockTime.GetPercentile(99), blockTime.GetPercentile(99.9), blockTime.GetMax());
+    printf("Blocks over deadline: %u of %u\n", nOverruns, blockTime.GetCount());
+    printf("Peak voice count: %d\n", nPeakVoices);
+
+    delete_fluid_synth(g_pSynth);
+    delete_fluid_settings(pSettings);
+    for(auto it = g_vPresets.begin(); it!= g_vPresets.end(); ++it)
+        delete *it;
+    g_vPresets.clear();
+    return 0;
 }
 
+int runDisplayBenchmark(unsigned int nRepeats)
+{
+    g_bHeadless = true;
+    FbScreen* pScreen = new FbScreen("/dev/fb1");
+    g_pScreen = pScreen;
+    loadConfig();
+    pScreen->SetFont(DEFAULT_FONT_SIZE, "/usr/share/fonts/truetype/" + g_sFont);
+
+    // Populate program list and mixer labels as SCREEN_PROGRAM and SCREEN_MIXER would
+    ListScreen programList(pScreen, "Program", SCREEN_NONE, &g_style);
+    if(g_pCurrentPreset && g_presetIndex.Load(getSoundfontPath(g_pCurrentPreset->soundfont)))
+    {
+        const std::vector<PresetInfo>& vPrograms = g_presetIndex.GetPresets();
+        for(auto it = vPrograms.begin(); it != vPrograms.end(); ++it)
+            programList.Add(it->name);
+    }
+    for(unsigned int nProgram = 0; programList.GetEntryText(0).empty() && nProgram < 128; ++nProgram)
+        programList.Add("Program " + to_string(nProgram));
+    vector<string> vLabels;
+    for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+        vLabels.push_back(to_string(nChannel + 1) + ":" + programList.GetEntryText(nChannel).substr(0, 17));
+
+    cout << "Benchmarking text drawing, " << nRepeats << " frames per test" << endl;
+    for(unsigned int nPass = 0; nPass < 2; ++nPass)
+    {
+        pScreen->EnableCache(nPass == 1);
+        uint64_t nStart = getMicros();
+        programList.Draw(); // First frame rasterizes glyphs when cache is enabled
+        unsigned int nFirstFrame = getMicros() - nStart;
+        nStart = getMicros();
+        for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+            programList.Draw();
+        unsigned int nListTime = (getMicros() - nStart) / nRepeats;
+        nStart = getMicros();
+        for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+        {
+            for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+            {
+                pScreen->SetFont(9);
+                pScreen->DrawText(vLabels[nChannel], 16 + nChannel * 9 + 8, 120, g_colourMixerFaderFg, 90);
+                pScreen->SetFont(DEFAULT_FONT_SIZE);
+            }
+        }
+        unsigned int nMixerTime = (getMicros() - nStart) / nRepeats;
+        printf("%s: program list first frame %uus, per frame %uus; mixer labels per frame %uus\n", nPass ? "Glyph cache" : "FreeType   ", nFirstFrame, nListTime, nMixerTime);
+    }
+    printf("Glyph cache: %u glyphs, %u bytes\n", (unsigned int)pScreen->GetGlyphCache().GetCount(), (unsigned int)pScreen->GetGlyphCache().GetBytes());
+
+    cout << "Benchmarking fills and bitmaps" << endl;
+    pScreen->LoadBitmap("logo.bmp", "logo");
+    for(unsigned int nPass = 0; nPass < 2; ++nPass)
+    {
+        pScreen->EnableKernels(nPass == 1);
+        uint64_t nStart = getMicros();
+        for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+            pScreen->Clear(nRepeat & 1 ? DARK_RED : BLACK);
+        unsigned int nClearTime = (getMicros() - nStart) / nRepeats;
+        nStart = getMicros();
+        for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+            for(unsigned int nRow = 0; nRow < LIST_ROWS; ++nRow)
+                pScreen->DrawRect(2, 16 + nRow * 16, 160, 31 + nRow * 16, g_style.select_background, 0, nRepeat & 1 ? g_style.select_background : g_style.canvas);
+        unsigned int nRowTime = (getMicros() - nStart) / nRepeats;
+        nStart = getMicros();
+        for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+            pScreen->DrawBitmap("logo", 0, 0);
+        unsigned int nBitmapTime = (getMicros() - nStart) / nRepeats;
+        printf("%s: clear %uus; list rows per frame %uus; logo %uus\n", nPass ? fbKernelName() : "ribanfblib", nClearTime, nRowTime, nBitmapTime);
+    }
+
+    g_pScreen = NULL;
+    delete pScreen;
+    for(auto it = g_vPresets.begin(); it!= g_vPresets.end(); ++it)
+        delete *it;
+    g_vPresets.clear();
+    return 0;
+}
 
 /** Main application */
 int main(int argc, char** argv)
 {
     printf("riban fluidbox\n");
-    g_pScreen = new ribanfblib("/dev/fb1");
+    if(argc > 1 && string(argv[1]) == "--bench")
+        return runBenchmark(argc > 2 ? validateInt(argv[2], 0, MAX_PRESETS) - 1 : -1, argc > 3 ? validateInt(argv[3], 1, 3600) : BENCH_PHASE_SECONDS);
+    if(argc > 1 && string(argv[1]) == "--bench-display")
+        return runDisplayBenchmark(argc > 2 ? validateInt(argv[2], 1, 100000) : BENCH_DISPLAY_FRAMES);
+
+    // Configure signal handlers - before any thread is created so that all threads block these signals
+    EventLoop eventLoop;
+    if(eventLoop.AddSignals({SIGINT, SIGTERM, SIGHUP, SIGUSR1}, onSignal))
+        cout << "Configured signal handler" << endl;
+    else
+        cerr << "Failed to configure signal handler" << endl;
+
+    g_pScreen = new FbScreen("/dev/fb1");
     g_pScreen->LoadBitmap("logo.bmp", "logo");
     showScreen(SCREEN_LOGO);
     //g_pScreen->SetFont(DEFAULT_FONT_SIZE, "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf");
     configParams();
 
-	string sCommand = "gpio mode " + to_string(DISPLAY_LED) + " pwm";
-    system(sCommand.c_str());
-	setBacklight(900);
+    wiringPiSetupGpio();
+    if(g_backlight.Open(DISPLAY_PWM, DISPLAY_LED))
+        cout << "Configured backlight using " << g_backlight.GetBackend() << endl;
+    else
+        cerr << "Failed to configure backlight" << endl;
+    setBacklight(100);
 
-    // Create and populate fluidsynth settings
-    fluid_settings_t* pSettings = new_fluid_settings();
-    fluid_settings_setint(pSettings, "midi.autoconnect", 1);
-    fluid_settings_setint(pSettings, "synth.cpu-cores", 3);
-    fluid_settings_setint(pSettings, "synth.chorus.active", 0);
-    fluid_settings_setint(pSettings, "synth.reverb.active", 0);
-    fluid_settings_setstr(pSettings, "audio.driver", "alsa");
-    fluid_settings_setstr(pSettings, "midi.driver", "alsa_seq");
+    fluid_settings_t* pSettings = createSettings();
+    g_pSettings = pSettings;
 
     // Create synth
     g_pSynth = new_fluid_synth(pSettings);
@@ -1471,6 +2500,17 @@ int main(int argc, char** argv)
     else
         cerr << "Failed to create synth engine" << endl;
 
+    g_synthState.Sync(g_pSynth);
+    g_synthQueue.SetSynth(g_pSynth);
+    g_sfCache.SetQueue(&g_synthQueue);
+    g_sfCache.SetLoader(&g_sfLoader);
+    g_sfLoader.SetNotify([]() {g_notifier.Notify();});
+    if(!g_sfLoader.Start())
+        cerr << "Failed to start soundfont loader" << endl;
+    g_importer.SetNotify([]() {g_notifier.Notify();});
+    if(!g_importer.Start())
+        cerr << "Failed to start soundfont importer" << endl;
+
     // Create MIDI router
     fluid_midi_router_t* pRouter = new_fluid_midi_router(pSettings, onMidiEvent, g_pSynth);
     if(pRouter)
@@ -1479,24 +2519,32 @@ int main(int argc, char** argv)
         cerr << "Failed to create MIDI router" << endl;
 
     // Create MIDI driver
-    fluid_midi_driver_t* pMidiDriver = new_fluid_midi_driver(pSettings, fluid_midi_router_handle_midi_event, pRouter);
+    fluid_midi_driver_t* pMidiDriver = new_fluid_midi_driver(pSettings, onMidiInput, pRouter);
     if(g_pSynth)
         cout << "Created MIDI driver" << endl;
     else
         cerr << "Failed to create MIDI driver" << endl;
 
-    // Create audio driver
-    fluid_audio_driver_t* pAudioDriver = new_fluid_audio_driver(pSettings, g_pSynth);
-    if(g_pSynth)
-        cout << "Created audio driver" << endl;
+    // Connect MIDI inputs now and as they are attached
+    if(g_midiPorts.Open(MIDI_CLIENT_NAME))
+        cout << "Connected " << g_midiPorts.ConnectAll() << " MIDI inputs" << endl;
     else
-        cerr << "Failed to create audio driver" << endl;
+        cerr << "Failed to open MIDI port monitor" << endl;
 
     loadConfig();
-    g_pScreen->SetFont(DEFAULT_FONT_SIZE, "/usr/share/fonts/truetype/" + g_sFont);
+
+    // Create audio driver - after loading configuration which sets period size
+    if(startAudio())
+        cout << "Created audio driver" << endl;
+    else
+        cerr << "Failed to create audio driver" << endl;
+    // Rasterize glyphs for list and mixer text in advance
+    g_pScreen->SetFont(9, "/usr/share/fonts/truetype/" + g_sFont);
+    g_pScreen->PreloadFont(90);
+    g_pScreen->SetFont(DEFAULT_FONT_SIZE);
+    g_pScreen->PreloadFont();
 
     // Configure buttons
-    wiringPiSetupGpio();
     ButtonHandler buttonHandler;
     buttonHandler.AddButton(BUTTON_UP, onButton);
     buttonHandler.AddButton(BUTTON_DOWN, onButton);
@@ -1504,13 +2552,55 @@ int main(int argc, char** argv)
     buttonHandler.AddButton(BUTTON_RIGHT, NULL, onButton, onRightHold);
     buttonHandler.SetRepeatPeriod(BUTTON_UP, 100);
     buttonHandler.SetRepeatPeriod(BUTTON_DOWN, 100);
-    cout << "Configured buttons" << endl;
-
-    // Configure signal handlers
-    signal(SIGALRM, onSignal);
-    signal(SIGINT, onSignal);
-    signal(SIGTERM, onSignal);
-    cout << "Configured signal handler" << endl;
+    // Buttons are processed on GPIO edges and by timer only whilst a debounce, hold or repeat deadline is pending
+    Timer timerButtons;
+    auto processButtons = [&]() {
+        buttonHandler.Process();
+        int nTimeout = buttonHandler.GetTimeout();
+        if(nTimeout < 0)
+            timerButtons.Stop();
+        else
+            timerButtons.Start(nTimeout);
+    };
+    eventLoop.Add(timerButtons.GetFd(), [&]() {
+        timerButtons.Clear();
+        processButtons();
+    });
+    if(eventLoop.Add(buttonHandler.GetFd(), processButtons))
+        cout << "Configured buttons" << endl;
+    else
+        cerr << "GPIO edge events unavailable - polling buttons" << endl; // e.g. old kernel
+    processButtons();
+    eventLoop.Add(g_timerIdle.GetFd(), onIdleTimeout);
+    eventLoop.Add(g_timerDim.GetFd(), onDimTimeout);
+    eventLoop.Add(g_backlight.GetFd(), []() {g_backlight.Process();});
+    wakeBacklight(); // Start idle dimming delay
+    eventLoop.Add(g_timerCalibrate.GetFd(), onCalibrationStep);
+    eventLoop.Add(g_notifier.GetFd(), []() {g_notifier.Clear();}); // Work is done after each wake
+    if(g_hotplug.Open())
+        cout << "Configured hotplug monitor" << (isUsbMounted() ? " - USB storage mounted at " + g_hotplug.GetUsbMount() : "") << endl;
+    else
+        cerr << "Failed to configure hotplug monitor" << endl;
+    if(g_hotplug.GetUeventFd() >= 0)
+        eventLoop.Add(g_hotplug.GetUeventFd(), onUevent);
+    if(g_hotplug.GetMountFd() >= 0)
+        eventLoop.Add(g_hotplug.GetMountFd(), onMountChange, EPOLLPRI);
+    if(g_midiPorts.GetFd() >= 0)
+        eventLoop.Add(g_midiPorts.GetFd(), onMidiPortChange);
+    g_renderQueue.SetHandler(RENDER_MIDI, [](uint32_t) {processMidiQueue();});
+    g_renderQueue.SetHandler(RENDER_MIXER, [](uint32_t nMask) {
+        for(unsigned int nChannel = 0; nChannel < 17; ++nChannel)
+            if(nMask & (1 << nChannel))
+                drawMixerChannel(nChannel);
+    });
+    g_renderQueue.SetHandler(RENDER_METERS, [](uint32_t) {
+        if(g_nCurrentScreen != SCREEN_MIXER && g_nCurrentScreen != SCREEN_PRESET_PROGRAM)
+            return; // Stop refreshing meters when they are not shown
+        for(unsigned int nChannel = 0; nChannel <= METER_MASTER; ++nChannel)
+            drawMeter(nChannel);
+        g_renderQueue.Post(RENDER_METERS);
+    });
+    eventLoop.Add(g_renderQueue.GetFd(), []() {g_renderQueue.Render();});
 
     g_mapScreens[SCREEN_PERFORMANCE] = new ListScreen(g_pScreen, "   riban Fluidbox", SCREEN_NONE, &g_style);
     g_mapScreens[SCREEN_EDIT_PRESET] = new ListScreen(g_pScreen, "Edit Preset", SCREEN_EDIT, &g_style);
@@ -1527,6 +2617,24 @@ int main(int argc, char** argv)
     g_mapScreens[SCREEN_EDIT_VALUE] = new ListScreen(g_pScreen, "Effect parameter", SCREEN_EFFECTS, &g_style);
     g_mapScreens[SCREEN_ALERT] = new ListScreen(g_pScreen, "     ALERT", SCREEN_PERFORMANCE, &g_style);
     g_mapScreens[SCREEN_CONFIG] = new ListScreen(g_pScreen, "Configuration", SCREEN_EDIT, &g_style);
+    g_mapScreens[SCREEN_DIAGNOSTICS] = new ListScreen(g_pScreen, "Diagnostics", SCREEN_CONFIG, &g_style);
+
+    // Long lists request displayed entries from their data instead of holding a copy of every entry
+    ListSource presetSource;
+    presetSource.count = []() {return (unsigned int)g_vPresets.size();};
+    presetSource.text = [](unsigned int nPreset) {return (g_vPresets[nPreset]->dirty ? "*" : "") + g_vPresets[nPreset]->name;};
+    presetSource.select = [](unsigned int) {showScreen(SCREEN_EDIT);};
+    g_mapScreens[SCREEN_PERFORMANCE]->SetSource(presetSource);
+    ListSource programSource;
+    programSource.count = []() {return (unsigned int)g_presetIndex.GetPresets().size();};
+    programSource.text = [](unsigned int nProgram) {return string(g_presetIndex.GetPresets()[nProgram].name);};
+    programSource.select = [](unsigned int nProgram) {setPresetProgram((g_presetIndex.GetPresets()[nProgram].bank << 8) + g_presetIndex.GetPresets()[nProgram].program);};
+    g_mapScreens[SCREEN_PROGRAM]->SetSource(programSource);
+    ListSource soundfontSource;
+    soundfontSource.count = []() {return (unsigned int)g_vSoundfontFiles.size();};
+    soundfontSource.text = [](unsigned int nFile) {return g_vSoundfontFiles[nFile];};
+    soundfontSource.select = [](unsigned int) {onSelectSoundfont(g_nSoundfontAction);};
+    g_mapScreens[SCREEN_SOUNDFONT_LIST]->SetSource(soundfontSource);
 
     g_mapScreens[SCREEN_EDIT]->Add("Mixer", showScreen, SCREEN_MIXER);
     g_mapScreens[SCREEN_EDIT]->Add("Effects", showScreen, SCREEN_EFFECTS);
@@ -1542,6 +2650,8 @@ int main(int argc, char** argv)
     g_mapScreens[SCREEN_CONFIG]->Add("Reload config", admin, LOAD_CONFIG);
     g_mapScreens[SCREEN_CONFIG]->Add("Power", showScreen, SCREEN_POWER);
     g_mapScreens[SCREEN_CONFIG]->Add("Screen brightness", editParam, BACKLIGHT_BRIGHTNESS);
+    g_mapScreens[SCREEN_CONFIG]->Add("Calibrate latency", startCalibration);
+    g_mapScreens[SCREEN_CONFIG]->Add("Diagnostics", showScreen, SCREEN_DIAGNOSTICS);
 
     g_mapScreens[SCREEN_EDIT_PRESET]->Add("Name", showScreen, SCREEN_PRESET_NAME);
     g_mapScreens[SCREEN_EDIT_PRESET]->Add("Soundfont", listSoundfont, SF_ACTION_SELECT);
@@ -1568,6 +2678,9 @@ int main(int argc, char** argv)
 
     g_mapScreens[SCREEN_SOUNDFONT]->Add("Copy from USB", listSoundfont, SF_ACTION_COPY);
     g_mapScreens[SCREEN_SOUNDFONT]->Add("Delete", listSoundfont, SF_ACTION_DELETE);
+    g_mapScreens[SCREEN_SOUNDFONT]->Add("Cancel import", cancelImport);
+    g_mapScreens[SCREEN_SOUNDFONT]->Enable(2, false);
+    updateUsbEntries();
     cout << "Configured screens" << endl;
 
     // Select preset
@@ -1576,21 +2689,36 @@ int main(int argc, char** argv)
     selectPreset(g_pCurrentPreset);
 
     // Show splash screen for a while (idle delay)
-    alarm(2);
+    g_timerIdle.Start(2000);
 
     while(g_nRunState)
     {
-        buttonHandler.Process();
-        delay(5);
+        // Sleep until an event or, whilst background work is in progress, a short timeout
+        bool bBusy = !g_sLoadingSoundfont.empty() || g_bEvictPending || g_importer.IsBusy();
+        eventLoop.Wait(bBusy ? LOOP_BUSY_MS : -1);
+        g_synthQueue.Poll();
+        processSoundfontLoads();
+        showLoadProgress();
+        processImports();
+        showImportProgress();
+        logGovernor();
+        logDroppedCommands();
+        logXruns();
+        showCalibration();
     }
 
     // If we are here then it is all over so let's tidy up...
 
     // Clean up
     delete_fluid_midi_router(pRouter);
-    delete_fluid_audio_driver(pAudioDriver);
+    stopAudio();
+    map<string, string> mapStats;
+    mapStats["xruns_lifetime"] = to_string(g_xruns.GetLifetime());
+    updateConfig(mapStats);
     delete_fluid_midi_driver(pMidiDriver);
     delete_fluid_synth(g_pSynth);
+    g_sfLoader.Stop(); // After synth as soundfonts depend on loader
+    g_importer.Stop(); // Abandons any import in progress
     delete_fluid_settings(pSettings);
 //    g_pScreen->Clear();
     for(auto it = g_mapScreens.begin(); it!= g_mapScreens.end(); ++it)
@@ -1,10 +1,31 @@
 #include "fluidsynth.h"
 #include "buttonhandler.hpp"
 #include "ribanfblib/ribanfblib.h"
+#include "fbscreen.hpp"
 #include "screen.hpp"
+#include "ringbuffer.hpp"
+#include "latency.hpp"
+#include "sfcache.hpp"
+#include "sfloader.hpp"
+#include "sfindex.hpp"
+#include "sfslim.hpp"
+#include "synthstate.hpp"
+#include "synthqueue.hpp"
+#include "eventloop.hpp"
+#include "renderqueue.hpp"
+#include "meters.hpp"
+#include "governor.hpp"
+#include "xrun.hpp"
+#include "backlight.hpp"
+#include "hotplug.hpp"
+#include "midiports.hpp"
+#include "importer.hpp"
 
 #include <vector>
 #include <map>
+#include <csignal>
+#include <mutex>
+#include <set>
 
 #define DEFAULT_SOUNDFONT "default/TimGM6mb.sf2"
 #define SF_ROOT "sf2/"
@@ -13,6 +34,20 @@
 #define PI 3.14159265359
 #define MAX_NAME_LEN 20
 #define DEFAULT_FONT_SIZE 16, 12
+#define MIDI_QUEUE_SIZE 1024
+#define MIDI_CLIENT_ID "fluidbox" // Identifies synth sequencer client
+#define MIDI_CLIENT_NAME "FLUID Synth (" MIDI_CLIENT_ID ")" // Name of synth sequencer client that MIDI inputs are connected to
+#define PREFETCH_DISTANCE 1 // Quantity of presets either side of current preset to prefetch soundfonts for
+#define BENCH_PHASE_SECONDS 10 // Default duration of each benchmark workload phase
+#define BENCH_DISPLAY_FRAMES 100 // Default quantity of frames drawn by each display benchmark test
+#define LOOP_BUSY_MS 20 // Maximum time main loop sleeps whilst background work (loading, eviction) is in progress
+#define DEFAULT_RENDER_FPS 25 // Default maximum display frames per second for MIDI driven updates
+#define METER_FLOOR_DB -48 // Lowest level shown on audio level meters
+#define BACKLIGHT_ADJUST_MS 100 // Duration of fade when brightness is adjusted
+#define BACKLIGHT_WAKE_MS 150 // Duration of fade to full brightness when a button is pressed
+#define BACKLIGHT_DIM_MS 1500 // Duration of fade to dimmed brightness when idle
+#define DEFAULT_DIM_TIMEOUT 60 // Default time in seconds without button presses before backlight dims (0 to disable)
+#define DEFAULT_DIM_LEVEL 10 // Default brightness in percent when dimmed
 
 // Define GPIO pin usage (note some are not used by code but useful for planning
 #define BUTTON_UP      4
@@ -28,7 +63,8 @@
 #define SPI_SCLK      11
 #define DISPLAY_DC    24
 #define DISPLAY_RESET 25
-#define DISPLAY_LED   26
+#define DISPLAY_LED   12 // PWM0 (wiringPi pin 26)
+#define DISPLAY_PWM    0 // Kernel PWM channel driving DISPLAY_LED
 
 using namespace std;
 
@@ -53,6 +89,7 @@ enum SCREEN_ID
     SCREEN_SOUNDFONT_LIST,
     SCREEN_REBOOT,
     SCREEN_ALERT,
+    SCREEN_DIAGNOSTICS,
     SCREEN_EOL
 };
 
@@ -101,6 +138,25 @@ enum SOUNDFONT_ACTION
     SF_ACTION_SELECT
 };
 
+enum LATENCY_TYPE
+{
+    LATENCY_NOTE_ON,
+    LATENCY_NOTE_OFF,
+    LATENCY_CONTROL,
+    LATENCY_PROGRAM,
+    LATENCY_PITCHBEND,
+    LATENCY_OTHER,
+    LATENCY_EOL
+};
+
+// Display updates coalesced by g_renderQueue - drawn in this order within each frame
+enum RENDER_INTENT
+{
+    RENDER_MIDI, // MIDI activity queued (item unused)
+    RENDER_MIXER, // Mixer channel changed (item is channel, 16 for master)
+    RENDER_METERS // Audio level meters (item unused) - reposted each frame whilst meters are shown
+};
+
 /** MIDI program parameters */
 struct Program
 {
@@ -143,6 +199,33 @@ struct Preset
     bool dirty = false;
 };
 
+/** Compact record of a MIDI event passed from MIDI thread to UI thread */
+struct MidiActivity
+{
+    uint8_t type = 0; // MIDI status (upper nibble)
+    uint8_t channel = 0; // MIDI channel [0-15]
+    uint8_t value1 = 0; // Note, controller or program number
+    uint8_t value2 = 0; // Velocity or controller value
+};
+
+/** Programs applied to synth by audio thread at start of next block */
+struct ProgramSwap
+{
+    int soundfont = FLUID_FAILED;
+    unsigned int bank[16];
+    unsigned int program[16];
+    unsigned int level[16];
+    unsigned int balance[16];
+};
+
+/** Program on a MIDI channel as shown by UI */
+struct ChannelProgram
+{
+    unsigned int bank = 0;
+    unsigned int program = 0;
+    string name; // Name of program from soundfont preset index
+};
+
 /** Limits of each adjustable parameter */
 struct AdjustableParam
 {
@@ -155,23 +238,70 @@ struct AdjustableParam
 
 std::map <unsigned int,AdjustableParam> g_mapParams;
 fluid_synth_t* g_pSynth; // Pointer to the synth object
-ribanfblib* g_pScreen; // Pointer to the screen object
-int g_nCurrentSoundfont = FLUID_FAILED; // ID of currently loaded soundfont
+FbScreen* g_pScreen = NULL; // Pointer to the screen object
+int g_nCurrentSoundfont = FLUID_FAILED; // ID of currently selected soundfont
+SoundfontCache g_sfCache; // Soundfonts resident in synth
+SoundfontLoader g_sfLoader; // Loads soundfonts in background
+PresetIndex g_presetIndex; // Presets within current preset's soundfont
+PresetIndex g_slimIndex; // Presets within slimmed copy of a soundfont, checked before loading it
+std::map<string, string> g_mapLoadPaths; // Paths resolved by getLoadPath indexed by soundfont and programs
+uint64_t g_nSlimModified = 0; // Modification time (ns) of slimmed copy directories when load paths were resolved
+ChannelProgram g_channelProgram[16]; // Program on each MIDI channel - UI thread only
+SynthState g_synthState; // Shadow of synth values read by UI without locking synth
+SynthCommandQueue g_synthQueue; // All changes to synth are posted here and applied by audio thread
+string g_sLoadingSoundfont; // Path of soundfont current preset is waiting for (empty if none)
+int g_nLoadProgress = -1; // Last displayed soundfont load progress (-1 to force redraw)
+FileImporter g_importer; // Copies soundfonts from USB storage in background
+int g_nImportProgress = -1; // Last displayed soundfont import progress (-1 to force redraw)
+ProgramSwap g_programSwap; // Programs waiting to be applied by audio thread
+std::mutex g_mutexProgramSwap; // Protects g_programSwap
+std::atomic<bool> g_bProgramSwapPending(false); // True when g_programSwap is waiting to be applied
+bool g_bEvictPending = false; // True to evict unused soundfonts once programs are swapped
+std::set<string> g_setPrefetch; // Paths of soundfonts used by current and adjacent presets
+unsigned int g_nSoundfontSwitches = 0; // Quantity of preset selections that changed soundfont
+unsigned int g_nPrefetchHits = 0; // Quantity of preset selections that changed to an already resident soundfont
 int g_nRunState = 1; // Current run state [1=running, 0=closing]
-unsigned int g_nNoteCount[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}; // Quantity of notes playing on each MIDI channel
+bool g_bHeadless = false; // True when running without display or GPIO, e.g. benchmark
+AudioMeters g_meters; // Audio level of each MIDI channel and master output, measured by audio thread
+int g_anMeterDrawn[METER_MASTER + 1]; // Packed state of each meter as displayed (-1 to force redraw)
+PolyphonyGovernor g_governor; // Lowers polyphony when DSP load exceeds ceiling
+double g_dSampleRate = 44100.0; // Synth sample rate in Hz
+fluid_settings_t* g_pSettings = NULL; // Settings used to create synth and drivers
+fluid_audio_driver_t* g_pAudioDriver = NULL; // Audio driver (NULL whilst stopped)
+XrunMonitor g_xruns; // Detects and counts audio buffer underruns
+unsigned int g_nXrunsLogged = 0; // Quantity of detected xruns that have been logged
+LatencyCalibration g_calibration; // Searches for smallest reliable period size
+unsigned int g_nCalibrationShown = 0; // Period size shown in calibration toast (0 to force redraw)
+bool g_bCalibrationToast = false; // True whilst calibration toast is displayed
 std::vector<Preset*> g_vPresets; // Map of presets indexed by id
 Preset* g_pCurrentPreset = NULL; // Pointer to the currently selected preset
 unsigned int g_nSelectedChannel = 0; // Index of the selected (highlighted) program
 unsigned char debouncePin[32]; // Debounce streams for each GPIO pin
+RingBuffer<MidiActivity, MIDI_QUEUE_SIZE> g_midiQueue; // Queue of MIDI events from MIDI thread to UI thread
+uint64_t g_nMidiArrival = 0; // Time (us) that current MIDI event arrived from driver (MIDI thread only)
+LatencyHistogram g_latencyHandle[LATENCY_EOL]; // Time from MIDI arrival until synth has handled event, per event type
+LatencyHistogram g_latencyRender[LATENCY_EOL]; // Time from MIDI arrival until end of audio block that rendered it, per event type
+std::atomic<uint64_t> g_nLatencyPending[LATENCY_EOL]; // Arrival time of oldest event not yet rendered, per event type (0 for none)
+Timer g_timerIdle; // Returns from splash or alert screen after idle delay
+Notifier g_notifier; // Wakes main loop when soundfont loads are waiting
+Timer g_timerCalibrate; // Ends each latency calibration step
+RenderQueue g_renderQueue(DEFAULT_RENDER_FPS); // Coalesces MIDI driven display updates into frame-rate capped frames
 
 std::map<unsigned int,ListScreen*> g_mapScreens; // Map of screens indexed by id
 unsigned int g_nCurrentScreen; // Id of currently displayed screen
 unsigned int g_nCurrentChannel = 0; // Selected channel, e.g. within mixer screen
 unsigned int g_nCurrentChar = 0; // Index of highlighted character in name edit
 unsigned int g_nCurrentParam; // Index of parameter currently being edited
-unsigned int g_nBacklight = 900; // Value of backlight PWM level (0..1023)
+unsigned int g_nBacklight = 100; // Backlight brightness in percent (5..100)
+Backlight g_backlight; // Drives display backlight PWM
+Timer g_timerDim; // Dims backlight after idle delay
+HotplugMonitor g_hotplug; // Tracks USB storage mounts and device hotplug
+MidiPorts g_midiPorts; // Connects MIDI inputs to synth as they appear
+unsigned int g_nDimTimeout = DEFAULT_DIM_TIMEOUT; // Time in seconds without button presses before backlight dims (0 to disable)
+unsigned int g_nDimLevel = DEFAULT_DIM_LEVEL; // Brightness in percent when dimmed
 bool g_bDirty = false;// True if configuration needs to be saved
 SOUNDFONT_ACTION g_nSoundfontAction = SF_ACTION_NONE;
+std::vector<std::string> g_vSoundfontFiles; // Soundfont filenames shown in soundfont list screen
 std::function<void(void)> g_pAlertCallback = NULL;
 Style g_style;
 string g_sFont = "liberation/LiberationMono-Regular.ttf";
@@ -210,6 +340,12 @@ string toLower(string sString);
 */
 bool isUsbMounted();
 
+/** Get path to a file on USB storage
+*   @param  sFilename Name of file relative to root of USB storage
+*   @retval string Path to file
+*/
+string getUsbPath(string sFilename);
+
 /** Get the index of a preset
 *   @param  pPreset Pointer to a preset
 *   @retval int Index of preset or -1 if none found
@@ -222,7 +358,7 @@ int getPresetIndex(Preset* pPreset);
 **/
 void panic(int nMode=PANIC_NOTES, int nChannel=16);
 
-/**  Refresh the content of the presets list in the performance screen */
+/**  Refresh the presets list in the performance screen after presets are added or removed */
 void refreshPresetList();
 
 /**  Set the dirty flag of a preset
@@ -267,10 +403,17 @@ void editParam(unsigned int nParam);
 /**  Shows the edit program screen */
 void showEditProgram(unsigned int=0);
 
-/**     Update the MIDI note on indicator on the program screens showing quantity of on notes (max 15)
-*       @param nChannel MIDI channel to update
+/**     Draw audio level meter of a channel on the mixer or preset program screen if it has changed
+*       @param nChannel MIDI channel [0-15] or 16 for master output (mixer only)
 */
-void showMidiActivity(int nChannel);
+void drawMeter(unsigned int nChannel);
+
+/**     Convert an audio level to the length of a meter bar on a dB scale down to METER_FLOOR_DB
+*       @param fLevel Linear level [0..1]
+*       @param nLength Length of full scale bar in pixels
+*       @retval int Length of bar in pixels [0..nLength]
+*/
+int meterLength(float fLevel, int nLength);
 
 /** Draw a mixer channel
 *   @param  nChannel MIDI channel [0-15]
@@ -286,11 +429,22 @@ void drawPresetName();
 */
 void listSoundfont(int nAction);
 
-/** Copy a file
-*   sSource Full path and filename of file to copy
-*   sDest Full path and filename of new file
+/** Copy a soundfont in background, rejecting it if it is not a valid soundfont
+*   @param sSource Full path and filename of file to copy
+*   @param sDest Full path and filename of new file
+*/
+void importSoundfont(string sSource, string sDest);
+
+/** Cancel soundfont imports */
+void cancelImport(unsigned int);
+
+/** Handle soundfont imports that have finished
+*   @note Call from UI (main) thread
 */
-void copyFile(string sSource, string sDest);
+void processImports();
+
+/** Draw progress of soundfont import */
+void showImportProgress();
 
 /** Delete file selected in soundfont file list */
 void deleteFile();
@@ -305,12 +459,109 @@ void deleteFile();
 */
 void alert(string sMessage, string sTitle = "    ALERT", function<void(void)> pFunction = NULL, unsigned int nTimeout = 0);
 
-/** Loads a soundfont from file, unloading previously loaded soundfont
-*   @param sFilename Full path and filename of soundfont to load
-*   @retval bool True on succes
+/** Get the path of a soundfont file
+*   @param sFilename Filename as stored in preset (prefix '~' for default soundfonts)
+*   @retval string Path to soundfont relative to working directory
+*/
+string getSoundfontPath(string sFilename);
+
+/** Get the path of the soundfont file to load for a preset
+*   @param sFilename Filename as stored in preset (prefix '~' for default soundfonts)
+*   @param pPreset Pointer to preset whose programs must be present
+*   @retval string Path to slimmed copy if it is current and contains all of the preset's programs, otherwise path to soundfont
+*   @note  Slimmed copies are written by sf2slim
+*   @note  Result is cached until the soundfont or slimmed copies change
+*/
+string getLoadPath(string sFilename, Preset* pPreset);
+
+/** Forget load paths resolved by getLoadPath if slimmed copies have changed
+*   @note sf2slim replaces slimmed copies by renaming so any change modifies their directory
+*/
+void checkSlimCopies();
+
+/** Selects a soundfont for the current preset, loading in background if not already resident in soundfont cache
+*   @param sFilename Filename of soundfont as stored in preset
+*   @retval bool True on succes (soundfont selected or loading)
+*   @note  Current sound continues to play until new soundfont is loaded then preset programs are swapped at an audio block boundary
+*   @note  Least recently used soundfonts are unloaded once swapped if cache exceeds its memory budget
 */
 bool loadSoundfont(string sFilename);
 
+/** Handle soundfonts that have finished loading in background
+*   @note Call from UI (main) thread
+*/
+void processSoundfontLoads();
+
+/** Set the soundfonts to keep resident for a preset and its neighbours in the performance list
+*   @param nPreset Index of current preset
+*   @note Queued loads of soundfonts no longer adjacent are cancelled
+*/
+void setPrefetchTarget(int nPreset);
+
+/** Load soundfonts of adjacent presets in background, evicting others to stay within cache budget */
+void prefetchPresets();
+
+/** Draw progress of soundfont load required by current preset */
+void showLoadProgress();
+
+/** Log changes made to polyphony by governor
+*   @note Call from UI (main) thread
+*/
+void logGovernor();
+
+/** Log commands, e.g. MIDI events, dropped because the synth command queue was full
+*   @note Call from UI (main) thread
+*/
+void logDroppedCommands();
+
+/** Create audio driver using g_pSettings
+*   @retval bool True on success
+*/
+bool startAudio();
+
+/** Destroy audio driver - synth commands are then processed by main thread */
+void stopAudio();
+
+/** Set audio buffer configuration, restarting audio driver if running and changed
+*   @param nPeriodSize Frames per period
+*   @param nPeriods Quantity of periods in buffer
+*/
+void setAudioPeriod(int nPeriodSize, int nPeriods);
+
+/** Log xruns detected by audio thread and end calibration step if one occurred
+*   @note Call from UI (main) thread
+*/
+void logXruns();
+
+/** Start searching for the smallest reliable period size */
+void startCalibration(unsigned int);
+
+/** Handle end of a calibration step without xruns */
+void onCalibrationStep();
+
+/** Apply and save period size chosen by calibration */
+void finishCalibration();
+
+/** Draw progress of latency calibration */
+void showCalibration();
+
+/** Update values in global group of configuration file without changing other content
+*   @param mapValues Map of values keyed by parameter name
+*   @param sFilename Full path and name of file to update
+*   @retval bool True on success
+*/
+bool updateConfig(const map<string, string>& mapValues, string sFilename = "./fluidbox.config");
+
+/** Queue a preset's programs to be applied by audio thread at start of next block
+*   @param pPreset Pointer to preset
+*/
+void queueProgramSwap(Preset* pPreset);
+
+/** Apply queued programs to synth
+*   @note Called by audio thread - does not block if UI is updating queued programs
+*/
+void applyProgramSwap();
+
 /**  Handle select soundfont action
 *    @param nAction Action to perform on currently selected soundfont
 */
@@ -323,14 +574,80 @@ void populateSoundfontList();
 */
 void showScreen(int nScreen);
 
+/** Handle MIDI input from driver
+*   @param pData Pointer to MIDI router
+*   @param pEvent Pointer to MIDI event
+*   @retval int 0 on success
+*   @note Called by fluidsynth MIDI driver - timestamps arrival then passes to router
+*/
+int onMidiInput(void* pData, fluid_midi_event_t* pEvent);
+
 /** Handle MIDI events
 *   @param pData Pointer to fluidsynth instance
 *   @param pEvent Pointer to MIDI event
 *   @retval int 0 on success
-*   @note Called by fluidsynth MIDI router
+*   @note Called by fluidsynth MIDI router in MIDI driver thread - must not draw or block
+*   @note Events of interest to UI are queued to g_midiQueue for processMidiQueue
 */
 int onMidiEvent(void* pData, fluid_midi_event_t* pEvent);
 
+/** Process MIDI events queued by onMidiEvent, updating presets and posting display updates to g_renderQueue
+*   @note Called from UI (main) thread when g_renderQueue draws a frame
+*/
+void processMidiQueue();
+
+/** Render a block of audio
+*   @param pData Pointer to fluidsynth instance
+*   @param nLen Quantity of frames to render
+*   @param nFx Quantity of effects buffers (not used)
+*   @param pFx Array of effects buffers (not used)
+*   @param nOut Quantity of output buffers
+*   @param pOut Array of output buffers
+*   @retval int 0 on success
+*   @note Called by fluidsynth audio driver. Applies queued synth commands before rendering.
+*/
+int onAudio(void* pData, int nLen, int nFx, float* pFx[], int nOut, float* pOut[]);
+
+/** Render a block of audio with each MIDI channel metered
+*   @param pSynth Pointer to fluidsynth instance
+*   @param nLen Quantity of frames to render
+*   @param pLeft Left output buffer (audio is added to buffer)
+*   @param pRight Right output buffer (audio is added to buffer)
+*   @retval int FLUID_OK on success
+*   @note Requires synth.audio-groups set by createSettings and g_meters initialised with block size
+*/
+int renderAudio(fluid_synth_t* pSynth, int nLen, float* pLeft, float* pRight);
+
+/** Configure audio thread processing (meter buffers, block timing) for the configured audio period and sample rate
+*   @param pSettings Pointer to fluidsynth settings
+*   @note Call before audio driver is started
+*/
+void initAudio(fluid_settings_t* pSettings);
+
+/** Refresh shadow synth state from synth
+*   @param pSynth Pointer to fluidsynth instance
+*   @param pChannel MIDI channel cast to pointer or -1 for all channels
+*   @note Posted to g_synthQueue so that it runs in audio thread
+*/
+void onSyncSynthState(fluid_synth_t* pSynth, void* pChannel);
+
+/** Get the latency type of a MIDI event
+*   @param nType MIDI status (upper nibble)
+*   @retval LATENCY_TYPE Latency type
+*/
+LATENCY_TYPE getLatencyType(int nType);
+
+/** Populate the diagnostics screen with latency statistics */
+void populateDiagnostics();
+
+/** Handle diagnostics screen actions
+*   @param nAction 0 to refresh, 1 to reset statistics
+*/
+void onDiagnostics(int nAction);
+
+/** Print diagnostics to stdout */
+void dumpDiagnostics();
+
 /** Load configuration from file
 *   @param  sFilename Full path and filename of configuration file
 */
@@ -385,9 +702,13 @@ void onRightHold(unsigned int nGpio);
 
 /** Handles signal
 *   @param nSignal Signal number
+*   @note Signals are received via signalfd in main loop so may safely update UI
 */
 void onSignal(int nSignal);
 
+/** Handles idle timer expiry, e.g. to drop back from splash or alert screen */
+void onIdleTimeout();
+
 /** Set the bank and program for the currently selected channel and preset
 *   @param nBankProgram Bank (most significant 8 bits) and program (least significant 8 bits)
 */
@@ -395,16 +716,68 @@ void setPresetProgram(int nBankProgram);
 
 /** Populates the program screen
 *   @param nChannel Channel to edit
+*   @note   Programs are read from the soundfont's preset index so are available before the soundfont has loaded
 */
 void populateProgram(int nChannel);
 
 /** Get the name of the MIDI program (patch) currently loaded to specified channel
 *   @param nChannel MIDI channel
 *   @retval string Name of program
+*   @note   Name is read from cache so does not access synth
 */
 string getProgramName(unsigned int nChannel);
 
+/** Update cached program of a channel
+*   @param nChannel MIDI channel
+*   @param nBank MIDI bank
+*   @param nProgram MIDI program
+*/
+void setChannelProgram(unsigned int nChannel, unsigned int nBank, unsigned int nProgram);
+
+/** Update cached programs of all channels from current preset and soundfont */
+void refreshChannelPrograms();
+
+/** Create fluidsynth settings used by synth engine
+*   @retval fluid_settings_t* Pointer to new settings object
+*/
+fluid_settings_t* createSettings();
+
+/** Run headless benchmark - renders scripted MIDI workload as fast as possible and reports performance
+*   @note  Invoked by "fluidbox --bench [preset] [seconds]" where preset is 1-based (0 for selected preset)
+*   @param nPreset Index of preset to benchmark (-1 for selected preset in configuration)
+*   @param nSeconds Duration of each workload phase in seconds
+*   @retval int Exit code [0=success]
+*/
+int runBenchmark(int nPreset = -1, unsigned int nSeconds = BENCH_PHASE_SECONDS);
+
+/** Run display benchmark - draws text-heavy screens with and without glyph cache, fills and bitmaps with and without vector kernels and reports time per frame
+*   @note  Invoked by "fluidbox --bench-display [frames]". Draws to display so run with fluidbox service stopped.
+*   @param nRepeats Quantity of frames drawn by each test
+*   @retval int Exit code [0=success]
+*/
+int runDisplayBenchmark(unsigned int nRepeats = BENCH_DISPLAY_FRAMES);
+
 /**	Adjust the LCD screen backlight brightness
-*	@param nLevel Brightness [0..1023]
+*	@param nLevel Brightness in percent [0..100]
+*/
+void setBacklight(unsigned int nLevel);
+
+/**	Restore backlight brightness if dimmed and restart idle dimming delay
+*	@note Call on each button press
 */
-void setBacklight(unsigned int nLevel);
\ No newline at end of file
+void wakeBacklight();
+
+/** Handles dim timer expiry, fading backlight to dimmed brightness */
+void onDimTimeout();
+
+/** Enable or disable menu entries that depend on USB storage and refresh them if shown */
+void updateUsbEntries();
+
+/** Handles kernel uevents, e.g. USB storage or MIDI device attached or removed */
+void onUevent();
+
+/** Handles change to mount table */
+void onMountChange();
+
+/** Handles ALSA sequencer port announcements, connecting new MIDI inputs to synth */
+void onMidiPortChange();
\ No newline at end of file
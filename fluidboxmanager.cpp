@@ -1,5 +1,8 @@
 #include "buttonhandler.hpp"
 #include "screen.hpp"
+#include "backlight.hpp"
+#include "hotplug.hpp"
+#include "importer.hpp"
 #include "ribanfblib/ribanfblib.h"
 #include <wiringPi.h>
 #include <iostream> //provides streams
@@ -13,7 +16,7 @@
 #define BUTTON_DOWN   17
 #define BUTTON_LEFT   27
 #define BUTTON_RIGHT   3
-#define GPIO_LED      26
+#define GPIO_LED      12 // PWM0 (wiringPi pin 26)
 using namespace std;
 
 /** Identifies the type of update to perform */
@@ -27,8 +30,9 @@ enum UPDATE_TYPE
 bool g_bRun = true; // True whilst in program loop
 unsigned int g_nCountdown = 159; // Used to draw countdown progress bar (width of screen)
 ListScreen* g_pDisplay; // Pointer to the list screen
-ribanfblib* g_pScreen; // Pointer to the frame buffer object
+FbScreen* g_pScreen; // Pointer to the frame buffer object
 Style g_style;
+string g_sUsbMount; // Mount point of USB storage (empty if not mounted)
 
 /** @brief  Handles signal
 *   @param  nSignal Signal number
@@ -47,44 +51,28 @@ void onSignal(int nSignal)
 
 void copyFile(std::string sSource, std::string sDest)
 {
-    int nSrc = open(sSource.c_str(), O_RDONLY, 0);
-    if(nSrc == -1)
+    FileImporter importer;
+    if(!importer.Start())
         return;
-    int nDst = open(sDest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR); //!@todo File is created with wrong permissions
-    if(nDst == -1)
-    {
-        close(nSrc);
-        return;
-    }
-    struct stat fileStat;
-    stat(sSource.c_str(), &fileStat);
-    if(fileStat.st_blocks < 1)
-    {
-        close(nSrc);
-        close(nDst);
-        return;
-    }
-    size_t nBlocks = fileStat.st_blocks * 512 / fileStat.st_blksize; // Quantity of blocks based on file system block size
-    float fX = 0;
-    float fDx =  159.0 / nBlocks;
-    int nX = 0;
-    char* pBuffer = (char*)malloc(sizeof(char)*fileStat.st_blksize);
+    importer.Import(sSource, sDest);
     g_pScreen->DrawRect(0,100, 159,127, WHITE, 1, GREY);
-    size_t nSize;
-    while(g_bRun && ((nSize = read(nSrc, pBuffer, fileStat.st_blksize)) > 0))
+    int nX = 0;
+    while(importer.IsBusy())
     {
-        write(nDst, pBuffer, nSize);
+        if(!g_bRun)
+            importer.Cancel();
         // Update progress bar
-        fX += fDx;
-        if(int(fX) > nX)
+        int nProgress = importer.GetProgress();
+        if(nProgress * 159 / 100 > nX)
         {
-            nX = fX;
+            nX = nProgress * 159 / 100;
             g_pScreen->DrawRect(0,100, nX,127, WHITE, 1, GREEN);
         }
+        usleep(20000);
     }
-    close(nDst); // There is a delay whilst file is flushed to disk
-    close(nSrc);
-    free(pBuffer);
+    FileImport result;
+    if(importer.GetResult(result) && !result.success)
+        cerr << "Failed to copy " << sSource << ": " << result.error << endl;
 }
 
 void update(int nMode)
@@ -93,9 +81,9 @@ void update(int nMode)
     g_pScreen->DrawText("Updating...", 40, 55);
     g_pScreen->DrawText("Do not turn off", 20, 85);
     if(nMode == UPDATE_FLUIDBOX || nMode == UPDATE_BOTH)
-        copyFile("/media/usb/fluidbox", "./fluidbox");
+        copyFile(g_sUsbMount + "/fluidbox", "./fluidbox");
     if(nMode == UPDATE_BACKUP || nMode == UPDATE_BOTH)
-        copyFile("/media/usb/fluidbox.config", "./fluidbox.config");
+        copyFile(g_sUsbMount + "/fluidbox.config", "./fluidbox.config");
     g_pScreen->Clear();
     g_pScreen->DrawText("Update complete", 10, 72);
     usleep(3000000);
@@ -140,18 +128,23 @@ int main(int argc, char** argv)
     signal(SIGTERM, onSignal);
 
     // Initalise screen
-    ribanfblib screen("/dev/fb1");
+    FbScreen screen("/dev/fb1");
     g_pScreen = & screen;
     g_pScreen->Clear();
 
     // Turn backlight on
-    system("gpio mode 26 pwm");
-    system("gpio pwm 26 900");
+    wiringPiSetupGpio();
+    Backlight backlight;
+    backlight.Open(0, GPIO_LED);
+    backlight.Set(90);
 
     // Look for update files
     struct stat fileStat;
-    bool bFluidbox = (stat ("/media/usb0/fluidbox", &fileStat) == 0 && S_ISREG(fileStat.st_mode));
-    bool bBackup = (stat ("/media/usb0/fluidbox.config", &fileStat) == 0 && S_ISREG(fileStat.st_mode));
+    HotplugMonitor hotplug;
+    hotplug.Open();
+    g_sUsbMount = hotplug.GetUsbMount();
+    bool bFluidbox = hotplug.IsUsbMounted() && (stat ((g_sUsbMount + "/fluidbox").c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode));
+    bool bBackup = hotplug.IsUsbMounted() && (stat ((g_sUsbMount + "/fluidbox.config").c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode));
     if(bFluidbox || bBackup)
     {
         ListScreen display(&screen, "Update available", 0, &g_style);
@@ -168,7 +161,6 @@ int main(int argc, char** argv)
         display.Draw();
 
         // Configure buttons
-        wiringPiSetupGpio();
         ButtonHandler buttonHandler;
         buttonHandler.AddButton(BUTTON_UP, NULL, onButton);
         buttonHandler.AddButton(BUTTON_DOWN, NULL, onButton);
@@ -0,0 +1,191 @@
+/*	Polyphony governor
+
+	Measures the DSP load of each audio block (render time as a proportion of the block period) and lowers the synth polyphony cap when the load exceeds a ceiling.
+	When the cap is lowered fluidsynth stops voices above the new cap and subsequent notes steal the lowest priority voices (released, sustained and quietest first).
+	The cap is raised in steps once the load has remained below the ceiling less the hysteresis for a while.
+	Runs in the audio thread without locks or allocation. Each intervention is queued for the UI thread to log.
+*/
+
+#pragma once
+
+#include "ringbuffer.hpp"
+#include <algorithm> // provides std::min, std::max
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint64_t
+
+#define GOVERNOR_MAX_POLYPHONY 256 // Voices allocated by synth - the cap cannot exceed this
+#define GOVERNOR_MIN_POLYPHONY 16 // Cap is never lowered below this
+#define GOVERNOR_CEILING 80 // Default DSP load ceiling in percent
+#define GOVERNOR_HYSTERESIS 20 // Default percent below ceiling that load must fall before cap is raised
+#define GOVERNOR_SETTLE_MS 100 // Time after lowering cap before it may be lowered again
+#define GOVERNOR_RESTORE_MS 2000 // Time load must remain low before cap is raised
+#define GOVERNOR_SMOOTHING 8 // Quantity of blocks over which load is averaged
+#define GOVERNOR_LOG_SIZE 64 // Quantity of interventions that may be queued for logging
+
+/**	Change to polyphony cap made by governor */
+struct GovernorEvent
+{
+    uint64_t time = 0; // Time of change in milliseconds
+    unsigned int load = 0; // Smoothed DSP load in percent
+    unsigned int peak = 0; // DSP load of block that triggered change in percent
+    unsigned int voices = 0; // Quantity of active voices
+    unsigned int from = 0; // Previous polyphony cap
+    unsigned int to = 0; // New polyphony cap
+};
+
+/**	PolyphonyGovernor class adjusts polyphony to keep DSP load below a ceiling */
+class PolyphonyGovernor
+{
+public:
+    /**	Set maximum polyphony (configured polyphony) - may be called from any thread
+    *	@param	nPolyphony Maximum quantity of voices [GOVERNOR_MIN_POLYPHONY..GOVERNOR_MAX_POLYPHONY]
+    */
+    void SetPolyphony(unsigned int nPolyphony)
+    {
+        m_nMaxPolyphony.store(std::max(std::min(nPolyphony, (unsigned int)GOVERNOR_MAX_POLYPHONY), (unsigned int)GOVERNOR_MIN_POLYPHONY), std::memory_order_relaxed);
+    }
+
+    /**	Get maximum polyphony
+    *	@retval	unsigned int Configured maximum quantity of voices
+    */
+    unsigned int GetPolyphony()
+    {
+        return m_nMaxPolyphony.load(std::memory_order_relaxed);
+    }
+
+    /**	Set DSP load ceiling - may be called from any thread
+    *	@param	nCeiling Load in percent above which polyphony is reduced [10..100], 100 disables governor
+    */
+    void SetCeiling(unsigned int nCeiling)
+    {
+        m_nCeiling.store(std::max(std::min(nCeiling, 100u), 10u), std::memory_order_relaxed);
+    }
+
+    /**	Get DSP load ceiling
+    *	@retval	unsigned int Load ceiling in percent
+    */
+    unsigned int GetCeiling()
+    {
+        return m_nCeiling.load(std::memory_order_relaxed);
+    }
+
+    /**	Set hysteresis - may be called from any thread
+    *	@param	nHysteresis Percent below ceiling that load must fall before polyphony is restored [1..50]
+    */
+    void SetHysteresis(unsigned int nHysteresis)
+    {
+        m_nHysteresis.store(std::max(std::min(nHysteresis, 50u), 1u), std::memory_order_relaxed);
+    }
+
+    /**	Get hysteresis
+    *	@retval	unsigned int Hysteresis in percent
+    */
+    unsigned int GetHysteresis()
+    {
+        return m_nHysteresis.load(std::memory_order_relaxed);
+    }
+
+    /**	Measure a block and decide polyphony cap - call from audio thread after each block
+    *	@param	nRenderTime Time taken to render block in microseconds
+    *	@param	nPeriod Duration of block in microseconds
+    *	@param	nVoices Quantity of active voices
+    *	@param	nNow Current time in milliseconds
+    *	@retval	unsigned int New polyphony cap or 0 if unchanged
+    */
+    unsigned int Update(unsigned int nRenderTime, unsigned int nPeriod, unsigned int nVoices, uint64_t nNow)
+    {
+        if(!nPeriod)
+            return 0;
+        unsigned int nLoad = nRenderTime * 100 / nPeriod;
+        m_nLoadSum += nLoad - m_nLoadSum / GOVERNOR_SMOOTHING;
+        unsigned int nSmoothed = m_nLoadSum / GOVERNOR_SMOOTHING;
+        m_nLoad.store(nSmoothed, std::memory_order_relaxed);
+
+        unsigned int nMax = m_nMaxPolyphony.load(std::memory_order_relaxed);
+        unsigned int nCeiling = m_nCeiling.load(std::memory_order_relaxed);
+        unsigned int nHysteresis = m_nHysteresis.load(std::memory_order_relaxed);
+        unsigned int nCap = m_nCap.load(std::memory_order_relaxed);
+        unsigned int nNewCap = nCap;
+        if(nCap > nMax || (nCeiling >= 100 && nCap < nMax))
+            nNewCap = nMax; // Configuration changed or governor disabled
+        else if(nCeiling < 100 && (nSmoothed > nCeiling || nLoad >= 100) && (!m_nLastChange || nNow - m_nLastChange >= GOVERNOR_SETTLE_MS))
+        {
+            // Overloaded - cap at 3/4 of the voices currently sounding
+            nNewCap = std::max(std::min(nCap, nVoices) * 3 / 4, (unsigned int)GOVERNOR_MIN_POLYPHONY);
+            m_nQuietSince = nNow;
+        }
+        else if(nSmoothed + nHysteresis > nCeiling)
+            m_nQuietSince = nNow;
+        else if(nCap < nMax && nNow - m_nQuietSince >= GOVERNOR_RESTORE_MS)
+        {
+            // Load has been low for a while - restore an eighth of the configured polyphony
+            nNewCap = std::min(nCap + std::max(nMax / 8, 1u), nMax);
+            m_nQuietSince = nNow;
+        }
+        if(nNewCap == nCap)
+            return 0;
+        m_nCap.store(nNewCap, std::memory_order_relaxed);
+        m_nLastChange = nNow;
+        m_nInterventions.fetch_add(1, std::memory_order_relaxed);
+        GovernorEvent event;
+        event.time = nNow;
+        event.load = nSmoothed;
+        event.peak = nLoad;
+        event.voices = nVoices;
+        event.from = nCap;
+        event.to = nNewCap;
+        m_log.Push(event);
+        return nNewCap;
+    }
+
+    /**	Get current polyphony cap
+    *	@retval	unsigned int Quantity of voices currently allowed
+    */
+    unsigned int GetCap()
+    {
+        return m_nCap.load(std::memory_order_relaxed);
+    }
+
+    /**	Get smoothed DSP load
+    *	@retval	unsigned int Load in percent of block period
+    */
+    unsigned int GetLoad()
+    {
+        return m_nLoad.load(std::memory_order_relaxed);
+    }
+
+    /**	Get quantity of changes made to polyphony cap
+    *	@retval	unsigned int Quantity of interventions since last reset
+    */
+    unsigned int GetInterventions()
+    {
+        return m_nInterventions.load(std::memory_order_relaxed);
+    }
+
+    /**	Reset intervention count */
+    void ResetStats()
+    {
+        m_nInterventions.store(0, std::memory_order_relaxed);
+    }
+
+    /**	Get next logged intervention - call from UI thread only
+    *	@param	event Reference to event to populate
+    *	@retval	bool True if an event was returned
+    */
+    bool GetEvent(GovernorEvent& event)
+    {
+        return m_log.Pop(event);
+    }
+
+private:
+    std::atomic<unsigned int> m_nMaxPolyphony = {GOVERNOR_MAX_POLYPHONY}; // Configured polyphony
+    std::atomic<unsigned int> m_nCeiling = {GOVERNOR_CEILING}; // Load ceiling in percent
+    std::atomic<unsigned int> m_nHysteresis = {GOVERNOR_HYSTERESIS}; // Hysteresis in percent
+    std::atomic<unsigned int> m_nCap = {GOVERNOR_MAX_POLYPHONY}; // Polyphony cap currently applied to synth
+    std::atomic<unsigned int> m_nLoad = {0}; // Smoothed load in percent
+    std::atomic<unsigned int> m_nInterventions = {0}; // Quantity of changes to cap
+    unsigned int m_nLoadSum = 0; // Running sum for exponential average of load (audio thread)
+    uint64_t m_nLastChange = 0; // Time cap was last changed in milliseconds (audio thread)
+    uint64_t m_nQuietSince = 0; // Time load last exceeded restore threshold in milliseconds (audio thread)
+    RingBuffer<GovernorEvent, GOVERNOR_LOG_SIZE> m_log; // Interventions waiting to be logged
+};
@@ -0,0 +1,319 @@
+/*	GPIO input backends
+
+	Provides a small interface to GPIO inputs used by ButtonHandler with implementations for:
+	  ChardevGpio - Linux GPIO character device line events with kernel timestamps
+	  WiringPiGpio - Polled wiringPi reads (for systems without GPIO character device)
+	  SimulatedGpio - Scripted edges with a virtual clock (for testing and benchmarking without hardware)
+	Define GPIO_NO_WIRINGPI to build without wiringPi, e.g. for buttonbench on a plain Linux box.
+*/
+
+#pragma once
+
+#include <cstdint> // provides uint64_t
+#include <cstring> // provides memset, strncpy
+#include <deque> // provides std::deque
+#include <map> // provides std::map
+#include <string> // provides std::string
+#include <fcntl.h> // provides open
+#include <time.h> // provides clock_gettime
+#include <unistd.h> // provides read, write, close
+#include <sys/epoll.h> // provides epoll
+#include <sys/eventfd.h> // provides eventfd
+#include <sys/ioctl.h> // provides ioctl
+#include <linux/gpio.h> // provides GPIO character device interface
+#ifndef GPIO_NO_WIRINGPI
+#include <wiringPi.h> // provides wiringPi gpio functions
+#endif
+
+/**	Change of level on a GPIO input */
+struct GpioEdge
+{
+    unsigned int gpio = 0; // GPIO (BCM) number
+    int level = 1; // New level [0, 1]
+    uint64_t time = 0; // Time of edge in microseconds (same clock as GpioBackend::Now)
+};
+
+/**	GpioBackend is the interface to GPIO inputs used by ButtonHandler */
+class GpioBackend
+{
+public:
+    virtual ~GpioBackend()
+    {
+    }
+
+    /**	Configure a GPIO as input with pull-up
+    *	@param	nGpio GPIO (BCM) number
+    *	@retval	bool True on success
+    */
+    virtual bool AddInput(unsigned int nGpio) = 0;
+
+    /**	Read current level of a GPIO
+    *	@param	nGpio GPIO (BCM) number
+    *	@retval	int Level [0, 1]
+    */
+    virtual int Read(unsigned int nGpio) = 0;
+
+    /**	Get next pending edge
+    *	@param	edge Reference to populate with edge
+    *	@retval	bool True if an edge was available
+    */
+    virtual bool GetEdge(GpioEdge& edge) = 0;
+
+    /**	Get file descriptor that becomes readable when edges are pending
+    *	@retval	int File descriptor or -1 if backend does not report edges (caller must poll Read)
+    */
+    virtual int GetFd()
+    {
+        return -1;
+    }
+
+    /**	Get current time
+    *	@retval	uint64_t Time in microseconds
+    */
+    virtual uint64_t Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+};
+
+/**	ChardevGpio class reads GPIO edges from Linux GPIO character device */
+class ChardevGpio : public GpioBackend
+{
+public:
+    /**	Open GPIO character device
+    *	@param	sChip Path to GPIO chip device
+    */
+    ChardevGpio(std::string sChip = "/dev/gpiochip0")
+    {
+        m_nChipFd = open(sChip.c_str(), O_RDONLY | O_CLOEXEC);
+        m_nEpollFd = epoll_create1(EPOLL_CLOEXEC);
+        // Kernels before 5.7 timestamp events with CLOCK_REALTIME
+        struct timespec tsReal, tsMono;
+        clock_gettime(CLOCK_REALTIME, &tsReal);
+        clock_gettime(CLOCK_MONOTONIC, &tsMono);
+        m_nRealtimeOffset = ((int64_t)tsReal.tv_sec - tsMono.tv_sec) * 1000000 + (tsReal.tv_nsec - tsMono.tv_nsec) / 1000;
+    }
+
+    ~ChardevGpio()
+    {
+        for(auto it = m_mapLines.begin(); it != m_mapLines.end(); ++it)
+            close(it->second);
+        if(m_nEpollFd >= 0)
+            close(m_nEpollFd);
+        if(m_nChipFd >= 0)
+            close(m_nChipFd);
+    }
+
+    /**	Check if GPIO character device opened
+    *	@retval	bool True if open
+    */
+    bool IsOpen()
+    {
+        return m_nChipFd >= 0 && m_nEpollFd >= 0;
+    }
+
+    bool AddInput(unsigned int nGpio) override
+    {
+        if(!IsOpen() || m_mapLines.count(nGpio))
+            return IsOpen();
+#ifndef GPIO_NO_WIRINGPI
+        pullUpDnControl(nGpio, PUD_UP); // Bias flags are not supported by older kernels
+#endif
+        struct gpioevent_request request;
+        memset(&request, 0, sizeof(request));
+        request.lineoffset = nGpio;
+        request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+#ifdef GPIOHANDLE_REQUEST_BIAS_PULL_UP
+        request.handleflags |= GPIOHANDLE_REQUEST_BIAS_PULL_UP;
+#endif
+        request.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+        strncpy(request.consumer_label, "fluidbox", sizeof(request.consumer_label) - 1);
+        if(ioctl(m_nChipFd, GPIO_GET_LINEEVENT_IOCTL, &request) < 0)
+            return false;
+        fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u32 = nGpio;
+        epoll_ctl(m_nEpollFd, EPOLL_CTL_ADD, request.fd, &event);
+        m_mapLines[nGpio] = request.fd;
+        return true;
+    }
+
+    int Read(unsigned int nGpio) override
+    {
+        auto it = m_mapLines.find(nGpio);
+        if(it == m_mapLines.end())
+            return 1;
+        struct gpiohandle_data data;
+        memset(&data, 0, sizeof(data));
+        if(ioctl(it->second, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+            return 1;
+        return data.values[0] ? 1 : 0;
+    }
+
+    bool GetEdge(GpioEdge& edge) override
+    {
+        if(m_deqEdges.empty())
+        {
+            // Collect events from all lines that are ready
+            struct epoll_event aEvents[8];
+            int nCount = epoll_wait(m_nEpollFd, aEvents, 8, 0);
+            for(int nEvent = 0; nEvent < nCount; ++nEvent)
+            {
+                unsigned int nGpio = aEvents[nEvent].data.u32;
+                struct gpioevent_data data;
+                while(read(m_mapLines[nGpio], &data, sizeof(data)) == sizeof(data))
+                {
+                    GpioEdge newEdge;
+                    newEdge.gpio = nGpio;
+                    newEdge.level = (data.id == GPIOEVENT_EVENT_RISING_EDGE) ? 1 : 0;
+                    newEdge.time = data.timestamp / 1000;
+                    if(newEdge.time > Now() + 1000000)
+                        newEdge.time -= m_nRealtimeOffset;
+                    m_deqEdges.push_back(newEdge);
+                }
+            }
+        }
+        if(m_deqEdges.empty())
+            return false;
+        edge = m_deqEdges.front();
+        m_deqEdges.pop_front();
+        return true;
+    }
+
+    int GetFd() override
+    {
+        return m_nEpollFd;
+    }
+
+private:
+    int m_nChipFd = -1; // GPIO chip file descriptor
+    int m_nEpollFd = -1; // epoll file descriptor aggregating all line event file descriptors
+    int64_t m_nRealtimeOffset = 0; // Difference between realtime and monotonic clocks in microseconds
+    std::map<unsigned int, int> m_mapLines; // Line event file descriptors indexed by GPIO
+    std::deque<GpioEdge> m_deqEdges; // Edges read but not yet returned
+};
+
+#ifndef GPIO_NO_WIRINGPI
+/**	WiringPiGpio class reads GPIO levels with wiringPi - does not report edges so caller must poll
+*	@note	Call wiringPiSetupGpio() before use
+*/
+class WiringPiGpio : public GpioBackend
+{
+public:
+    bool AddInput(unsigned int nGpio) override
+    {
+        pinMode(nGpio, INPUT);
+        pullUpDnControl(nGpio, PUD_UP);
+        return true;
+    }
+
+    int Read(unsigned int nGpio) override
+    {
+        return digitalRead(nGpio);
+    }
+
+    bool GetEdge(GpioEdge&) override
+    {
+        return false;
+    }
+};
+#endif
+
+/**	SimulatedGpio class injects scripted edges using a virtual clock */
+class SimulatedGpio : public GpioBackend
+{
+public:
+    SimulatedGpio()
+    {
+        m_nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~SimulatedGpio()
+    {
+        if(m_nFd >= 0)
+            close(m_nFd);
+    }
+
+    bool AddInput(unsigned int nGpio) override
+    {
+        m_mapLevels[nGpio] = 1;
+        return true;
+    }
+
+    int Read(unsigned int nGpio) override
+    {
+        auto it = m_mapLevels.find(nGpio);
+        return (it == m_mapLevels.end()) ? 1 : it->second;
+    }
+
+    bool GetEdge(GpioEdge& edge) override
+    {
+        if(m_deqEdges.empty() || m_deqEdges.front().time > m_nNow)
+        {
+            uint64_t nValue;
+            if(read(m_nFd, &nValue, sizeof(nValue)) != sizeof(nValue))
+                nValue = 0;
+            return false;
+        }
+        edge = m_deqEdges.front();
+        m_deqEdges.pop_front();
+        m_mapLevels[edge.gpio] = edge.level;
+        return true;
+    }
+
+    int GetFd() override
+    {
+        return m_nFd;
+    }
+
+    uint64_t Now() override
+    {
+        return m_nNow;
+    }
+
+    /**	Schedule an edge
+    *	@param	nGpio GPIO number
+    *	@param	nLevel New level [0, 1]
+    *	@param	nTime Time of edge in microseconds (virtual clock)
+    *	@note	Edges must be scheduled in time order
+    */
+    void Inject(unsigned int nGpio, int nLevel, uint64_t nTime)
+    {
+        GpioEdge edge;
+        edge.gpio = nGpio;
+        edge.level = nLevel;
+        edge.time = nTime;
+        m_deqEdges.push_back(edge);
+    }
+
+    /**	Set virtual clock, signalling file descriptor if edges become due
+    *	@param	nTime Time in microseconds
+    */
+    void SetTime(uint64_t nTime)
+    {
+        m_nNow = nTime;
+        if(!m_deqEdges.empty() && m_deqEdges.front().time <= m_nNow)
+        {
+            uint64_t nValue = 1;
+            if(write(m_nFd, &nValue, sizeof(nValue)) != sizeof(nValue))
+                return;
+        }
+    }
+
+    /**	Get time of next scheduled edge
+    *	@retval	uint64_t Time in microseconds or 0 if no edges scheduled
+    */
+    uint64_t GetNextEdge()
+    {
+        return m_deqEdges.empty() ? 0 : m_deqEdges.front().time;
+    }
+
+private:
+    int m_nFd = -1; // eventfd signalled when edges are due
+    uint64_t m_nNow = 0; // Virtual clock in microseconds
+    std::map<unsigned int, int> m_mapLevels; // Current level indexed by GPIO
+    std::deque<GpioEdge> m_deqEdges; // Scheduled edges in time order
+};
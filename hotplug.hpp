@@ -0,0 +1,195 @@
+/*	Hotplug monitor
+
+	Keeps a current view of mounted USB storage without spawning shell commands.
+	Listens for kernel uevents (netlink) to learn when storage and sound devices are attached or removed.
+	Watches /proc/self/mountinfo, which signals EPOLLPRI whenever the mount table changes, to find where USB storage is mounted.
+*/
+
+#pragma once
+
+#include <cstring> // provides strncmp, memset
+#include <string> // provides std::string
+#include <fcntl.h> // provides open
+#include <unistd.h> // provides read, lseek, close
+#include <sys/socket.h> // provides socket, recv
+#include <linux/netlink.h> // provides netlink uevent socket
+
+#define HOTPLUG_USB_MOUNT "/media/usb" // Mount points starting with this path are USB storage
+#define HOTPLUG_UEVENT_SIZE 4096 // Largest uevent message
+
+/**	Type of device changed by a hotplug event */
+enum HOTPLUG_CHANGE
+{
+    HOTPLUG_NONE = 0,
+    HOTPLUG_STORAGE = 1, // Block device added or removed
+    HOTPLUG_SOUND = 2 // Sound (e.g. USB MIDI) device added or removed
+};
+
+/**	HotplugMonitor class tracks USB storage mounts and device hotplug events */
+class HotplugMonitor
+{
+public:
+    ~HotplugMonitor()
+    {
+        if(m_nUeventFd >= 0)
+            close(m_nUeventFd);
+        if(m_nMountFd >= 0)
+            close(m_nMountFd);
+    }
+
+    /**	Start monitoring
+    *	@retval	bool True if mount table can be monitored (uevents are optional)
+    */
+    bool Open()
+    {
+        m_nUeventFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+        if(m_nUeventFd >= 0)
+        {
+            struct sockaddr_nl addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.nl_family = AF_NETLINK;
+            addr.nl_groups = 1; // Kernel uevents
+            if(bind(m_nUeventFd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+            {
+                close(m_nUeventFd);
+                m_nUeventFd = -1;
+            }
+        }
+        m_nMountFd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+        if(m_nMountFd < 0)
+            return false;
+        ReadMounts();
+        return true;
+    }
+
+    /**	Get file descriptor that is readable when uevents are waiting (-1 if unavailable) */
+    int GetUeventFd()
+    {
+        return m_nUeventFd;
+    }
+
+    /**	Get file descriptor that signals EPOLLPRI when mount table changes (-1 if unavailable) */
+    int GetMountFd()
+    {
+        return m_nMountFd;
+    }
+
+    /**	Read waiting uevents - call when uevent file descriptor is readable
+    *	@retval	unsigned int Bitmask of device types changed [HOTPLUG_CHANGE]
+    */
+    unsigned int ProcessUevents()
+    {
+        unsigned int nChanges = HOTPLUG_NONE;
+        char acBuffer[HOTPLUG_UEVENT_SIZE];
+        ssize_t nLen;
+        while((nLen = recv(m_nUeventFd, acBuffer, sizeof(acBuffer) - 1, 0)) > 0)
+        {
+            // Message is a header (action@devpath) then null terminated KEY=value pairs
+            acBuffer[nLen] = 0;
+            std::string sAction, sSubsystem;
+            for(ssize_t nPos = 0; nPos < nLen; nPos += strlen(acBuffer + nPos) + 1)
+            {
+                if(strncmp(acBuffer + nPos, "ACTION=", 7) == 0)
+                    sAction = acBuffer + nPos + 7;
+                else if(strncmp(acBuffer + nPos, "SUBSYSTEM=", 10) == 0)
+                    sSubsystem = acBuffer + nPos + 10;
+            }
+            if(sAction != "add" && sAction != "remove")
+                continue;
+            if(sSubsystem == "block")
+                nChanges |= HOTPLUG_STORAGE;
+            else if(sSubsystem == "sound")
+                nChanges |= HOTPLUG_SOUND;
+        }
+        return nChanges;
+    }
+
+    /**	Read mount table - call when mount file descriptor signals EPOLLPRI
+    *	@retval	bool True if USB storage mount has changed
+    */
+    bool ProcessMounts()
+    {
+        std::string sMount = m_sUsbMount;
+        ReadMounts();
+        return sMount != m_sUsbMount;
+    }
+
+    /**	Check if USB storage is mounted
+    *	@retval	bool True if mounted
+    */
+    bool IsUsbMounted()
+    {
+        return !m_sUsbMount.empty();
+    }
+
+    /**	Get where USB storage is mounted
+    *	@retval	string Mount point or empty string if not mounted
+    */
+    std::string GetUsbMount()
+    {
+        return m_sUsbMount;
+    }
+
+private:
+    /**	Find USB storage in mount table */
+    void ReadMounts()
+    {
+        if(m_nMountFd < 0 || lseek(m_nMountFd, 0, SEEK_SET) != 0)
+            return;
+        std::string sTable;
+        char acBuffer[4096];
+        ssize_t nLen;
+        while((nLen = read(m_nMountFd, acBuffer, sizeof(acBuffer))) > 0)
+            sTable.append(acBuffer, nLen);
+        m_sUsbMount.clear();
+        size_t nStart = 0;
+        while(nStart < sTable.length())
+        {
+            size_t nEnd = sTable.find('\n', nStart);
+            if(nEnd == std::string::npos)
+                nEnd = sTable.length();
+            std::string sMount = GetField(sTable.substr(nStart, nEnd - nStart), 4);
+            nStart = nEnd + 1;
+            if(sMount.compare(0, strlen(HOTPLUG_USB_MOUNT), HOTPLUG_USB_MOUNT) == 0)
+            {
+                m_sUsbMount = sMount;
+                break;
+            }
+        }
+    }
+
+    /**	Get a space separated field from a mountinfo line, decoding octal escapes (e.g. \040 for space)
+    *	@param	sLine Line of mountinfo
+    *	@param	nField Index of field (4 is mount point)
+    *	@retval	string Field value or empty string if line has too few fields
+    */
+    std::string GetField(const std::string& sLine, unsigned int nField)
+    {
+        size_t nStart = 0;
+        for(unsigned int nIndex = 0; nIndex < nField; ++nIndex)
+        {
+            nStart = sLine.find(' ', nStart);
+            if(nStart == std::string::npos)
+                return "";
+            ++nStart;
+        }
+        size_t nEnd = sLine.find(' ', nStart);
+        std::string sField = sLine.substr(nStart, nEnd == std::string::npos ? std::string::npos : nEnd - nStart);
+        std::string sDecoded;
+        for(size_t nPos = 0; nPos < sField.length(); ++nPos)
+        {
+            if(sField[nPos] == '\\' && nPos + 3 < sField.length() && sField[nPos + 1] >= '0' && sField[nPos + 1] <= '7')
+            {
+                sDecoded += (char)((sField[nPos + 1] - '0') * 64 + (sField[nPos + 2] - '0') * 8 + (sField[nPos + 3] - '0'));
+                nPos += 3;
+            }
+            else
+                sDecoded += sField[nPos];
+        }
+        return sDecoded;
+    }
+
+    int m_nUeventFd = -1; // Netlink socket receiving kernel uevents
+    int m_nMountFd = -1; // /proc/self/mountinfo
+    std::string m_sUsbMount; // Mount point of USB storage (empty if not mounted)
+};
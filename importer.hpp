@@ -0,0 +1,436 @@
+/*	Background file import
+
+	Copies files (e.g. soundfonts from USB storage) in a worker thread so that the UI is not blocked by large copies.
+	Data is copied within the kernel with copy_file_range, or sendfile where the file systems do not support it, so file content is never copied through user space.
+	Soundfonts are validated whilst they are copied: RIFF chunk headers are read (from page cache) as the copy reaches them so a truncated or corrupt soundfont is rejected as soon as the fault is found.
+	Files are written to a temporary name beside the destination then renamed so an incomplete file never appears at the destination.
+*/
+
+#pragma once
+
+#include <algorithm> // provides std::min
+#include <atomic> // provides std::atomic
+#include <condition_variable> // provides std::condition_variable
+#include <cstdint> // provides uint32_t
+#include <cstdio> // provides rename
+#include <cstring> // provides memcmp
+#include <deque> // provides std::deque
+#include <functional> // provides std::function
+#include <mutex> // provides std::mutex
+#include <set> // provides std::set
+#include <string> // provides std::string
+#include <thread> // provides std::thread
+#include <errno.h> // provides errno
+#include <fcntl.h> // provides open
+#include <unistd.h> // provides copy_file_range, pread, fsync, unlink
+#include <sys/sendfile.h> // provides sendfile
+#include <sys/stat.h> // provides fstat
+
+#define IMPORT_CHUNK_SIZE (4 * 1024 * 1024) // Bytes copied between progress updates and cancellation checks
+#define IMPORT_TEMP_SUFFIX ".part" // Appended to destination whilst copying
+
+/**	Validates the RIFF chunk structure of a SoundFont 2 (sfbk) file as it is read */
+class SoundfontValidator
+{
+public:
+    /**	Start validating a file
+    *	@param	nFd File descriptor of soundfont (read with pread so file offset is not changed)
+    *	@param	nFileSize Size of file in bytes
+    *	@retval	bool True if file has a valid RIFF sfbk header and is not truncated
+    */
+    bool Begin(int nFd, off_t nFileSize)
+    {
+        m_nFd = nFd;
+        m_nPos = 12;
+        m_nListEnd = 0;
+        m_bComplete = false;
+        m_setLists.clear();
+        m_setChunks.clear();
+        m_sError = "";
+        char acHeader[12];
+        if(nFileSize < 12 || pread(nFd, acHeader, 12, 0) != 12 || memcmp(acHeader, "RIFF", 4) != 0 || memcmp(acHeader + 8, "sfbk", 4) != 0)
+            return Fail("Not a soundfont");
+        m_nRiffEnd = 8 + (off_t)GetSize(acHeader + 4);
+        if(m_nRiffEnd > nFileSize)
+            return Fail("Truncated file");
+        return true;
+    }
+
+    /**	Validate chunk headers before a position in the file
+    *	@param	nPos Offset in file that data is about to be copied up to
+    *	@retval	bool True if structure is valid so far
+    */
+    bool Advance(off_t nPos)
+    {
+        while(m_sError.empty() && !m_bComplete && m_nPos < nPos)
+        {
+            if(m_nListEnd && m_nPos >= m_nListEnd)
+            {
+                m_nListEnd = 0; // Leave LIST
+                continue;
+            }
+            if(!m_nListEnd && m_nPos >= m_nRiffEnd)
+            {
+                m_bComplete = true;
+                break;
+            }
+            char acHeader[12];
+            size_t nHeader = m_nListEnd ? 8 : 12; // Top level chunks are LISTs with a type
+            if(pread(m_nFd, acHeader, nHeader, m_nPos) != (ssize_t)nHeader)
+                return Fail("Read error");
+            std::string sId(acHeader, 4);
+            uint32_t nSize = GetSize(acHeader + 4);
+            off_t nEnd = m_nPos + 8 + nSize + (nSize & 1); // Chunks are padded to even length
+            if(nEnd > (m_nListEnd ? m_nListEnd : m_nRiffEnd))
+                return Fail("Corrupt chunk");
+            if(!m_nListEnd)
+            {
+                if(sId != "LIST" || nSize < 4)
+                    return Fail("Corrupt chunk");
+                m_sList = std::string(acHeader + 8, 4);
+                m_setLists.insert(m_sList);
+                m_nListEnd = nEnd;
+                m_nPos += 12;
+                continue;
+            }
+            if(m_sList == "pdta")
+            {
+                unsigned int nRecord = GetRecordSize(sId);
+                if(!nRecord || nSize % nRecord || nSize < nRecord) // Each list ends with a terminal record
+                    return Fail("Corrupt presets");
+            }
+            m_setChunks.insert(m_sList + sId);
+            m_nPos = nEnd;
+        }
+        return m_sError.empty();
+    }
+
+    /**	Validate remaining chunks and check all required chunks are present
+    *	@retval	bool True if file is a valid soundfont
+    */
+    bool Finish()
+    {
+        if(!Advance(m_nRiffEnd + 1))
+            return false;
+        if(!m_setLists.count("INFO") || !m_setLists.count("sdta") || !m_setLists.count("pdta"))
+            return Fail("Missing chunk");
+        if(!m_setChunks.count("sdtasmpl"))
+            return Fail("Missing samples");
+        for(const char* sId : {"phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr"})
+            if(!m_setChunks.count(std::string("pdta") + sId))
+                return Fail("Missing presets");
+        return true;
+    }
+
+    /**	Get reason validation failed
+    *	@retval	string Short description of fault (empty if valid)
+    */
+    std::string GetError()
+    {
+        return m_sError;
+    }
+
+private:
+    bool Fail(std::string sError)
+    {
+        m_sError = sError;
+        return false;
+    }
+
+    /**	Get little endian chunk size */
+    uint32_t GetSize(const char* pData)
+    {
+        const unsigned char* p = (const unsigned char*)pData;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    /**	Get size of each record in a preset data (pdta) sub-chunk
+    *	@param	sId Sub-chunk id
+    *	@retval	unsigned int Size of record in bytes or 0 if sub-chunk is not recognised
+    */
+    unsigned int GetRecordSize(const std::string& sId)
+    {
+        if(sId == "phdr")
+            return 38;
+        if(sId == "inst")
+            return 22;
+        if(sId == "shdr")
+            return 46;
+        if(sId == "pmod" || sId == "imod")
+            return 10;
+        if(sId == "pbag" || sId == "pgen" || sId == "ibag" || sId == "igen")
+            return 4;
+        return 0;
+    }
+
+    int m_nFd = -1; // File being validated
+    off_t m_nPos = 0; // Offset of next chunk header
+    off_t m_nRiffEnd = 0; // Offset of end of RIFF chunk
+    off_t m_nListEnd = 0; // Offset of end of current LIST (0 at top level)
+    std::string m_sList; // Type of current LIST
+    bool m_bComplete = false; // True when all chunks have been validated
+    std::set<std::string> m_setLists; // Types of LISTs found
+    std::set<std::string> m_setChunks; // Sub-chunks found, prefixed by LIST type
+    std::string m_sError; // Reason validation failed
+};
+
+/**	Request to import a file */
+struct FileImport
+{
+    std::string source; // Path to file to copy
+    std::string dest; // Path to copy file to
+    bool soundfont = false; // True to validate file as a soundfont
+    bool success = false; // True if file was copied (result only)
+    std::string error; // Short description of failure (result only)
+};
+
+/**	FileImporter class copies files in a background thread */
+class FileImporter
+{
+public:
+    ~FileImporter()
+    {
+        Stop();
+    }
+
+    /**	Start the worker thread
+    *	@retval	bool True on success
+    */
+    bool Start()
+    {
+        if(m_bRun)
+            return true;
+        m_bRun = true;
+        m_thread = std::thread(&FileImporter::Run, this);
+        return true;
+    }
+
+    /**	Stop the worker thread, abandoning any import in progress */
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bRun = false;
+            m_deqRequests.clear();
+        }
+        m_bCancel = true;
+        m_cv.notify_all();
+        if(m_thread.joinable())
+            m_thread.join();
+    }
+
+    /**	Set function called from worker thread when a result is ready, e.g. to wake caller's event loop
+    *	@param	fnNotify Function to call
+    *	@note	Call before Start
+    */
+    void SetNotify(std::function<void()> fnNotify)
+    {
+        m_fnNotify = fnNotify;
+    }
+
+    /**	Request a file is copied
+    *	@param	sSource Path to file to copy
+    *	@param	sDest Path to copy file to (replaced only if copy succeeds)
+    *	@param	bSoundfont True to reject file if it is not a valid soundfont
+    */
+    void Import(std::string sSource, std::string sDest, bool bSoundfont = false)
+    {
+        FileImport request;
+        request.source = sSource;
+        request.dest = sDest;
+        request.soundfont = bSoundfont;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_deqRequests.push_back(request);
+        }
+        m_cv.notify_one();
+    }
+
+    /**	Cancel all queued imports and any import in progress */
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_deqRequests.clear();
+        if(!m_sCurrent.empty())
+            m_bCancel = true;
+    }
+
+    /**	Check if imports are queued or in progress
+    *	@retval	bool True if busy
+    */
+    bool IsBusy()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_sCurrent.empty() || !m_deqRequests.empty();
+    }
+
+    /**	Get the next completed import
+    *	@param	result Reference to populate with result
+    *	@retval	bool True if a result was available
+    */
+    bool GetResult(FileImport& result)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_deqResults.empty())
+            return false;
+        result = m_deqResults.front();
+        m_deqResults.pop_front();
+        return true;
+    }
+
+    /**	Get progress of import in progress
+    *	@retval	int Percentage copied [0..100] or -1 if not importing
+    */
+    int GetProgress()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_sCurrent.empty())
+            return -1;
+        off_t nSize = m_nSize.load(std::memory_order_relaxed);
+        if(!nSize)
+            return 0;
+        off_t nCopied = m_nCopied.load(std::memory_order_relaxed);
+        return (nCopied >= nSize) ? 100 : nCopied * 100 / nSize;
+    }
+
+    /**	Get source path of import in progress
+    *	@retval	string Path to file being copied (empty if not importing)
+    */
+    std::string GetCurrent()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sCurrent;
+    }
+
+private:
+    /**	Worker thread loop */
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_bRun)
+        {
+            if(m_deqRequests.empty())
+            {
+                m_cv.wait(lock);
+                continue;
+            }
+            FileImport request = m_deqRequests.front();
+            m_deqRequests.pop_front();
+            m_sCurrent = request.source;
+            m_nSize = 0;
+            m_nCopied = 0;
+            m_bCancel = false;
+            lock.unlock();
+
+            Copy(request);
+
+            lock.lock();
+            m_sCurrent = "";
+            m_deqResults.push_back(request);
+            if(m_fnNotify)
+                m_fnNotify();
+        }
+    }
+
+    /**	Copy a file to a temporary name, validating if required, then rename to destination
+    *	@param	request Import to perform - success and error are populated
+    */
+    void Copy(FileImport& request)
+    {
+        int nSrc = open(request.source.c_str(), O_RDONLY | O_CLOEXEC);
+        if(nSrc < 0)
+        {
+            request.error = "Cannot open file";
+            return;
+        }
+        struct stat fileStat;
+        if(fstat(nSrc, &fileStat) != 0)
+        {
+            close(nSrc);
+            request.error = "Cannot open file";
+            return;
+        }
+        m_nSize = fileStat.st_size;
+        posix_fadvise(nSrc, 0, 0, POSIX_FADV_SEQUENTIAL);
+        SoundfontValidator validator;
+        if(request.soundfont && !validator.Begin(nSrc, fileStat.st_size))
+        {
+            close(nSrc);
+            request.error = validator.GetError();
+            return;
+        }
+        std::string sTemp = request.dest + IMPORT_TEMP_SUFFIX;
+        int nDst = open(sTemp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, (fileStat.st_mode & 0111) ? 0755 : 0644);
+        if(nDst < 0)
+        {
+            close(nSrc);
+            request.error = "Cannot write file";
+            return;
+        }
+        bool bKernelCopy = true; // False if copy_file_range is not supported between these file systems
+        loff_t nOffset = 0;
+        while(nOffset < fileStat.st_size)
+        {
+            if(m_bCancel)
+            {
+                request.error = "Cancelled";
+                break;
+            }
+            size_t nCount = std::min((off_t)IMPORT_CHUNK_SIZE, fileStat.st_size - (off_t)nOffset);
+            if(request.soundfont && !validator.Advance(nOffset + nCount))
+            {
+                request.error = validator.GetError();
+                break;
+            }
+            ssize_t nCopied = -1;
+            if(bKernelCopy)
+            {
+                nCopied = copy_file_range(nSrc, &nOffset, nDst, NULL, nCount, 0);
+                if(nCopied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+                    bKernelCopy = false;
+            }
+            if(!bKernelCopy)
+            {
+                off_t nSendOffset = nOffset;
+                nCopied = sendfile(nDst, nSrc, &nSendOffset, nCount);
+                if(nCopied > 0)
+                    nOffset = nSendOffset;
+            }
+            if(nCopied < 0 && errno == EINTR)
+                continue;
+            if(nCopied <= 0)
+            {
+                request.error = (nCopied == 0) ? "Truncated file" : "Copy failed";
+                break;
+            }
+            m_nCopied = nOffset;
+        }
+        close(nSrc);
+        if(request.error.empty() && request.soundfont && !validator.Finish())
+            request.error = validator.GetError();
+        if(request.error.empty() && fsync(nDst) != 0)
+            request.error = "Copy failed"; // e.g. storage full
+        if(close(nDst) != 0 && request.error.empty())
+            request.error = "Copy failed";
+        if(request.error.empty() && rename(sTemp.c_str(), request.dest.c_str()) != 0)
+            request.error = "Cannot write file";
+        if(!request.error.empty())
+        {
+            unlink(sTemp.c_str());
+            return;
+        }
+        request.success = true;
+    }
+
+    std::thread m_thread; // Worker thread
+    std::mutex m_mutex; // Protects requests, results and current path
+    std::condition_variable m_cv; // Signals worker when requests are added or stopping
+    bool m_bRun = false; // True whilst worker should run
+    std::deque<FileImport> m_deqRequests; // Imports waiting to start
+    std::deque<FileImport> m_deqResults; // Completed imports waiting for caller
+    std::string m_sCurrent; // Source path of import in progress (empty if none)
+    std::function<void()> m_fnNotify; // Called when a result is ready
+    std::atomic<bool> m_bCancel = {false}; // True to abandon import in progress
+    std::atomic<off_t> m_nSize = {0}; // Size of file being imported
+    std::atomic<off_t> m_nCopied = {0}; // Bytes copied of file being imported
+};
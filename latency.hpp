@@ -0,0 +1,121 @@
+/*	Lock-free latency measurement
+
+	Provides fixed size histograms that may be written from realtime threads (MIDI, audio) and read from the UI thread.
+*/
+
+#pragma once
+
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint64_t
+#include <time.h> // provides clock_gettime
+
+#define LATENCY_BUCKETS 128 // 4 buckets per power of 2 covers full 32-bit range
+
+/**	Get monotonic time
+*	@retval	uint64_t Time in microseconds since arbitrary epoch
+*/
+inline uint64_t getMicros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**	LatencyHistogram class records durations in logarithmic buckets (approx. 25% resolution)
+*	@note	Add may be called from any thread without locking. Readers see a consistent enough view for diagnostics.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    /**	Add a measurement to the histogram
+    *	@param	nMicros Duration in microseconds
+    */
+    void Add(uint64_t nMicros)
+    {
+        unsigned int nValue = (nMicros > 0xFFFFFFFF) ? 0xFFFFFFFF : nMicros;
+        m_aBuckets[GetBucket(nValue)].fetch_add(1, std::memory_order_relaxed);
+        m_nCount.fetch_add(1, std::memory_order_relaxed);
+        unsigned int nMax = m_nMax.load(std::memory_order_relaxed);
+        while(nValue > nMax && !m_nMax.compare_exchange_weak(nMax, nValue, std::memory_order_relaxed))
+            ;
+    }
+
+    /**	Get a percentile
+    *	@param	fPercentile Percentile to get [0..100]
+    *	@retval	unsigned int Upper bound of bucket containing the percentile in microseconds (0 if no measurements)
+    */
+    unsigned int GetPercentile(float fPercentile)
+    {
+        unsigned int nCount = m_nCount.load(std::memory_order_relaxed);
+        if(!nCount)
+            return 0;
+        uint64_t nTarget = (uint64_t)(nCount * fPercentile / 100.0 + 0.5);
+        if(nTarget < 1)
+            nTarget = 1;
+        uint64_t nSum = 0;
+        for(unsigned int nBucket = 0; nBucket < LATENCY_BUCKETS; ++nBucket)
+        {
+            nSum += m_aBuckets[nBucket].load(std::memory_order_relaxed);
+            if(nSum >= nTarget)
+            {
+                unsigned int nUpper = (nBucket + 1 < LATENCY_BUCKETS) ? GetBucketFloor(nBucket + 1) - 1 : 0xFFFFFFFF;
+                unsigned int nMax = GetMax();
+                return (nUpper < nMax) ? nUpper : nMax;
+            }
+        }
+        return GetMax();
+    }
+
+    /**	Get the largest measurement
+    *	@retval	unsigned int Maximum duration in microseconds
+    */
+    unsigned int GetMax()
+    {
+        return m_nMax.load(std::memory_order_relaxed);
+    }
+
+    /**	Get the quantity of measurements
+    *	@retval	unsigned int Quantity of measurements since last reset
+    */
+    unsigned int GetCount()
+    {
+        return m_nCount.load(std::memory_order_relaxed);
+    }
+
+    /**	Clear all measurements */
+    void Reset()
+    {
+        for(unsigned int nBucket = 0; nBucket < LATENCY_BUCKETS; ++nBucket)
+            m_aBuckets[nBucket].store(0, std::memory_order_relaxed);
+        m_nCount.store(0, std::memory_order_relaxed);
+        m_nMax.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    /**	Get the index of the bucket for a value */
+    static unsigned int GetBucket(unsigned int nValue)
+    {
+        if(nValue < 4)
+            return nValue;
+        unsigned int nMsb = 31 - __builtin_clz(nValue);
+        return (nMsb - 1) * 4 + ((nValue >> (nMsb - 2)) & 3);
+    }
+
+    /**	Get the lowest value held by a bucket */
+    static unsigned int GetBucketFloor(unsigned int nBucket)
+    {
+        if(nBucket < 4)
+            return nBucket;
+        unsigned int nMsb = nBucket / 4 + 1;
+        return (4 + (nBucket & 3)) << (nMsb - 2);
+    }
+
+    std::atomic<unsigned int> m_aBuckets[LATENCY_BUCKETS]; // Quantity of measurements in each bucket
+    std::atomic<unsigned int> m_nCount; // Total quantity of measurements
+    std::atomic<unsigned int> m_nMax; // Largest measurement
+};
@@ -0,0 +1,242 @@
+/*	Audio level meters
+
+	Measures peak and RMS level of each MIDI channel and of the master output within the audio callback.
+	The synth renders each MIDI channel to its own stereo buffer pair (synth.audio-groups) which are measured and mixed to the output.
+	Levels are published through atomics so the UI can read them at its own rate without blocking the audio thread.
+	Peak and RMS are calculated with NEON on ARM, SSE2 on x86 and plain C++ elsewhere.
+*/
+
+#pragma once
+
+#include <algorithm> // provides std::max
+#include <atomic> // provides std::atomic
+#include <cmath> // provides sqrt, exp
+#include <cstdint> // provides uint64_t
+#include <cstring> // provides memset
+#include <vector> // provides std::vector
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h> // provides NEON intrinsics
+#define METER_KERNEL_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h> // provides SSE2 intrinsics
+#define METER_KERNEL_SSE2
+#endif
+
+#define METER_CHANNELS 16 // Quantity of metered MIDI channels
+#define METER_MASTER 16 // Index of master output meter
+#define METER_MIN_FRAMES 1024 // Minimum quantity of frames per block that can be metered
+#define METER_RMS_MS 300 // RMS release time constant in milliseconds
+#define METER_HOLD_MS 1500 // Duration peak hold is shown in milliseconds
+#define METER_CLIP_MS 2000 // Duration clip indication is shown after last clip in milliseconds
+
+/**	Measure a buffer and optionally mix it into another
+*	@param	pSrc Samples to measure
+*	@param	pDst Buffer to add samples to (NULL to only measure)
+*	@param	nFrames Quantity of samples
+*	@param	fPeak Updated with highest absolute sample
+*	@param	fSquares Sum of squared samples is added to this
+*/
+inline void meterMix(const float* pSrc, float* pDst, unsigned int nFrames, float& fPeak, float& fSquares)
+{
+    unsigned int nFrame = 0;
+#if defined(METER_KERNEL_NEON)
+    float32x4_t vPeak = vdupq_n_f32(0.0f);
+    float32x4_t vSquares = vdupq_n_f32(0.0f);
+    for(; nFrame + 4 <= nFrames; nFrame += 4)
+    {
+        float32x4_t vSample = vld1q_f32(pSrc + nFrame);
+        vPeak = vmaxq_f32(vPeak, vabsq_f32(vSample));
+        vSquares = vmlaq_f32(vSquares, vSample, vSample);
+        if(pDst)
+            vst1q_f32(pDst + nFrame, vaddq_f32(vld1q_f32(pDst + nFrame), vSample));
+    }
+    float afPeak[4], afSquares[4];
+    vst1q_f32(afPeak, vPeak);
+    vst1q_f32(afSquares, vSquares);
+#elif defined(METER_KERNEL_SSE2)
+    const __m128 vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vPeak = _mm_setzero_ps();
+    __m128 vSquares = _mm_setzero_ps();
+    for(; nFrame + 4 <= nFrames; nFrame += 4)
+    {
+        __m128 vSample = _mm_loadu_ps(pSrc + nFrame);
+        vPeak = _mm_max_ps(vPeak, _mm_and_ps(vSample, vAbsMask));
+        vSquares = _mm_add_ps(vSquares, _mm_mul_ps(vSample, vSample));
+        if(pDst)
+            _mm_storeu_ps(pDst + nFrame, _mm_add_ps(_mm_loadu_ps(pDst + nFrame), vSample));
+    }
+    float afPeak[4], afSquares[4];
+    _mm_storeu_ps(afPeak, vPeak);
+    _mm_storeu_ps(afSquares, vSquares);
+#else
+    float afPeak[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float afSquares[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+#endif
+    for(unsigned int nLane = 0; nLane < 4; ++nLane)
+    {
+        fPeak = std::max(fPeak, afPeak[nLane]);
+        fSquares += afSquares[nLane];
+    }
+    for(; nFrame < nFrames; ++nFrame)
+    {
+        float fSample = pSrc[nFrame];
+        fPeak = std::max(fPeak, std::fabs(fSample));
+        fSquares += fSample * fSample;
+        if(pDst)
+            pDst[nFrame] += fSample;
+    }
+}
+
+/**	Level of a meter as shown by the UI */
+struct MeterLevel
+{
+    float rms = 0.0f; // RMS level with slow release [0..1+]
+    float peak = 0.0f; // Highest peak since last read [0..1+]
+    float hold = 0.0f; // Peak hold level [0..1+]
+    bool clip = false; // True if output has clipped recently (master only)
+};
+
+/**	AudioMeters class measures per-channel and master levels in the audio thread for display by the UI */
+class AudioMeters
+{
+public:
+    AudioMeters()
+    {
+        for(unsigned int nMeter = 0; nMeter <= METER_MASTER; ++nMeter)
+        {
+            m_afRms[nMeter].store(0.0f, std::memory_order_relaxed);
+            m_afPeak[nMeter].store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    /**	Allocate channel buffers - call before audio starts
+    *	@param	nFrames Expected frames per audio block
+    *	@param	dSampleRate Sample rate in Hz
+    */
+    void Init(unsigned int nFrames, double dSampleRate)
+    {
+        m_nCapacity = std::max(nFrames, (unsigned int)METER_MIN_FRAMES);
+        m_vBuffer.assign(m_nCapacity * METER_CHANNELS * 2, 0.0f);
+        for(unsigned int nBuffer = 0; nBuffer < METER_CHANNELS * 2; ++nBuffer)
+            m_apBuffers[nBuffer] = m_vBuffer.data() + nBuffer * m_nCapacity;
+        m_dSampleRate = dSampleRate;
+        m_nReleaseFrames = 0;
+    }
+
+    /**	Get zeroed per-channel buffers to render a block into
+    *	@param	nFrames Quantity of frames in block
+    *	@retval	float** Array of METER_CHANNELS * 2 buffers (left, right for each MIDI channel) or NULL if block is too large
+    */
+    float** GetBuffers(unsigned int nFrames)
+    {
+        if(nFrames > m_nCapacity)
+            return NULL;
+        for(unsigned int nBuffer = 0; nBuffer < METER_CHANNELS * 2; ++nBuffer)
+            memset(m_apBuffers[nBuffer], 0, nFrames * sizeof(float));
+        return m_apBuffers;
+    }
+
+    /**	Measure per-channel buffers, mix them into output then measure output - call from audio thread after rendering into GetBuffers
+    *	@param	nFrames Quantity of frames in block
+    *	@param	pLeft Left output buffer
+    *	@param	pRight Right output buffer
+    */
+    void Process(unsigned int nFrames, float* pLeft, float* pRight)
+    {
+        if(!nFrames || nFrames > m_nCapacity)
+            return;
+        if(nFrames != m_nReleaseFrames)
+        {
+            m_fRelease = exp(-(double)nFrames / (m_dSampleRate * METER_RMS_MS / 1000));
+            m_nReleaseFrames = nFrames;
+        }
+        for(unsigned int nChannel = 0; nChannel < METER_CHANNELS; ++nChannel)
+        {
+            float fPeak = 0.0f, fSquares = 0.0f;
+            meterMix(m_apBuffers[nChannel * 2], pLeft, nFrames, fPeak, fSquares);
+            meterMix(m_apBuffers[nChannel * 2 + 1], pRight, nFrames, fPeak, fSquares);
+            Publish(nChannel, fPeak, fSquares, nFrames * 2);
+        }
+        float fPeak = 0.0f, fSquares = 0.0f;
+        meterMix(pLeft, NULL, nFrames, fPeak, fSquares);
+        meterMix(pRight, NULL, nFrames, fPeak, fSquares);
+        Publish(METER_MASTER, fPeak, fSquares, nFrames * 2);
+        if(fPeak >= 1.0f)
+            m_bClip.store(true, std::memory_order_relaxed);
+    }
+
+    /**	Measure output only - call from audio thread for blocks rendered without per-channel buffers
+    *	@param	nFrames Quantity of frames in block
+    *	@param	pLeft Left output buffer
+    *	@param	pRight Right output buffer
+    */
+    void ProcessMaster(unsigned int nFrames, float* pLeft, float* pRight)
+    {
+        float fPeak = 0.0f, fSquares = 0.0f;
+        meterMix(pLeft, NULL, nFrames, fPeak, fSquares);
+        meterMix(pRight, NULL, nFrames, fPeak, fSquares);
+        if(nFrames)
+            Publish(METER_MASTER, fPeak, fSquares, nFrames * 2);
+        if(fPeak >= 1.0f)
+            m_bClip.store(true, std::memory_order_relaxed);
+    }
+
+    /**	Read a meter, updating its peak hold - call from UI thread only
+    *	@param	nMeter Index of meter [0..METER_CHANNELS-1 for MIDI channels, METER_MASTER for output]
+    *	@param	nNow Current time in milliseconds
+    *	@retval	MeterLevel Level to display
+    */
+    MeterLevel Read(unsigned int nMeter, uint64_t nNow)
+    {
+        MeterLevel level;
+        if(nMeter > METER_MASTER)
+            return level;
+        level.rms = m_afRms[nMeter].load(std::memory_order_relaxed);
+        level.peak = m_afPeak[nMeter].exchange(0.0f, std::memory_order_relaxed);
+        if(level.peak >= m_afHold[nMeter] || nNow - m_anHoldTime[nMeter] > METER_HOLD_MS)
+        {
+            m_afHold[nMeter] = level.peak;
+            m_anHoldTime[nMeter] = nNow;
+        }
+        level.hold = m_afHold[nMeter];
+        if(nMeter == METER_MASTER)
+        {
+            if(m_bClip.exchange(false, std::memory_order_relaxed))
+                m_nClipTime = nNow;
+            level.clip = m_nClipTime && nNow - m_nClipTime < METER_CLIP_MS;
+        }
+        return level;
+    }
+
+private:
+    /**	Publish levels of a block
+    *	@param	nMeter Index of meter
+    *	@param	fPeak Highest absolute sample in block
+    *	@param	fSquares Sum of squared samples in block
+    *	@param	nSamples Quantity of samples in block
+    */
+    void Publish(unsigned int nMeter, float fPeak, float fSquares, unsigned int nSamples)
+    {
+        // RMS rises immediately and falls with release time constant
+        float fRms = sqrt(fSquares / nSamples);
+        float fDecayed = m_afRms[nMeter].load(std::memory_order_relaxed) * m_fRelease;
+        m_afRms[nMeter].store(std::max(fRms, fDecayed), std::memory_order_relaxed);
+        // Peak is highest since UI last read it
+        float fOld = m_afPeak[nMeter].load(std::memory_order_relaxed);
+        while(fPeak > fOld && !m_afPeak[nMeter].compare_exchange_weak(fOld, fPeak, std::memory_order_relaxed))
+            ;
+    }
+
+    std::vector<float> m_vBuffer; // Storage for per-channel buffers
+    float* m_apBuffers[METER_CHANNELS * 2] = {}; // Left and right buffer for each MIDI channel
+    unsigned int m_nCapacity = 0; // Maximum frames in each buffer
+    double m_dSampleRate = 44100.0; // Sample rate in Hz
+    unsigned int m_nReleaseFrames = 0; // Block size that m_fRelease was calculated for
+    float m_fRelease = 0.0f; // RMS decay factor per block
+    std::atomic<float> m_afRms[METER_MASTER + 1]; // RMS level of each meter (written by audio thread)
+    std::atomic<float> m_afPeak[METER_MASTER + 1]; // Highest peak of each meter since last read (reset by UI thread)
+    std::atomic<bool> m_bClip = {false}; // True if master has clipped since last read
+    float m_afHold[METER_MASTER + 1] = {}; // Peak hold level of each meter (UI thread)
+    uint64_t m_anHoldTime[METER_MASTER + 1] = {}; // Time peak hold was set in milliseconds (UI thread)
+    uint64_t m_nClipTime = 0; // Time of last clip in milliseconds (UI thread)
+};
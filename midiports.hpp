@@ -0,0 +1,185 @@
+/*	MIDI port hotplug
+
+	Connects every MIDI output port on the ALSA sequencer to the synth input port, including ports that appear after startup (e.g. USB MIDI devices plugged in whilst running).
+	Subscribes to the sequencer announce port so new ports are reported by ALSA as soon as they are created and may be connected immediately.
+*/
+
+#pragma once
+
+#include <alsa/asoundlib.h> // provides ALSA sequencer
+#include <poll.h> // provides pollfd
+#include <string> // provides std::string
+
+/**	MidiPorts class keeps MIDI inputs connected to the synth */
+class MidiPorts
+{
+public:
+    ~MidiPorts()
+    {
+        if(m_pSeq)
+            snd_seq_close(m_pSeq);
+    }
+
+    /**	Open sequencer and listen for new ports
+    *	@param	sTarget Name of sequencer client to connect ports to (synth MIDI driver)
+    *	@retval	bool True on success
+    */
+    bool Open(std::string sTarget)
+    {
+        m_sTarget = sTarget;
+        if(snd_seq_open(&m_pSeq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0)
+        {
+            m_pSeq = NULL;
+            return false;
+        }
+        snd_seq_set_client_name(m_pSeq, "fluidbox hotplug");
+        m_nClient = snd_seq_client_id(m_pSeq);
+        m_nPort = snd_seq_create_simple_port(m_pSeq, "announce", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT, SND_SEQ_PORT_TYPE_APPLICATION);
+        if(m_nPort < 0 || snd_seq_connect_from(m_pSeq, m_nPort, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0)
+        {
+            snd_seq_close(m_pSeq);
+            m_pSeq = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    /**	Get file descriptor that is readable when sequencer announcements are waiting (-1 if not open) */
+    int GetFd()
+    {
+        struct pollfd pfd;
+        if(!m_pSeq || snd_seq_poll_descriptors(m_pSeq, &pfd, 1, POLLIN) != 1)
+            return -1;
+        return pfd.fd;
+    }
+
+    /**	Connect all existing MIDI output ports to the synth
+    *	@retval	unsigned int Quantity of new connections
+    */
+    unsigned int ConnectAll()
+    {
+        if(!m_pSeq || !FindTarget())
+            return 0;
+        unsigned int nConnected = 0;
+        snd_seq_client_info_t* pClient;
+        snd_seq_port_info_t* pPort;
+        snd_seq_client_info_alloca(&pClient);
+        snd_seq_port_info_alloca(&pPort);
+        snd_seq_client_info_set_client(pClient, -1);
+        while(snd_seq_query_next_client(m_pSeq, pClient) >= 0)
+        {
+            int nClient = snd_seq_client_info_get_client(pClient);
+            snd_seq_port_info_set_client(pPort, nClient);
+            snd_seq_port_info_set_port(pPort, -1);
+            while(snd_seq_query_next_port(m_pSeq, pPort) >= 0)
+                if(Connect(nClient, snd_seq_port_info_get_port(pPort)))
+                    ++nConnected;
+        }
+        return nConnected;
+    }
+
+    /**	Handle sequencer announcements - call when file descriptor is readable
+    *	@retval	unsigned int Quantity of new connections
+    */
+    unsigned int Process()
+    {
+        unsigned int nConnected = 0;
+        snd_seq_event_t* pEvent;
+        while(m_pSeq && snd_seq_event_input(m_pSeq, &pEvent) >= 0)
+        {
+            if(pEvent->type != SND_SEQ_EVENT_PORT_START)
+                continue;
+            if(m_nTargetClient < 0 || pEvent->data.addr.client == m_nTargetClient)
+                nConnected += ConnectAll(); // Synth port (re)created
+            else if(Connect(pEvent->data.addr.client, pEvent->data.addr.port))
+                ++nConnected;
+        }
+        return nConnected;
+    }
+
+    /**	Get name of port most recently connected
+    *	@retval	string Client and port name
+    */
+    std::string GetLastConnected()
+    {
+        return m_sLastConnected;
+    }
+
+private:
+    /**	Find synth input port
+    *	@retval	bool True if found
+    */
+    bool FindTarget()
+    {
+        snd_seq_client_info_t* pClient;
+        snd_seq_port_info_t* pPort;
+        snd_seq_client_info_alloca(&pClient);
+        snd_seq_port_info_alloca(&pPort);
+        snd_seq_client_info_set_client(pClient, -1);
+        m_nTargetClient = -1;
+        while(snd_seq_query_next_client(m_pSeq, pClient) >= 0)
+        {
+            if(m_sTarget != snd_seq_client_info_get_name(pClient))
+                continue;
+            int nClient = snd_seq_client_info_get_client(pClient);
+            snd_seq_port_info_set_client(pPort, nClient);
+            snd_seq_port_info_set_port(pPort, -1);
+            while(snd_seq_query_next_port(m_pSeq, pPort) >= 0)
+            {
+                unsigned int nCaps = snd_seq_port_info_get_capability(pPort);
+                if((nCaps & (SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE)) == (SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE))
+                {
+                    m_nTargetClient = nClient;
+                    m_nTargetPort = snd_seq_port_info_get_port(pPort);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**	Connect a port to the synth if it is a MIDI output
+    *	@param	nClient Sequencer client of port
+    *	@param	nPort Port number
+    *	@retval	bool True if a new connection was made
+    */
+    bool Connect(int nClient, int nPort)
+    {
+        if(m_nTargetClient < 0 || nClient == m_nClient || nClient == m_nTargetClient || nClient == SND_SEQ_CLIENT_SYSTEM)
+            return false;
+        snd_seq_client_info_t* pClient;
+        snd_seq_port_info_t* pPort;
+        snd_seq_client_info_alloca(&pClient);
+        snd_seq_port_info_alloca(&pPort);
+        if(snd_seq_get_any_client_info(m_pSeq, nClient, pClient) < 0 || snd_seq_get_any_port_info(m_pSeq, nClient, nPort, pPort) < 0)
+            return false;
+        if(std::string(snd_seq_client_info_get_name(pClient)) == "Midi Through")
+            return false; // Avoid feedback loops
+        unsigned int nCaps = snd_seq_port_info_get_capability(pPort);
+        if((nCaps & (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) != (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ) || (nCaps & SND_SEQ_PORT_CAP_NO_EXPORT))
+            return false;
+        if(!(snd_seq_port_info_get_type(pPort) & SND_SEQ_PORT_TYPE_MIDI_GENERIC))
+            return false;
+        snd_seq_addr_t sender, dest;
+        sender.client = nClient;
+        sender.port = nPort;
+        dest.client = m_nTargetClient;
+        dest.port = m_nTargetPort;
+        snd_seq_port_subscribe_t* pSubscription;
+        snd_seq_port_subscribe_alloca(&pSubscription);
+        snd_seq_port_subscribe_set_sender(pSubscription, &sender);
+        snd_seq_port_subscribe_set_dest(pSubscription, &dest);
+        if(snd_seq_subscribe_port(m_pSeq, pSubscription) < 0)
+            return false; // Already connected (EBUSY) or not permitted
+        m_sLastConnected = std::string(snd_seq_client_info_get_name(pClient)) + ":" + snd_seq_port_info_get_name(pPort);
+        return true;
+    }
+
+    snd_seq_t* m_pSeq = NULL; // Sequencer handle
+    int m_nClient = -1; // Own client id
+    int m_nPort = -1; // Own port receiving announcements
+    std::string m_sTarget; // Name of synth sequencer client
+    int m_nTargetClient = -1; // Synth client id (-1 if not found)
+    int m_nTargetPort = -1; // Synth input port
+    std::string m_sLastConnected; // Name of port most recently connected
+};
@@ -0,0 +1,171 @@
+/*	Frame-rate capped display updates
+
+	Draw intents (e.g. "mixer channel 3 changed", "activity on channel 5") may be posted from any thread without blocking.
+	Intents are coalesced into a bitmask per intent type and drawn by the display owner (UI event loop) at most a configured quantity of frames per second.
+	Display bandwidth is therefore bounded by the frame rate rather than the rate at which intents are posted.
+*/
+
+#pragma once
+
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint32_t, uint64_t
+#include <functional> // provides std::function
+#include <time.h> // provides clock_gettime
+#include <unistd.h> // provides read, close
+#include <sys/timerfd.h> // provides timerfd
+
+#define RENDER_MAX_INTENTS 8 // Quantity of intent types supported
+#define RENDER_MAX_FPS 100 // Upper limit of frame rate
+
+/**	RenderQueue class coalesces draw intents into frame-rate capped frames */
+class RenderQueue
+{
+public:
+    /**	Instantiate render queue
+    *	@param	nFps Maximum frames per second
+    */
+    RenderQueue(unsigned int nFps = 25)
+    {
+        m_nFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        for(unsigned int nIntent = 0; nIntent < RENDER_MAX_INTENTS; ++nIntent)
+            m_anPending[nIntent].store(0, std::memory_order_relaxed);
+        SetRate(nFps);
+    }
+
+    ~RenderQueue()
+    {
+        if(m_nFd >= 0)
+            close(m_nFd);
+    }
+
+    /**	Set maximum frame rate
+    *	@param	nFps Frames per second [1..RENDER_MAX_FPS]
+    */
+    void SetRate(unsigned int nFps)
+    {
+        if(nFps < 1)
+            nFps = 1;
+        if(nFps > RENDER_MAX_FPS)
+            nFps = RENDER_MAX_FPS;
+        m_nFps = nFps;
+        m_nPeriod.store(1000000 / nFps, std::memory_order_relaxed);
+    }
+
+    /**	Get maximum frame rate
+    *	@retval	unsigned int Frames per second
+    */
+    unsigned int GetRate()
+    {
+        return m_nFps;
+    }
+
+    /**	Set function that draws an intent type
+    *	@param	nIntent Intent type [0..RENDER_MAX_INTENTS-1]
+    *	@param	fnHandler Function called with bitmask of items (e.g. channels) posted since last frame
+    *	@note	Handlers are called in ascending intent order so a handler may post higher intents to be drawn in the same frame
+    */
+    void SetHandler(unsigned int nIntent, std::function<void(uint32_t)> fnHandler)
+    {
+        if(nIntent < RENDER_MAX_INTENTS)
+            m_afnHandlers[nIntent] = fnHandler;
+    }
+
+    /**	Request an item to be drawn in the next frame - may be called from any thread, does not block
+    *	@param	nIntent Intent type [0..RENDER_MAX_INTENTS-1]
+    *	@param	nItem Item within intent, e.g. MIDI channel [0..31]
+    */
+    void Post(unsigned int nIntent, unsigned int nItem = 0)
+    {
+        if(nIntent >= RENDER_MAX_INTENTS || nItem > 31)
+            return;
+        m_anPending[nIntent].fetch_or(1u << nItem, std::memory_order_release);
+        m_nPosted.fetch_add(1, std::memory_order_relaxed);
+        Schedule();
+    }
+
+    /**	Draw a frame of all pending intents - call from display owner when file descriptor is readable */
+    void Render()
+    {
+        uint64_t nExpiries;
+        if(read(m_nFd, &nExpiries, sizeof(nExpiries)) != sizeof(nExpiries))
+            nExpiries = 0;
+        m_nLastFrame.store(getTime(), std::memory_order_relaxed);
+        for(unsigned int nIntent = 0; nIntent < RENDER_MAX_INTENTS; ++nIntent)
+        {
+            uint32_t nMask = m_anPending[nIntent].exchange(0, std::memory_order_acquire);
+            if(nMask && m_afnHandlers[nIntent])
+                m_afnHandlers[nIntent](nMask);
+        }
+        ++m_nFrames;
+        m_bScheduled.store(false, std::memory_order_release);
+        // Intents posted by other threads whilst rendering did not schedule a frame
+        for(unsigned int nIntent = 0; nIntent < RENDER_MAX_INTENTS; ++nIntent)
+        {
+            if(m_anPending[nIntent].load(std::memory_order_acquire))
+            {
+                Schedule();
+                break;
+            }
+        }
+    }
+
+    /**	Get file descriptor that becomes readable when a frame is due */
+    int GetFd()
+    {
+        return m_nFd;
+    }
+
+    /**	Get quantity of frames drawn */
+    unsigned int GetFrames()
+    {
+        return m_nFrames;
+    }
+
+    /**	Get quantity of intents posted */
+    unsigned int GetPosted()
+    {
+        return m_nPosted.load(std::memory_order_relaxed);
+    }
+
+    /**	Reset frame and intent counters */
+    void ResetStats()
+    {
+        m_nFrames = 0;
+        m_nPosted.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    /**	Arm timer for next frame unless already scheduled */
+    void Schedule()
+    {
+        if(m_bScheduled.exchange(true, std::memory_order_acq_rel))
+            return;
+        uint64_t nNow = getTime();
+        uint64_t nDue = m_nLastFrame.load(std::memory_order_relaxed) + m_nPeriod.load(std::memory_order_relaxed);
+        uint64_t nDelay = (nDue > nNow) ? nDue - nNow : 0;
+        struct itimerspec spec = {};
+        spec.it_value.tv_sec = nDelay / 1000000;
+        spec.it_value.tv_nsec = (nDelay % 1000000) * 1000;
+        if(!nDelay)
+            spec.it_value.tv_nsec = 1; // Zero would disarm
+        timerfd_settime(m_nFd, 0, &spec, NULL);
+    }
+
+    /**	Get monotonic time in microseconds */
+    static uint64_t getTime()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    int m_nFd = -1; // timerfd file descriptor armed when a frame is due
+    unsigned int m_nFps = 25; // Maximum frames per second
+    std::atomic<uint64_t> m_nPeriod = {40000}; // Minimum time between frames in us
+    std::atomic<uint64_t> m_nLastFrame = {0}; // Time of last frame in us
+    std::atomic<bool> m_bScheduled = {false}; // True whilst timer is armed for a frame
+    std::atomic<uint32_t> m_anPending[RENDER_MAX_INTENTS]; // Bitmask of pending items for each intent type
+    std::function<void(uint32_t)> m_afnHandlers[RENDER_MAX_INTENTS]; // Function to draw each intent type
+    unsigned int m_nFrames = 0; // Quantity of frames drawn
+    std::atomic<unsigned int> m_nPosted = {0}; // Quantity of intents posted
+};
@@ -0,0 +1,157 @@
+/*	Lock-free ring buffers
+
+	Used to pass small records between realtime threads (e.g. fluidsynth MIDI and audio drivers) and the UI thread without locks or allocation.
+	RingBuffer has a single producer and single consumer. MpscRingBuffer allows several producers and a single consumer.
+*/
+
+#pragma once
+
+#include <atomic> // provides std::atomic
+
+/**	RingBuffer class implements a bounded SPSC queue of fixed size records
+*	@param	T Type of record (should be small and trivially copyable)
+*	@param	SIZE Quantity of slots (must be a power of 2) - one slot is always kept free
+*/
+template <typename T, unsigned int SIZE>
+class RingBuffer
+{
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "RingBuffer size must be a power of 2");
+
+public:
+    /**	Add a record to the queue - call only from the producer thread
+    *	@param	record Record to add
+    *	@retval	bool True on success, false if queue is full (record is dropped)
+    */
+    bool Push(const T& record)
+    {
+        unsigned int nHead = m_nHead.load(std::memory_order_relaxed);
+        unsigned int nNext = (nHead + 1) & (SIZE - 1);
+        if(nNext == m_nTail.load(std::memory_order_acquire))
+        {
+            m_nDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_aRecords[nHead] = record;
+        m_nHead.store(nNext, std::memory_order_release);
+        return true;
+    }
+
+    /**	Remove the oldest record from the queue - call only from the consumer thread
+    *	@param	record Reference to record to populate
+    *	@retval	bool True if a record was removed, false if queue is empty
+    */
+    bool Pop(T& record)
+    {
+        unsigned int nTail = m_nTail.load(std::memory_order_relaxed);
+        if(nTail == m_nHead.load(std::memory_order_acquire))
+            return false;
+        record = m_aRecords[nTail];
+        m_nTail.store((nTail + 1) & (SIZE - 1), std::memory_order_release);
+        return true;
+    }
+
+    /**	Check if queue is empty
+    *	@retval	bool True if there are no records in the queue
+    */
+    bool IsEmpty()
+    {
+        return m_nTail.load(std::memory_order_acquire) == m_nHead.load(std::memory_order_acquire);
+    }
+
+    /**	Get and reset the quantity of records dropped due to queue being full
+    *	@retval	unsigned int Quantity of dropped records since last call
+    */
+    unsigned int GetDropped()
+    {
+        return m_nDropped.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    T m_aRecords[SIZE]; // Record storage
+    std::atomic<unsigned int> m_nHead = {0}; // Index of next slot to write (owned by producer)
+    std::atomic<unsigned int> m_nTail = {0}; // Index of next slot to read (owned by consumer)
+    std::atomic<unsigned int> m_nDropped = {0}; // Quantity of records dropped since last check
+};
+
+/**	MpscRingBuffer class implements a bounded multiple producer, single consumer queue of fixed size records
+*	@param	T Type of record (should be small and trivially copyable)
+*	@param	SIZE Quantity of slots (must be a power of 2)
+*	@note	Each slot carries a sequence number so producers can claim slots without locks (after Vyukov)
+*/
+template <typename T, unsigned int SIZE>
+class MpscRingBuffer
+{
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "MpscRingBuffer size must be a power of 2");
+
+public:
+    MpscRingBuffer()
+    {
+        for(unsigned int nSlot = 0; nSlot < SIZE; ++nSlot)
+            m_aSlots[nSlot].sequence.store(nSlot, std::memory_order_relaxed);
+    }
+
+    /**	Add a record to the queue - may be called from any thread
+    *	@param	record Record to add
+    *	@retval	bool True on success, false if queue is full (record is dropped)
+    */
+    bool Push(const T& record)
+    {
+        unsigned int nPos = m_nHead.load(std::memory_order_relaxed);
+        Slot* pSlot;
+        while(true)
+        {
+            pSlot = &m_aSlots[nPos & (SIZE - 1)];
+            int nDiff = (int)(pSlot->sequence.load(std::memory_order_acquire) - nPos);
+            if(nDiff == 0)
+            {
+                if(m_nHead.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(nDiff < 0)
+            {
+                m_nDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+                nPos = m_nHead.load(std::memory_order_relaxed);
+        }
+        pSlot->record = record;
+        pSlot->sequence.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**	Remove the oldest record from the queue - call only from the consumer thread
+    *	@param	record Reference to record to populate
+    *	@retval	bool True if a record was removed, false if queue is empty
+    */
+    bool Pop(T& record)
+    {
+        Slot* pSlot = &m_aSlots[m_nTail & (SIZE - 1)];
+        if((int)(pSlot->sequence.load(std::memory_order_acquire) - (m_nTail + 1)) < 0)
+            return false;
+        record = pSlot->record;
+        pSlot->sequence.store(m_nTail + SIZE, std::memory_order_release);
+        ++m_nTail;
+        return true;
+    }
+
+    /**	Get and reset the quantity of records dropped due to queue being full
+    *	@retval	unsigned int Quantity of dropped records since last call
+    */
+    unsigned int GetDropped()
+    {
+        return m_nDropped.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<unsigned int> sequence; // Position this slot is ready to be written (== pos) or read (== pos + 1)
+        T record; // Record storage
+    };
+
+    Slot m_aSlots[SIZE]; // Record storage
+    std::atomic<unsigned int> m_nHead = {0}; // Position of next slot to claim (shared by producers)
+    unsigned int m_nTail = 0; // Position of next slot to read (owned by consumer)
+    std::atomic<unsigned int> m_nDropped = {0}; // Quantity of records dropped since last check
+};
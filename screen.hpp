@@ -1,10 +1,12 @@
 /*	Classes implementing screen views
 */
 
-#include "ribanfblib/ribanfblib.h"
+#include "fbscreen.hpp"
 
 using namespace std;
 
+#define LIST_ROWS 7 // Quantity of list entries displayed below title
+
 
 // An entry in a list screen
 struct ListEntry
@@ -15,6 +17,25 @@ struct ListEntry
     bool enabled = true;
 };
 
+// Source of list entries for lists that are not held by ListScreen, e.g. presets of a soundfont
+// Only the entries being displayed are requested so time and memory do not depend on length of list
+struct ListSource
+{
+    std::function<unsigned int()> count = NULL; // Function returning quantity of entries
+    std::function<string(unsigned int)> text = NULL; // Function returning text of an entry
+    std::function<bool(unsigned int)> enabled = NULL; // Function returning true if entry may be selected - Default: all enabled
+    std::function<void(unsigned int)> select = NULL; // Function to call on selection of an entry - Default: none
+};
+
+// Content of a displayed list row - used to detect which rows need redrawing
+struct ListRow
+{
+    string title; // Text displayed (empty for blank row)
+    uint32_t colour = 0; // Text colour
+    bool highlight = false; // True if row is drawn with selection highlight
+    bool valid = true; // False if row has been partially overdrawn
+};
+
 struct Style
 {
     uint32_t canvas = BLACK;
@@ -30,11 +51,11 @@ class ListScreen
 {
 public:
     /**	Instantiate a Screen object
-    *	@param	pScreen Pointer to a riban frame buffer object
+    *	@param	pScreen Pointer to a riban frame buffer object with glyph cache
     *	@param	sTitle	Title to display at top of screen
     *	@param	nParent Index of parent screen
     */
-    ListScreen(ribanfblib* pScreen, string sTitle, unsigned int nParent, Style* pStyle) :
+    ListScreen(FbScreen* pScreen, string sTitle, unsigned int nParent, Style* pStyle) :
         m_pScreen(pScreen),
         m_sTitle(sTitle),
         m_nParent(nParent),
@@ -42,12 +63,6 @@ public:
     {
     }
 
-    ~ListScreen()
-    {
-        for(auto it = m_vEntries.begin(); it != m_vEntries.end(); ++it)
-            delete *it;
-    }
-
     /** Set id of the parent screen
     *   @param nScreen ID of parent screen
     */
@@ -77,10 +92,20 @@ public:
     */
     void SetSelection(int nSelection)
     {
-        if(nSelection < m_vEntries.size())
+        if(nSelection < (int)GetEntryCount())
             m_nSelection = nSelection;
         else
-            m_nSelection = m_vEntries.size() - 1;
+            m_nSelection = GetEntryCount() - 1;
+    }
+
+    /** Get quantity of entries in list
+    *   @retval unsigned int Quantity of entries
+    */
+    unsigned int GetEntryCount()
+    {
+        if(m_source.count)
+            return m_source.count();
+        return m_vEntries.size();
     }
 
     /** Get id of the list entry shown at top of screen (first displayed entry of possibly scrolled list)
@@ -91,37 +116,71 @@ public:
         return m_nFirstEntry;
     }
 
-    /**	Display the screen */
+    /**	Display the whole screen, e.g. when changing to this screen or after other drawing has overwritten it */
     virtual void Draw()
     {
-        m_pScreen->Clear(m_pStyle->canvas);
-        m_pScreen->DrawRect(0,0, 160,16, m_pStyle->title_background, 0, m_pStyle->title_background);
-        m_pScreen->DrawText(m_sTitle, 5, 13, m_pStyle->title_text);
-        if(!m_vEntries.size())
-            return;
-        if(m_nSelection >= m_vEntries.size())
-            m_nSelection = m_vEntries.size() - 1;
+        Invalidate();
+        Update();
+    }
 
-        if(m_nSelection < m_nFirstEntry)
-            m_nFirstEntry = m_nSelection;
-        if(m_nSelection > m_nFirstEntry + 6)
-            m_nFirstEntry = m_nSelection - 6;
-        int nY = (1 + m_nSelection - m_nFirstEntry) * 16;
-        // Draw highlight
-        if(m_nSelection > -1)
-        {
-            m_pScreen->DrawRect(2,nY, 160,nY+15, m_pStyle->select_background, 0, m_pStyle->select_background);
-        }
-        // Draw entries
-        for(unsigned int nRow = 0; nRow < 7; ++nRow)
+    /**	Discard record of what is displayed so that next Update redraws the whole screen */
+    void Invalidate()
+    {
+        m_bClear = true;
+    }
+
+    /**	Redraw only the title and rows that differ from what is displayed
+    *	@note	Assumes nothing else has drawn over the screen since last Draw / Update
+    */
+    void Update()
+    {
+        if(m_bClear)
         {
-            if(nRow + m_nFirstEntry > m_vEntries.size() - 1)
-                return; // Reached end of list
-            if(m_vEntries[nRow + m_nFirstEntry]->enabled)
-                m_pScreen->DrawText(m_vEntries[nRow + m_nFirstEntry]->title, 2, 16*(nRow+2) - 2, m_pStyle->entry_text);
-            else
-                m_pScreen->DrawText(m_vEntries[nRow + m_nFirstEntry]->title, 2, 16*(nRow+2) - 2, m_pStyle->disabled_text);
+            m_pScreen->Clear(m_pStyle->canvas);
+            for(unsigned int nRow = 0; nRow < LIST_ROWS; ++nRow)
+                m_aRows[nRow] = ListRow();
+            m_sDrawnTitle.clear();
+            m_bTitleValid = false;
+            m_bClear = false;
         }
+        if(!m_bTitleValid || m_sDrawnTitle != m_sTitle)
+            DrawTitle();
+        if(m_nSelection >= (int)GetEntryCount())
+            m_nSelection = GetEntryCount() - 1;
+
+        if(m_nSelection >= 0 && m_nSelection < (int)m_nFirstEntry)
+            m_nFirstEntry = m_nSelection;
+        if(m_nSelection > (int)(m_nFirstEntry + LIST_ROWS - 1))
+            m_nFirstEntry = m_nSelection - (LIST_ROWS - 1);
+        // Draw rows that have changed
+        unsigned int nCount = GetEntryCount();
+        for(unsigned int nRow = 0; nRow < LIST_ROWS; ++nRow)
+            UpdateRow(nRow, nCount);
+    }
+
+    /**	Redraw a single entry if it is displayed and has changed, e.g. after its text has changed
+    *	@param	nEntry Index of entry
+    *	@note	Also redraws title if it has changed. Does not scroll or change selection. Only call whilst this screen is displayed.
+    */
+    void UpdateEntry(unsigned int nEntry)
+    {
+        if(m_bClear)
+            return; // Not yet drawn - next Update draws everything
+        if(!m_bTitleValid || m_sDrawnTitle != m_sTitle)
+            DrawTitle();
+        if(nEntry >= m_nFirstEntry && nEntry < m_nFirstEntry + LIST_ROWS)
+            UpdateRow(nEntry - m_nFirstEntry, GetEntryCount());
+    }
+
+    /** Get entries from a source instead of entries added to this list
+    *   @param source Source of entries (source with no count function to use added entries)
+    *   @note Entries are requested from source each time they are drawn so the source may change without notifying the list. Call Update or UpdateEntry to show changes.
+    */
+    void SetSource(ListSource source)
+    {
+        m_source = source;
+        if(m_nSelection < 0 && GetEntryCount())
+            m_nSelection = 0;
     }
 
     /** Add an entry to the list
@@ -133,11 +192,11 @@ public:
     */
     int Add(string sTitle, std::function<void(int)> pFunction = NULL, int nParam=0)
     {
-        ListEntry* pEntry = new ListEntry;
-        pEntry->title = sTitle;
-        pEntry->function = pFunction;
-        pEntry->param = nParam;
-        m_vEntries.push_back(pEntry);
+        m_vEntries.emplace_back();
+        ListEntry& entry = m_vEntries.back();
+        entry.title = sTitle;
+        entry.function = pFunction;
+        entry.param = nParam;
         if(m_nSelection < 1)
             m_nSelection = 0;
         return m_vEntries.size() - 1;
@@ -150,20 +209,13 @@ public:
     {
         if(nIndex >= m_vEntries.size())
             return;
-        auto it = m_vEntries.begin();
-        for(unsigned i = 0; i < nIndex; ++i)
-            ++it;
-        if(it == m_vEntries.end())
-            return;
-        m_vEntries.erase(it);
-        if(m_nSelection >= nIndex)
+        m_vEntries.erase(m_vEntries.begin() + nIndex);
+        if(m_nSelection >= (int)nIndex)
             --m_nSelection;
     }
 
     void ClearList()
     {
-        for(auto it = m_vEntries.begin(); it != m_vEntries.end(); ++it)
-            delete *it;
         m_vEntries.clear();
     }
 
@@ -172,12 +224,19 @@ public:
     */
     bool Select()
     {
-        if(m_nSelection >= 0 && m_nSelection < m_vEntries.size() && m_vEntries[m_nSelection]->enabled && m_vEntries[m_nSelection]->function)
+        if(m_nSelection < 0 || m_nSelection >= (int)GetEntryCount() || !IsEnabled(m_nSelection))
+            return false;
+        if(m_source.count)
         {
-            m_vEntries[m_nSelection]->function(m_vEntries[m_nSelection]->param);
+            if(!m_source.select)
+                return false;
+            m_source.select(m_nSelection);
             return true;
         }
-        return false;
+        if(!m_vEntries[m_nSelection].function)
+            return false;
+        m_vEntries[m_nSelection].function(m_vEntries[m_nSelection].param);
+        return true;
     };
 
     /**  Select the next entry (with respect to the currently selected entry)
@@ -185,15 +244,16 @@ public:
     */
     void Next()
     {
-        for(int nIndex = m_nSelection + 1; nIndex < m_vEntries.size(); ++nIndex)
+        unsigned int nCount = GetEntryCount();
+        for(int nIndex = m_nSelection + 1; nIndex < (int)nCount; ++nIndex)
         {
-            if(m_vEntries[nIndex]->enabled)
+            if(IsEnabled(nIndex))
             {
                 m_nSelection = nIndex;
                 break;
             }
         }
-        Draw();
+        Update();
     };
 
     /** Select the previous entry (with respect to the currently selected entry)
@@ -203,13 +263,13 @@ public:
     {
         for(int nIndex = m_nSelection - 1; nIndex >= 0; --nIndex)
         {
-            if(m_vEntries[nIndex]->enabled)
+            if(IsEnabled(nIndex))
             {
                 m_nSelection = nIndex;
                 break;
             }
         }
-        Draw();
+        Update();
     };
 
     /** Enable or disable a list entry
@@ -218,14 +278,10 @@ public:
     */
     void Enable(unsigned int nEntry, bool bEnable = true)
     {
-        auto it = m_vEntries.begin();
-        unsigned int nIndex = 0;
-        for(nIndex = 0; nIndex < nEntry; ++nIndex)
-            ++it;
-        if(it == m_vEntries.end())
+        if(nEntry >= m_vEntries.size())
             return;
-        (*it)->enabled = bEnable;
-        if(m_nSelection == nIndex)
+        m_vEntries[nEntry].enabled = bEnable;
+        if(!bEnable && m_nSelection == (int)nEntry)
             --m_nSelection;
     }
 
@@ -237,7 +293,7 @@ public:
     {
         if(nEntry >= m_vEntries.size())
             return;
-        m_vEntries[nEntry]->title = sText;
+        m_vEntries[nEntry].title = sText;
     }
 
     /** Get the text of a list entry
@@ -246,9 +302,11 @@ public:
     */
     string GetEntryText(unsigned int nEntry)
     {
-        if(nEntry < m_vEntries.size())
-            return m_vEntries[nEntry]->title;
-        return "";
+        if(nEntry >= GetEntryCount())
+            return "";
+        if(m_source.count)
+            return m_source.text ? m_source.text(nEntry) : "";
+        return m_vEntries[nEntry].title;
     }
 
     /** Get the text of the currently selected list entry
@@ -275,22 +333,81 @@ public:
     {
         m_sTitle = sTitle;
         if(bRefresh)
+            DrawTitle();
+    }
+
+
+protected:
+    /**	Check if an entry may be selected
+    *	@param	nEntry Index of entry (must be less than GetEntryCount)
+    *	@retval	bool True if enabled
+    */
+    bool IsEnabled(unsigned int nEntry)
+    {
+        if(m_source.count)
+            return !m_source.enabled || m_source.enabled(nEntry);
+        return m_vEntries[nEntry].enabled;
+    }
+
+    /**	Redraw a row if its content differs from what is displayed
+    *	@param	nRow Index of row on screen [0..LIST_ROWS-1]
+    *	@param	nCount Quantity of entries in list
+    */
+    void UpdateRow(unsigned int nRow, unsigned int nCount)
+    {
+        ListRow row;
+        unsigned int nEntry = nRow + m_nFirstEntry;
+        if(nEntry < nCount)
         {
-            m_pScreen->DrawRect(0,0, 160,16, m_pStyle->title_background, 0, m_pStyle->title_background);
-            m_pScreen->DrawText(m_sTitle, 5, 13, m_pStyle->title_text);
+            row.title = GetEntryText(nEntry);
+            row.colour = IsEnabled(nEntry) ? m_pStyle->entry_text : m_pStyle->disabled_text;
+            row.highlight = ((int)nEntry == m_nSelection);
         }
+        if(!m_aRows[nRow].valid || row.title != m_aRows[nRow].title || row.colour != m_aRows[nRow].colour || row.highlight != m_aRows[nRow].highlight)
+            DrawRow(nRow, row);
     }
 
+    /**	Draw title bar */
+    void DrawTitle()
+    {
+        m_pScreen->DrawRect(0,0, 160,16, m_pStyle->title_background, 0, m_pStyle->title_background);
+        m_pScreen->DrawText(m_sTitle, 5, 13, m_pStyle->title_text);
+        m_sDrawnTitle = m_sTitle;
+        m_bTitleValid = true;
+        if(m_aRows[0].highlight)
+            m_aRows[0].valid = false; // Title bar overlaps top of first row's highlight
+    }
 
-protected:
-    ribanfblib* m_pScreen;
+    /**	Draw a row of the list
+    *	@param	nRow Index of row on screen [0..LIST_ROWS-1]
+    *	@param	row Content of row
+    */
+    void DrawRow(unsigned int nRow, const ListRow& row)
+    {
+        int nY = (1 + nRow) * 16;
+        // Top line of first row is drawn by title bar unless highlighted
+        if(!m_aRows[nRow].title.empty() || m_aRows[nRow].highlight)
+            m_pScreen->DrawRect(0,nY + (nRow ? 0 : 1), 160,nY+15, m_pStyle->canvas, 0, m_pStyle->canvas);
+        if(row.highlight)
+            m_pScreen->DrawRect(2,nY, 160,nY+15, m_pStyle->select_background, 0, m_pStyle->select_background);
+        if(!row.title.empty())
+            m_pScreen->DrawText(row.title, 2, 16*(nRow+2) - 2, row.colour);
+        m_aRows[nRow] = row;
+    }
+
+    FbScreen* m_pScreen;
     string m_sTitle;
     Style* m_pStyle;
 
     unsigned int m_nPreviousScreen = 0;
     unsigned int m_nParent = 0;
     int m_nSelection = -1; // Index of selected item
-    std::vector<ListEntry*> m_vEntries; // List of entries
+    std::vector<ListEntry> m_vEntries; // List of entries added to this list
+    ListSource m_source; // Source of entries (used instead of m_vEntries if it has a count function)
     unsigned int m_nFirstEntry = 0; // Index of first item to display
+    ListRow m_aRows[LIST_ROWS]; // Content of each row as currently displayed
+    string m_sDrawnTitle; // Title as currently displayed
+    bool m_bTitleValid = false; // True if title bar is displayed
+    bool m_bClear = true; // True to clear screen and redraw everything on next Update
 };
 
@@ -0,0 +1,169 @@
+/*	Soundfont slimming tool - riban 2020 <brian@riban.co.uk>
+
+	Reads the fluidbox configuration, collects the bank:program of every channel of every preset for each soundfont and writes slimmed copies of the soundfonts containing only those presets, their instruments and samples.
+	fluidbox loads a slimmed copy in place of its soundfont whilst the copy is newer than the soundfont and contains all the programs a preset uses.
+	Reports the reduction in file size and the time fluidsynth takes to load each soundfont and its slimmed copy.
+	Run from the fluidbox directory (containing sf2/). Rerun after editing presets to include newly selected programs.
+	Usage: sf2slim [config]
+*/
+
+#include "sfslim.hpp"
+#include "fluidsynth.h"
+#include <cstdio> // provides printf
+#include <cstdlib> // provides atoi
+#include <fstream> // provides ifstream
+#include <iostream> // provides cout
+#include <map> // provides std::map
+#include <set> // provides std::set
+#include <string> // provides std::string
+#include <sys/stat.h> // provides mkdir
+#include <time.h> // provides clock_gettime
+
+using namespace std;
+
+#define SF_ROOT "sf2/" // Directory holding soundfonts (as fluidbox)
+#define DEFAULT_SOUNDFONT "default/TimGM6mb.sf2" // Soundfont of presets without soundfont parameter (as fluidbox)
+
+/**	Get monotonic time in ms */
+double getMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**	Get path of soundfont relative to sf2 directory
+*	@param	sFilename Filename as stored in preset (prefix '~' for default soundfonts)
+*/
+string getRelativePath(string sFilename)
+{
+    if(sFilename[0] == '~')
+        return "default/" + sFilename.substr(1);
+    return sFilename;
+}
+
+/**	Read programs used by each soundfont from configuration
+*	@param	sConfig Path to configuration file
+*	@param	mapPrograms Map of sets of programs, each (bank << 7) + program, indexed by soundfont filename
+*	@retval	bool True on success
+*/
+bool readConfig(string sConfig, map<string, set<uint32_t>>& mapPrograms)
+{
+    ifstream fileConfig(sConfig);
+    if(!fileConfig.is_open())
+        return false;
+    string sLine, sGroup, sSoundfont;
+    uint32_t anPrograms[16];
+    auto addPreset = [&]() {
+        if(sGroup == "preset")
+            mapPrograms[sSoundfont].insert(anPrograms, anPrograms + 16);
+    };
+    while(getline(fileConfig, sLine))
+    {
+        size_t nStart = sLine.find_first_not_of(" \t");
+        if(nStart == string::npos || sLine[nStart] == '#')
+            continue;
+        sLine = sLine.substr(nStart, sLine.find_last_not_of(" \t\r") - nStart + 1);
+        if(sLine[0] == '[')
+        {
+            addPreset();
+            sGroup = sLine.substr(1, sLine.find_first_of(']') - 1);
+            if(sGroup.substr(0, 6) == "preset")
+                sGroup = "preset";
+            sSoundfont = DEFAULT_SOUNDFONT;
+            for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+                anPrograms[nChannel] = 0; // Bank 0, program 0 as fluidbox default
+            continue;
+        }
+        size_t nDelim = sLine.find_first_of('=');
+        if(sGroup != "preset" || nDelim == string::npos)
+            continue;
+        string sParam = sLine.substr(0, nDelim);
+        string sValue = sLine.substr(nDelim + 1);
+        if(sParam == "soundfont")
+            sSoundfont = sValue;
+        else if(sParam.substr(0, 5) == "prog_")
+        {
+            unsigned int nChannel = atoi(sParam.substr(5).c_str());
+            size_t nColon = sValue.find_first_of(':');
+            if(nChannel < 16 && nColon != string::npos)
+                anPrograms[nChannel] = (atoi(sValue.substr(0, nColon).c_str()) << 7) + atoi(sValue.substr(nColon + 1).c_str());
+        }
+    }
+    addPreset();
+    return true;
+}
+
+/**	Measure time fluidsynth takes to load a soundfont
+*	@param	sPath Path to soundfont
+*	@retval	double Load time in ms or -1 on failure
+*/
+double timeLoad(string sPath)
+{
+    fluid_settings_t* pSettings = new_fluid_settings();
+    fluid_settings_setint(pSettings, "synth.polyphony", 1);
+    fluid_settings_setint(pSettings, "synth.chorus.active", 0);
+    fluid_settings_setint(pSettings, "synth.reverb.active", 0);
+    fluid_synth_t* pSynth = new_fluid_synth(pSettings);
+    double dStart = getMillis();
+    int nId = fluid_synth_sfload(pSynth, sPath.c_str(), 0);
+    double dDuration = getMillis() - dStart;
+    delete_fluid_synth(pSynth);
+    delete_fluid_settings(pSettings);
+    return (nId == FLUID_FAILED) ? -1 : dDuration;
+}
+
+int main(int argc, char** argv)
+{
+    string sConfig = (argc > 1) ? argv[1] : "fluidbox.config";
+    map<string, set<uint32_t>> mapPrograms;
+    if(!readConfig(sConfig, mapPrograms))
+    {
+        cerr << "Failed to open configuration " << sConfig << endl;
+        return 1;
+    }
+    mkdir(SF_SLIM_ROOT, 0755);
+    mkdir(SF_SLIM_ROOT "default", 0755);
+    fluid_set_log_function(FLUID_WARN, NULL, NULL); // Missing samples etc. are reported by fluidbox
+
+    SoundfontSlimmer slimmer;
+    size_t nTotal = 0, nTotalSlim = 0;
+    double dTotalLoad = 0, dTotalSlimLoad = 0;
+    int nResult = 0;
+    for(auto it = mapPrograms.begin(); it != mapPrograms.end(); ++it)
+    {
+        string sRelative = getRelativePath(it->first);
+        string sPath = SF_ROOT + sRelative;
+        string sSlimPath = SoundfontSlimmer::GetSlimPath(sRelative);
+        if(!slimmer.Slim(sPath, sSlimPath, it->second))
+        {
+            cerr << it->first << ": " << slimmer.GetError() << endl;
+            remove(sSlimPath.c_str()); // Do not leave an outdated slimmed copy
+            nResult = 1;
+            continue;
+        }
+        const SlimStats& stats = slimmer.GetStats();
+        double dLoad = timeLoad(sPath);
+        double dSlimLoad = timeLoad(sSlimPath);
+        printf("%s\n", it->first.c_str());
+        printf("  presets %u -> %u, instruments %u -> %u, samples %u -> %u\n",
+            stats.presets, stats.slimPresets, stats.instruments, stats.slimInstruments, stats.samples, stats.slimSamples);
+        printf("  size %.1fMB -> %.1fMB (%.0f%% smaller)\n",
+            stats.size / 1048576.0, stats.slimSize / 1048576.0, stats.size ? 100.0 - stats.slimSize * 100.0 / stats.size : 0.0);
+        if(dLoad < 0 || dSlimLoad < 0)
+        {
+            cerr << "  fluidsynth failed to load " << (dSlimLoad < 0 ? sSlimPath : sPath) << endl;
+            if(dSlimLoad < 0)
+                remove(sSlimPath.c_str());
+            nResult = 1;
+            continue;
+        }
+        printf("  load %.0fms -> %.0fms\n", dLoad, dSlimLoad);
+        nTotal += stats.size;
+        nTotalSlim += stats.slimSize;
+        dTotalLoad += dLoad;
+        dTotalSlimLoad += dSlimLoad;
+    }
+    printf("Total size %.1fMB -> %.1fMB, load %.0fms -> %.0fms\n", nTotal / 1048576.0, nTotalSlim / 1048576.0, dTotalLoad, dTotalSlimLoad);
+    return nResult;
+}
@@ -0,0 +1,209 @@
+/*	Soundfont cache
+
+	Keeps several soundfonts resident in fluidsynth, keyed by path, up to a memory budget.
+	Soundfonts are loaded by SoundfontLoader and added to the cache when ready.
+	Least recently used soundfonts are unloaded when the budget is exceeded.
+	Soundfonts are added and removed through the synth command queue. Removed soundfonts are freed by the loader's worker thread once no voice uses their samples.
+*/
+
+#pragma once
+
+#include "fluidsynth.h"
+#include "sfloader.hpp"
+#include "synthqueue.hpp"
+#include <map> // provides std::map
+#include <set> // provides std::set
+#include <string> // provides std::string
+#include <sys/stat.h> // provides stat for file size
+
+#define DEFAULT_SF_CACHE_MB 256 // Default memory budget for resident soundfonts
+
+/**	Soundfont resident in synth */
+struct CachedSoundfont
+{
+    int id = FLUID_FAILED; // fluidsynth soundfont id
+    fluid_sfont_t* sfont = NULL; // fluidsynth soundfont
+    size_t size = 0; // Approximate memory used (file size)
+    unsigned long lastUse = 0; // Value of use counter when last used (larger is more recent)
+};
+
+/**	SoundfontCache class manages soundfonts loaded into a synth */
+class SoundfontCache
+{
+public:
+    /**	Instantiate a soundfont cache
+    *	@param	nBudget Memory budget in MB
+    */
+    SoundfontCache(size_t nBudget = DEFAULT_SF_CACHE_MB) :
+        m_nBudget(nBudget * 1024 * 1024)
+    {
+    }
+
+    /**	Set the command queue of the synth that soundfonts are loaded to
+    *	@param	pQueue Pointer to synth command queue
+    *	@note	Clears cache without unloading soundfonts from any previous synth
+    */
+    void SetQueue(SynthCommandQueue* pQueue)
+    {
+        m_pQueue = pQueue;
+        m_mapFonts.clear();
+    }
+
+    /**	Set the loader that soundfonts are loaded by
+    *	@param	pLoader Pointer to soundfont loader - used to free soundfonts that are not added to the synth
+    */
+    void SetLoader(SoundfontLoader* pLoader)
+    {
+        m_pLoader = pLoader;
+    }
+
+    /**	Set the memory budget
+    *	@param	nBudget Memory budget in MB
+    *	@note	Soundfonts are evicted immediately if over budget
+    */
+    void SetBudget(size_t nBudget)
+    {
+        m_nBudget = nBudget * 1024 * 1024;
+        Evict();
+    }
+
+    /**	Get the memory budget
+    *	@retval	size_t Memory budget in MB
+    */
+    size_t GetBudget()
+    {
+        return m_nBudget / 1024 / 1024;
+    }
+
+    /**	Find a resident soundfont, marking it as most recently used
+    *	@param	sPath Path to soundfont file
+    *	@retval	int fluidsynth soundfont id or FLUID_FAILED if not resident
+    */
+    int Find(std::string sPath)
+    {
+        auto it = m_mapFonts.find(sPath);
+        if(it == m_mapFonts.end())
+            return FLUID_FAILED;
+        it->second.lastUse = ++m_nUseCounter;
+        return it->second.id;
+    }
+
+    /**	Check if a soundfont is resident without changing its use order
+    *	@param	sPath Path to soundfont file
+    *	@retval	bool True if resident
+    */
+    bool IsResident(std::string sPath)
+    {
+        return m_mapFonts.find(sPath) != m_mapFonts.end();
+    }
+
+    /**	Add a loaded soundfont to the synth and cache
+    *	@param	sPath Path to soundfont file
+    *	@param	pSoundfont Pointer to soundfont loaded by SoundfontLoader - cache takes ownership (discarding duplicates through the loader)
+    *	@retval	int fluidsynth soundfont id or FLUID_FAILED on failure
+    *	@note	Does not evict - call Evict once the new soundfont is in use
+    */
+    int Add(std::string sPath, fluid_sfont_t* pSoundfont)
+    {
+        if(!m_pQueue || !m_pLoader || !pSoundfont)
+            return FLUID_FAILED;
+        if(IsResident(sPath))
+        {
+            m_pLoader->Discard(pSoundfont); // Duplicate load
+            return Find(sPath);
+        }
+        int nId = m_pQueue->AddSoundfont(pSoundfont);
+        if(nId == FLUID_FAILED)
+        {
+            m_pLoader->Discard(pSoundfont);
+            return nId;
+        }
+        struct stat fileStat;
+        CachedSoundfont& font = m_mapFonts[sPath];
+        font.id = nId;
+        font.sfont = pSoundfont;
+        font.size = (stat(sPath.c_str(), &fileStat) == 0) ? fileStat.st_size : 0;
+        font.lastUse = ++m_nUseCounter;
+        return nId;
+    }
+
+    /**	Set the soundfonts that must not be evicted, e.g. current and adjacent presets
+    *	@param	setPaths Set of paths to soundfont files
+    */
+    void SetProtected(const std::set<std::string>& setPaths)
+    {
+        m_setProtected = setPaths;
+    }
+
+    /**	Unload least recently used, unprotected soundfonts until within budget
+    *	@param	nReserve Quantity of bytes to keep free within budget, e.g. for a soundfont about to load
+    *	@retval	bool True if within budget (with reserve)
+    */
+    bool Evict(size_t nReserve = 0)
+    {
+        while(GetSize() + nReserve > m_nBudget)
+        {
+            auto itOldest = m_mapFonts.end();
+            for(auto it = m_mapFonts.begin(); it != m_mapFonts.end(); ++it)
+            {
+                if(m_setProtected.count(it->first))
+                    continue;
+                if(itOldest == m_mapFonts.end() || it->second.lastUse < itOldest->second.lastUse)
+                    itOldest = it;
+            }
+            if(itOldest == m_mapFonts.end())
+                return false; // Only protected soundfonts remain
+            Remove(itOldest->second);
+            m_mapFonts.erase(itOldest);
+        }
+        return true;
+    }
+
+    /**	Unload a soundfont, e.g. because file has been deleted
+    *	@param	sPath Path to soundfont file
+    */
+    void Unload(std::string sPath)
+    {
+        auto it = m_mapFonts.find(sPath);
+        if(it == m_mapFonts.end())
+            return;
+        Remove(it->second);
+        m_mapFonts.erase(it);
+    }
+
+    /**	Get the total size of resident soundfonts
+    *	@retval	size_t Approximate memory used in bytes
+    */
+    size_t GetSize()
+    {
+        size_t nSize = 0;
+        for(auto it = m_mapFonts.begin(); it != m_mapFonts.end(); ++it)
+            nSize += it->second.size;
+        return nSize;
+    }
+
+    /**	Get quantity of resident soundfonts
+    *	@retval	unsigned int Quantity of soundfonts
+    */
+    unsigned int GetCount()
+    {
+        return m_mapFonts.size();
+    }
+
+private:
+    /**	Remove a soundfont from the synth and free it away from the audio thread
+    *	@param	font Cached soundfont
+    */
+    void Remove(CachedSoundfont& font)
+    {
+        m_pQueue->RemoveSoundfont(font.sfont);
+        m_pLoader->Discard(font.sfont);
+    }
+
+    SynthCommandQueue* m_pQueue = NULL; // Command queue of synth that soundfonts are loaded to
+    SoundfontLoader* m_pLoader = NULL; // Loader that soundfonts are loaded by
+    size_t m_nBudget; // Memory budget in bytes
+    unsigned long m_nUseCounter = 0; // Incremented on each use to order soundfonts by recency
+    std::set<std::string> m_setProtected; // Paths of soundfonts that must not be evicted
+    std::map<std::string, CachedSoundfont> m_mapFonts; // Resident soundfonts indexed by path
+};
@@ -0,0 +1,264 @@
+/*	Soundfont preset index
+
+	Reads the preset headers (bank, program, name) directly from a SF2 file and persists them in a compact binary index file.
+	The index is keyed by soundfont path, size and modification time and is only rebuilt when the soundfont changes.
+	Allows program lists and names to be shown without iterating or querying fluidsynth.
+*/
+
+#pragma once
+
+#include <algorithm> // provides std::sort
+#include <cstdint> // provides fixed size integers
+#include <cstdio> // provides FILE
+#include <cstring> // provides memcmp
+#include <functional> // provides std::hash
+#include <map> // provides std::map
+#include <string> // provides std::string
+#include <vector> // provides std::vector
+#include <sys/stat.h> // provides stat, mkdir
+
+#define SF_INDEX_ROOT "sfindex/" // Directory holding index files
+#define SF_INDEX_VERSION 1 // Increment when index file format changes
+#define SF_NAME_LEN 20 // Length of preset name in SF2 file
+
+/**	Preset within a soundfont */
+struct PresetInfo
+{
+    uint16_t bank = 0; // MIDI bank
+    uint16_t program = 0; // MIDI program
+    char name[SF_NAME_LEN + 1] = {0}; // Preset name (null terminated)
+};
+
+/**	PresetIndex class holds the presets of a soundfont */
+class PresetIndex
+{
+public:
+    /**	Load index of a soundfont, building and saving it if missing or out of date
+    *	@param	sPath Path to soundfont file
+    *	@retval	bool True on success
+    */
+    bool Load(std::string sPath)
+    {
+        struct stat fileStat;
+        if(stat(sPath.c_str(), &fileStat) != 0)
+            return false;
+        if(sPath == m_sPath && (size_t)fileStat.st_size == m_nIndexedSize && fileStat.st_mtime == m_nIndexedModified)
+            return true; // Already indexed and unchanged
+        m_sPath = sPath;
+        m_nSize = fileStat.st_size;
+        m_nModified = fileStat.st_mtime;
+        m_nIndexedSize = 0;
+        m_nIndexedModified = 0;
+        m_vPresets.clear();
+        m_mapPresets.clear();
+        std::string sIndexPath = GetIndexPath();
+        if(!ReadIndex(sIndexPath))
+        {
+            if(!Scan())
+                return false;
+            mkdir(SF_INDEX_ROOT, 0755);
+            WriteIndex(sIndexPath);
+        }
+        for(unsigned int nIndex = 0; nIndex < m_vPresets.size(); ++nIndex)
+            m_mapPresets[(m_vPresets[nIndex].bank << 8) | m_vPresets[nIndex].program] = nIndex;
+        return true;
+    }
+
+    /**	Check if index is still valid for the soundfont file
+    *	@retval	bool True if soundfont has not changed since index was loaded
+    */
+    bool IsCurrent()
+    {
+        struct stat fileStat;
+        if(stat(m_sPath.c_str(), &fileStat) != 0)
+            return false;
+        return (size_t)fileStat.st_size == m_nSize && fileStat.st_mtime == m_nModified;
+    }
+
+    /**	Get the presets in the soundfont
+    *	@retval	vector<PresetInfo>& List of presets sorted by bank then program
+    */
+    const std::vector<PresetInfo>& GetPresets()
+    {
+        return m_vPresets;
+    }
+
+    /**	Get the name of a preset
+    *	@param	nBank MIDI bank
+    *	@param	nProgram MIDI program
+    *	@retval	string Name of preset or empty string if not in soundfont
+    */
+    std::string GetName(unsigned int nBank, unsigned int nProgram)
+    {
+        auto it = m_mapPresets.find((nBank << 8) | nProgram);
+        if(it == m_mapPresets.end())
+            return "";
+        return m_vPresets[it->second].name;
+    }
+
+    /**	Get the position of a preset within the list of presets
+    *	@param	nBank MIDI bank
+    *	@param	nProgram MIDI program
+    *	@retval	int Index within GetPresets or -1 if not in soundfont
+    */
+    int Find(unsigned int nBank, unsigned int nProgram)
+    {
+        auto it = m_mapPresets.find((nBank << 8) | nProgram);
+        if(it == m_mapPresets.end())
+            return -1;
+        return it->second;
+    }
+
+private:
+    /**	Get path of index file for this soundfont */
+    std::string GetIndexPath()
+    {
+        char sHash[20];
+        snprintf(sHash, sizeof(sHash), "%016llx", (unsigned long long)std::hash<std::string>()(m_sPath));
+        return std::string(SF_INDEX_ROOT) + sHash + ".idx";
+    }
+
+    /**	Read presets from index file
+    *	@retval	bool True if index file exists and matches soundfont
+    */
+    bool ReadIndex(std::string sIndexPath)
+    {
+        FILE* pFile = fopen(sIndexPath.c_str(), "rb");
+        if(!pFile)
+            return false;
+        char acMagic[4];
+        uint32_t nVersion, nPathLen, nCount;
+        uint64_t nSize;
+        int64_t nModified;
+        bool bValid = fread(acMagic, 4, 1, pFile) == 1 && memcmp(acMagic, "FBIX", 4) == 0
+            && fread(&nVersion, sizeof(nVersion), 1, pFile) == 1 && nVersion == SF_INDEX_VERSION
+            && fread(&nSize, sizeof(nSize), 1, pFile) == 1 && nSize == m_nSize
+            && fread(&nModified, sizeof(nModified), 1, pFile) == 1 && nModified == m_nModified
+            && fread(&nPathLen, sizeof(nPathLen), 1, pFile) == 1 && nPathLen == m_sPath.length();
+        if(bValid)
+        {
+            std::string sPath(nPathLen, ' ');
+            bValid = (nPathLen == 0 || fread(&sPath[0], nPathLen, 1, pFile) == 1) && sPath == m_sPath
+                && fread(&nCount, sizeof(nCount), 1, pFile) == 1;
+            if(bValid)
+            {
+                m_vPresets.resize(nCount);
+                bValid = (nCount == 0 || fread(m_vPresets.data(), sizeof(PresetInfo), nCount, pFile) == nCount);
+            }
+        }
+        fclose(pFile);
+        if(!bValid)
+        {
+            m_vPresets.clear();
+            return false;
+        }
+        m_nIndexedSize = m_nSize;
+        m_nIndexedModified = m_nModified;
+        return true;
+    }
+
+    /**	Write presets to index file */
+    void WriteIndex(std::string sIndexPath)
+    {
+        std::string sTemp = sIndexPath + ".tmp";
+        FILE* pFile = fopen(sTemp.c_str(), "wb");
+        if(!pFile)
+            return;
+        uint32_t nVersion = SF_INDEX_VERSION;
+        uint32_t nPathLen = m_sPath.length();
+        uint32_t nCount = m_vPresets.size();
+        uint64_t nSize = m_nSize;
+        int64_t nModified = m_nModified;
+        bool bOk = fwrite("FBIX", 4, 1, pFile) == 1
+            && fwrite(&nVersion, sizeof(nVersion), 1, pFile) == 1
+            && fwrite(&nSize, sizeof(nSize), 1, pFile) == 1
+            && fwrite(&nModified, sizeof(nModified), 1, pFile) == 1
+            && fwrite(&nPathLen, sizeof(nPathLen), 1, pFile) == 1
+            && fwrite(m_sPath.c_str(), nPathLen, 1, pFile) == 1
+            && fwrite(&nCount, sizeof(nCount), 1, pFile) == 1
+            && (nCount == 0 || fwrite(m_vPresets.data(), sizeof(PresetInfo), nCount, pFile) == nCount);
+        if(fclose(pFile) == 0 && bOk)
+            rename(sTemp.c_str(), sIndexPath.c_str());
+        else
+            remove(sTemp.c_str());
+    }
+
+    /**	Read preset headers (phdr chunk) from soundfont file
+    *	@retval	bool True on success
+    */
+    bool Scan()
+    {
+        FILE* pFile = fopen(m_sPath.c_str(), "rb");
+        if(!pFile)
+            return false;
+        bool bOk = false;
+        char acId[4];
+        uint32_t nChunkSize;
+        // RIFF sfbk header
+        if(fread(acId, 4, 1, pFile) == 1 && memcmp(acId, "RIFF", 4) == 0
+            && fread(&nChunkSize, 4, 1, pFile) == 1
+            && fread(acId, 4, 1, pFile) == 1 && memcmp(acId, "sfbk", 4) == 0)
+        {
+            // Find LIST pdta then phdr within it
+            off_t nEnd = 0;
+            while(fread(acId, 4, 1, pFile) == 1 && fread(&nChunkSize, 4, 1, pFile) == 1)
+            {
+                off_t nNext = ftello(pFile) + nChunkSize + (nChunkSize & 1);
+                if(memcmp(acId, "LIST", 4) == 0)
+                {
+                    if(fread(acId, 4, 1, pFile) != 1)
+                        break;
+                    if(memcmp(acId, "pdta", 4) == 0)
+                    {
+                        nEnd = nNext; // Descend into pdta
+                        continue;
+                    }
+                }
+                else if(nEnd && memcmp(acId, "phdr", 4) == 0)
+                {
+                    bOk = ReadPresetHeaders(pFile, nChunkSize);
+                    break;
+                }
+                if(fseeko(pFile, nNext, SEEK_SET) != 0)
+                    break;
+            }
+        }
+        fclose(pFile);
+        if(!bOk)
+            return false;
+        std::sort(m_vPresets.begin(), m_vPresets.end(), [](const PresetInfo& a, const PresetInfo& b) {return (a.bank << 8 | a.program) < (b.bank << 8 | b.program);});
+        m_nIndexedSize = m_nSize;
+        m_nIndexedModified = m_nModified;
+        return true;
+    }
+
+    /**	Read phdr records (38 bytes each, last is terminal record) */
+    bool ReadPresetHeaders(FILE* pFile, uint32_t nChunkSize)
+    {
+        if(nChunkSize % 38 || nChunkSize < 38)
+            return false;
+        std::vector<uint8_t> vData(nChunkSize);
+        if(fread(vData.data(), nChunkSize, 1, pFile) != 1)
+            return false;
+        unsigned int nCount = nChunkSize / 38 - 1;
+        m_vPresets.resize(nCount);
+        for(unsigned int nIndex = 0; nIndex < nCount; ++nIndex)
+        {
+            const uint8_t* pRecord = vData.data() + nIndex * 38;
+            PresetInfo& preset = m_vPresets[nIndex];
+            memcpy(preset.name, pRecord, SF_NAME_LEN);
+            preset.name[SF_NAME_LEN] = 0;
+            preset.program = pRecord[20] | (pRecord[21] << 8);
+            preset.bank = pRecord[22] | (pRecord[23] << 8);
+        }
+        return true;
+    }
+
+    std::string m_sPath; // Path to soundfont file
+    size_t m_nSize = 0; // Size of soundfont file
+    time_t m_nModified = 0; // Modification time of soundfont file
+    size_t m_nIndexedSize = 0; // Size of soundfont file when presets were indexed
+    time_t m_nIndexedModified = 0; // Modification time of soundfont file when presets were indexed
+    std::vector<PresetInfo> m_vPresets; // Presets sorted by bank then program
+    std::map<unsigned int, unsigned int> m_mapPresets; // Index into m_vPresets keyed by bank << 8 | program
+};
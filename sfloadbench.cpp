@@ -0,0 +1,194 @@
+/*	Soundfont loader benchmark - riban 2020 <brian@riban.co.uk>
+
+	Compares fluidsynth's default soundfont loader with the memory-mapped loader in sfmmap.hpp.
+	Reports load time with the file evicted from the page cache (cold) and cached (warm) and the resident memory of the process after loading, split into private (anonymous) and file backed (page cache) pages.
+	Plays a note of each preset with each loader and exits with non-zero status if the mapped soundfont does not sound the same as the default loader's.
+	Run from the fluidbox directory (containing sf2/).
+	Usage: sfloadbench [soundfont] [repeats]
+*/
+
+#include "sfmmap.hpp"
+#include "fluidsynth.h"
+#include <cmath> // provides fabs
+#include <cstdio> // provides printf
+#include <cstdlib> // provides atoi
+#include <fstream> // provides ifstream
+#include <string> // provides std::string
+#include <vector> // provides std::vector
+#include <fcntl.h> // provides posix_fadvise
+#include <time.h> // provides clock_gettime
+
+using namespace std;
+
+#define DEFAULT_SOUNDFONT "sf2/default/TimGM6mb.sf2" // Soundfont benchmarked if not specified
+#define BENCH_NOTE_FRAMES 2048 // Frames rendered whilst each note is held and again after release
+#define BENCH_TOLERANCE 0.0001 // Largest difference between loaders' audio considered the same
+
+/**	Memory used by process in kB */
+struct Rss
+{
+    long total = 0; // Resident set size
+    long anon = 0; // Private memory (heap)
+    long file = 0; // Mapped file pages (shared with page cache)
+};
+
+/**	Result of benchmarking a loader */
+struct LoadResult
+{
+    bool ok = false; // True if all loads succeeded
+    double cold = 0; // Mean load time with file not cached in ms
+    double warm = 0; // Mean load time with file cached in ms
+    Rss rss; // Increase in memory after load
+    vector<float> audio; // Audio rendered playing each preset
+};
+
+/**	Get monotonic time in ms */
+double getMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**	Get memory used by this process */
+Rss getRss()
+{
+    Rss rss;
+    ifstream fileStatus("/proc/self/status");
+    string sLine;
+    while(getline(fileStatus, sLine))
+    {
+        if(sLine.compare(0, 6, "VmRSS:") == 0)
+            rss.total = atol(sLine.c_str() + 6);
+        else if(sLine.compare(0, 8, "RssAnon:") == 0)
+            rss.anon = atol(sLine.c_str() + 8);
+        else if(sLine.compare(0, 8, "RssFile:") == 0)
+            rss.file = atol(sLine.c_str() + 8);
+    }
+    return rss;
+}
+
+/**	Drop a file from the page cache so that the next read is from storage
+*	@param	sPath Path to file
+*/
+void evict(string sPath)
+{
+    int nFd = open(sPath.c_str(), O_RDONLY);
+    if(nFd < 0)
+        return;
+    posix_fadvise(nFd, 0, 0, POSIX_FADV_DONTNEED);
+    close(nFd);
+}
+
+/**	Play a note of each preset of a soundfont
+*	@param	pSynth Synth with soundfont loaded
+*	@param	nSoundfont Soundfont id
+*	@param	vAudio Vector to append rendered audio to (left channel)
+*/
+void render(fluid_synth_t* pSynth, int nSoundfont, vector<float>& vAudio)
+{
+    fluid_sfont_t* pSoundfont = fluid_synth_get_sfont_by_id(pSynth, nSoundfont);
+    fluid_sfont_iteration_start(pSoundfont);
+    float afLeft[BENCH_NOTE_FRAMES], afRight[BENCH_NOTE_FRAMES];
+    while(fluid_preset_t* pPreset = fluid_sfont_iteration_next(pSoundfont))
+    {
+        fluid_synth_program_select(pSynth, 0, nSoundfont, fluid_preset_get_banknum(pPreset), fluid_preset_get_num(pPreset));
+        fluid_synth_noteon(pSynth, 0, 60, 100);
+        fluid_synth_write_float(pSynth, BENCH_NOTE_FRAMES, afLeft, 0, 1, afRight, 0, 1);
+        vAudio.insert(vAudio.end(), afLeft, afLeft + BENCH_NOTE_FRAMES);
+        fluid_synth_noteoff(pSynth, 0, 60);
+        fluid_synth_write_float(pSynth, BENCH_NOTE_FRAMES, afLeft, 0, 1, afRight, 0, 1);
+        vAudio.insert(vAudio.end(), afLeft, afLeft + BENCH_NOTE_FRAMES);
+        fluid_synth_all_sounds_off(pSynth, 0);
+    }
+}
+
+/**	Benchmark loading a soundfont
+*	@param	sPath Path to soundfont
+*	@param	nMode Load mode [MMAP_MODE]
+*	@param	nRepeats Quantity of cold and warm loads
+*	@retval	LoadResult Benchmark results
+*/
+LoadResult benchmark(string sPath, int nMode, unsigned int nRepeats)
+{
+    LoadResult result;
+    result.ok = true;
+    for(unsigned int nRepeat = 0; nRepeat < nRepeats * 2; ++nRepeat)
+    {
+        bool bCold = nRepeat < nRepeats;
+        bool bLast = nRepeat == nRepeats * 2 - 1;
+        MmapSoundfontLoader mmapLoader; // Must outlive synth
+        mmapLoader.SetMode(nMode);
+        fluid_settings_t* pSettings = new_fluid_settings();
+        fluid_settings_setint(pSettings, "synth.chorus.active", 0);
+        fluid_settings_setint(pSettings, "synth.reverb.active", 0);
+        fluid_synth_t* pSynth = new_fluid_synth(pSettings);
+        fluid_synth_add_sfloader(pSynth, mmapLoader.NewSfloader()); // Declines all files if mode is MMAP_OFF
+        if(bCold)
+            evict(sPath);
+        Rss rssBefore = getRss();
+        double dStart = getMillis();
+        int nSoundfont = fluid_synth_sfload(pSynth, sPath.c_str(), 0);
+        double dDuration = getMillis() - dStart;
+        if(nSoundfont == FLUID_FAILED)
+            result.ok = false;
+        else if(bLast)
+        {
+            Rss rssAfter = getRss();
+            result.rss.total = rssAfter.total - rssBefore.total;
+            result.rss.anon = rssAfter.anon - rssBefore.anon;
+            result.rss.file = rssAfter.file - rssBefore.file;
+            render(pSynth, nSoundfont, result.audio);
+        }
+        (bCold ? result.cold : result.warm) += dDuration / nRepeats;
+        delete_fluid_synth(pSynth); // Frees soundfont
+        delete_fluid_settings(pSettings);
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    string sPath = (argc > 1) ? argv[1] : DEFAULT_SOUNDFONT;
+    unsigned int nRepeats = (argc > 2) ? atoi(argv[2]) : 3;
+    if(nRepeats < 1)
+        nRepeats = 1;
+    fluid_set_log_function(FLUID_WARN, NULL, NULL); // Missing samples etc. are not of interest
+
+    // Mapped loaders first so that heap retained by the allocator after the default loader does not skew their memory
+    const char* asNames[] = {"mmap populate", "mmap lazy", "default"};
+    const int anModes[] = {MMAP_POPULATE, MMAP_LAZY, MMAP_OFF};
+    LoadResult aResults[3];
+    printf("Soundfont %s, %u cold and %u warm loads\n", sPath.c_str(), nRepeats, nRepeats);
+    printf("%-14s %9s %9s %9s %9s %9s\n", "loader", "cold ms", "warm ms", "RSS MB", "anon MB", "file MB");
+    for(unsigned int nIndex = 0; nIndex < 3; ++nIndex)
+    {
+        aResults[nIndex] = benchmark(sPath, anModes[nIndex], nRepeats);
+        const LoadResult& result = aResults[nIndex];
+        if(!result.ok)
+        {
+            printf("%-14s failed to load\n", asNames[nIndex]);
+            continue;
+        }
+        printf("%-14s %9.1f %9.1f %9.1f %9.1f %9.1f\n", asNames[nIndex], result.cold, result.warm,
+            result.rss.total / 1024.0, result.rss.anon / 1024.0, result.rss.file / 1024.0);
+    }
+    if(!aResults[2].ok)
+        return 1;
+
+    // Mapped soundfonts should sound as the default loader's
+    bool bPass = true;
+    for(unsigned int nIndex = 0; nIndex < 2; ++nIndex)
+    {
+        if(!aResults[nIndex].ok)
+            continue;
+        const vector<float>& vAudio = aResults[nIndex].audio;
+        const vector<float>& vReference = aResults[2].audio;
+        double dDifference = (vAudio.size() == vReference.size()) ? 0 : 1;
+        for(size_t nFrame = 0; nFrame < vAudio.size() && nFrame < vReference.size(); ++nFrame)
+            dDifference = max(dDifference, (double)fabs(vAudio[nFrame] - vReference[nFrame]));
+        printf("%s audio %s default (largest difference %f)\n", asNames[nIndex], dDifference <= BENCH_TOLERANCE ? "matches" : "DIFFERS from", dDifference);
+        bPass &= dDifference <= BENCH_TOLERANCE;
+    }
+    return bPass ? 0 : 1;
+}
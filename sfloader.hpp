@@ -0,0 +1,347 @@
+/*	Background soundfont loader
+
+	Loads soundfonts in a worker thread into a private (scratch) synth so that the main synth API is not blocked by file parsing and sample reading.
+	Each loaded soundfont is removed from the scratch synth and handed to the caller who adds it to the main synth with fluid_synth_add_sfont.
+	Progress is measured by counting bytes read through custom fluidsynth file callbacks, or bytes of sample data populated when soundfonts are memory-mapped.
+*/
+
+#pragma once
+
+#include "fluidsynth.h"
+#include "sfmmap.hpp"
+#include <atomic> // provides std::atomic
+#include <condition_variable> // provides std::condition_variable
+#include <deque> // provides std::deque
+#include <functional> // provides std::function
+#include <mutex> // provides std::mutex
+#include <set> // provides std::set
+#include <string> // provides std::string
+#include <thread> // provides std::thread
+#include <vector> // provides std::vector
+#include <cstdio> // provides FILE
+#include <sys/stat.h> // provides stat for file size
+#include <time.h> // provides clock_gettime
+
+/**	Result of a background soundfont load */
+struct SoundfontLoad
+{
+    std::string path; // Path to soundfont file
+    fluid_sfont_t* sfont = NULL; // Loaded soundfont (NULL on failure) - caller takes ownership
+    unsigned int duration = 0; // Time taken to load in ms
+};
+
+/**	SoundfontLoader class loads soundfonts in a background thread */
+class SoundfontLoader
+{
+public:
+    ~SoundfontLoader()
+    {
+        Stop();
+    }
+
+    /**	Start the worker thread
+    *	@retval	bool True on success
+    */
+    bool Start()
+    {
+        if(m_pSynth)
+            return true;
+        // Scratch synth only parses soundfonts - keep it as light as possible
+        m_pSettings = new_fluid_settings();
+        fluid_settings_setint(m_pSettings, "synth.polyphony", 1);
+        fluid_settings_setint(m_pSettings, "synth.cpu-cores", 1);
+        fluid_settings_setint(m_pSettings, "synth.chorus.active", 0);
+        fluid_settings_setint(m_pSettings, "synth.reverb.active", 0);
+        m_pSynth = new_fluid_synth(m_pSettings);
+        if(!m_pSynth)
+            return false;
+        fluid_sfloader_t* pLoader = new_fluid_defsfloader(m_pSettings);
+        fluid_sfloader_set_callbacks(pLoader, OnOpen, OnRead, OnSeek, OnTell, OnClose);
+        fluid_synth_add_sfloader(m_pSynth, pLoader); // synth takes ownership of loader
+        m_mmapLoader.SetProgress([this](size_t nBytes) {m_nRead.fetch_add(nBytes, std::memory_order_relaxed);});
+        pLoader = m_mmapLoader.NewSfloader();
+        if(pLoader)
+            fluid_synth_add_sfloader(m_pSynth, pLoader); // Tried first - declines soundfonts it cannot map
+        m_bRun = true;
+        m_thread = std::thread(&SoundfontLoader::Run, this);
+        return true;
+    }
+
+    /**	Stop the worker thread and release resources
+    *	@note	Call after all soundfonts handed out have been unloaded from other synths - they depend on the scratch synth's loader
+    */
+    void Stop()
+    {
+        if(!m_pSynth)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bRun = false;
+            m_deqRequests.clear();
+        }
+        m_cv.notify_all();
+        if(m_thread.joinable())
+            m_thread.join();
+        for(auto it = m_deqResults.begin(); it != m_deqResults.end(); ++it)
+            if(it->sfont)
+                m_vDiscards.push_back(it->sfont);
+        m_deqResults.clear();
+        for(auto it = m_vDiscards.begin(); it != m_vDiscards.end(); ++it)
+            Free(*it);
+        m_vDiscards.clear();
+        delete_fluid_synth(m_pSynth);
+        delete_fluid_settings(m_pSettings);
+        m_pSynth = NULL;
+        m_pSettings = NULL;
+    }
+
+    /**	Set function called from worker thread when a result is ready, e.g. to wake caller's event loop
+    *	@param	fnNotify Function to call
+    *	@note	Call before Start
+    */
+    void SetNotify(std::function<void()> fnNotify)
+    {
+        m_fnNotify = fnNotify;
+    }
+
+    /**	Set how soundfonts are loaded
+    *	@param	nMode Load mode [MMAP_MODE]
+    *	@note	Applies to subsequent loads
+    */
+    void SetMmapMode(int nMode)
+    {
+        m_mmapLoader.SetMode(nMode);
+    }
+
+    /**	Get how soundfonts are loaded
+    *	@retval	int Load mode [MMAP_MODE]
+    */
+    int GetMmapMode()
+    {
+        return m_mmapLoader.GetMode();
+    }
+
+    /**	Free a soundfont handed out by the loader that is not in a synth, e.g. a duplicate load or one removed from the synth
+    *	@param	pSoundfont Pointer to soundfont
+    *	@note	Freed by the worker thread through the scratch synth so that the soundfont's own free callback is used
+    */
+    void Discard(fluid_sfont_t* pSoundfont)
+    {
+        if(!pSoundfont)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_vDiscards.push_back(pSoundfont);
+        }
+        m_cv.notify_one();
+    }
+
+    /**	Request a soundfont is loaded
+    *	@param	sPath Path to soundfont file
+    *	@param	bUrgent True to load before other queued requests, e.g. required by current preset
+    *	@note	Does nothing if the soundfont is already loading. Queued requests are moved to front if urgent.
+    */
+    void Request(std::string sPath, bool bUrgent = false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(sPath == m_sCurrent)
+                return;
+            for(auto it = m_deqRequests.begin(); it != m_deqRequests.end(); ++it)
+            {
+                if(*it == sPath)
+                {
+                    if(!bUrgent)
+                        return;
+                    m_deqRequests.erase(it);
+                    break;
+                }
+            }
+            if(bUrgent)
+                m_deqRequests.push_front(sPath);
+            else
+                m_deqRequests.push_back(sPath);
+        }
+        m_cv.notify_one();
+    }
+
+    /**	Remove queued requests that are no longer wanted
+    *	@param	setPaths Set of paths to soundfont files to keep queued
+    *	@note	Does not interrupt a load in progress
+    */
+    void Retain(const std::set<std::string>& setPaths)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(auto it = m_deqRequests.begin(); it != m_deqRequests.end();)
+        {
+            if(setPaths.count(*it))
+                ++it;
+            else
+                it = m_deqRequests.erase(it);
+        }
+    }
+
+    /**	Check if a soundfont is queued or loading
+    *	@param	sPath Path to soundfont file
+    *	@retval	bool True if pending
+    */
+    bool IsPending(std::string sPath)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(sPath == m_sCurrent)
+            return true;
+        for(auto it = m_deqRequests.begin(); it != m_deqRequests.end(); ++it)
+            if(*it == sPath)
+                return true;
+        return false;
+    }
+
+    /**	Get the next completed load
+    *	@param	result Reference to populate with result
+    *	@retval	bool True if a result was available
+    */
+    bool GetResult(SoundfontLoad& result)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_deqResults.empty())
+            return false;
+        result = m_deqResults.front();
+        m_deqResults.pop_front();
+        return true;
+    }
+
+    /**	Get progress of a soundfont load
+    *	@param	sPath Path to soundfont file
+    *	@retval	int Percentage loaded [0..100] or -1 if not currently loading this soundfont
+    */
+    int GetProgress(std::string sPath)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(sPath != m_sCurrent)
+            return -1;
+        size_t nSize = m_nSize.load(std::memory_order_relaxed);
+        if(!nSize)
+            return 0;
+        size_t nRead = m_nRead.load(std::memory_order_relaxed);
+        return (nRead >= nSize) ? 100 : nRead * 100 / nSize;
+    }
+
+private:
+    /**	Worker thread loop */
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_bRun)
+        {
+            if(!m_vDiscards.empty())
+            {
+                std::vector<fluid_sfont_t*> vDiscards;
+                vDiscards.swap(m_vDiscards);
+                lock.unlock();
+                for(auto it = vDiscards.begin(); it != vDiscards.end(); ++it)
+                    Free(*it);
+                lock.lock();
+                continue;
+            }
+            if(m_deqRequests.empty())
+            {
+                m_cv.wait(lock);
+                continue;
+            }
+            std::string sPath = m_deqRequests.front();
+            m_deqRequests.pop_front();
+            m_sCurrent = sPath;
+            struct stat fileStat;
+            m_nSize = (stat(sPath.c_str(), &fileStat) == 0) ? fileStat.st_size : 0;
+            m_nRead = 0;
+            lock.unlock();
+
+            SoundfontLoad result;
+            result.path = sPath;
+            struct timespec tsStart, tsEnd;
+            clock_gettime(CLOCK_MONOTONIC, &tsStart);
+            Active() = this;
+            int nId = fluid_synth_sfload(m_pSynth, sPath.c_str(), 0);
+            Active() = NULL;
+            if(nId != FLUID_FAILED)
+            {
+                result.sfont = fluid_synth_get_sfont_by_id(m_pSynth, nId);
+                fluid_synth_remove_sfont(m_pSynth, result.sfont); // Detach from scratch synth without freeing
+            }
+            clock_gettime(CLOCK_MONOTONIC, &tsEnd);
+            result.duration = (tsEnd.tv_sec - tsStart.tv_sec) * 1000 + (tsEnd.tv_nsec - tsStart.tv_nsec) / 1000000;
+
+            lock.lock();
+            m_sCurrent = "";
+            m_deqResults.push_back(result);
+            if(m_fnNotify)
+                m_fnNotify();
+        }
+    }
+
+    /**	Free a soundfont through the scratch synth
+    *	@param	pSoundfont Pointer to soundfont not added to any synth
+    *	@note	delete_fluid_sfont would only free the fluidsynth soundfont structure, not its presets and samples
+    */
+    void Free(fluid_sfont_t* pSoundfont)
+    {
+        int nId = fluid_synth_add_sfont(m_pSynth, pSoundfont);
+        if(nId != FLUID_FAILED)
+            fluid_synth_sfunload(m_pSynth, nId, 0); // fluidsynth retries from a timer thread whilst voices of another synth still use its samples
+    }
+
+    // fluidsynth file callbacks - only used by worker thread
+    static void* OnOpen(const char* sFilename)
+    {
+        return fopen(sFilename, "rb");
+    }
+
+    static int OnRead(void* pBuffer, fluid_long_long_t nCount, void* pHandle)
+    {
+        if(nCount && fread(pBuffer, (size_t)nCount, 1, (FILE*)pHandle) != 1)
+            return FLUID_FAILED;
+        if(Active())
+            Active()->m_nRead.fetch_add(nCount, std::memory_order_relaxed);
+        return FLUID_OK;
+    }
+
+    static int OnSeek(void* pHandle, fluid_long_long_t nOffset, int nOrigin)
+    {
+        return (fseeko((FILE*)pHandle, (off_t)nOffset, nOrigin) == 0) ? FLUID_OK : FLUID_FAILED;
+    }
+
+    static fluid_long_long_t OnTell(void* pHandle)
+    {
+        return ftello((FILE*)pHandle);
+    }
+
+    static int OnClose(void* pHandle)
+    {
+        return (fclose((FILE*)pHandle) == 0) ? FLUID_OK : FLUID_FAILED;
+    }
+
+    /**	Get loader currently within fluid_synth_sfload (for progress)
+    *	@retval	SoundfontLoader*& Reference to active loader (NULL if none)
+    *	@note	Function-local static so that the header may be included by more than one translation unit
+    */
+    static SoundfontLoader*& Active()
+    {
+        static SoundfontLoader* s_pActive = NULL;
+        return s_pActive;
+    }
+
+    fluid_settings_t* m_pSettings = NULL; // Settings for scratch synth
+    fluid_synth_t* m_pSynth = NULL; // Scratch synth used to parse soundfonts
+    MmapSoundfontLoader m_mmapLoader; // Loader mapping soundfont files (must outlive scratch synth)
+    std::thread m_thread; // Worker thread
+    std::mutex m_mutex; // Protects requests, results and current path
+    std::condition_variable m_cv; // Signals worker when requests are added or stopping
+    bool m_bRun = false; // True whilst worker should run
+    std::deque<std::string> m_deqRequests; // Paths of soundfonts waiting to load
+    std::deque<SoundfontLoad> m_deqResults; // Completed loads waiting for caller
+    std::vector<fluid_sfont_t*> m_vDiscards; // Soundfonts waiting to be freed by worker
+    std::string m_sCurrent; // Path of soundfont currently loading
+    std::function<void()> m_fnNotify; // Called when a result is ready
+    std::atomic<size_t> m_nSize = {0}; // Size of soundfont currently loading
+    std::atomic<size_t> m_nRead = {0}; // Bytes read of soundfont currently loading
+};
@@ -0,0 +1,735 @@
+/*	Memory-mapped soundfonts
+
+	fluidsynth's default loader reads and copies all sample data of a soundfont into private heap memory.
+	MmapSoundfontLoader is a fluidsynth soundfont loader that maps the SoundFont 2 file instead and points each fluidsynth sample directly at its data within the mapped sample chunk.
+	Sample pages are then shared with the page cache, are not copied on load and may be reclaimed by the kernel under memory pressure (to be read back from the file when next played).
+	Presets, instruments and zones are parsed from the mapped preset data and voices are started by the preset note-on callback, as by fluidsynth's default soundfont.
+	Compressed (SF3) soundfonts and those with ROM samples are declined so that the next loader (fluidsynth's default) loads them.
+	Sample data is used in place so must be little endian 16-bit, as on the Raspberry Pi.
+*/
+
+#pragma once
+
+#include "fluidsynth.h"
+#include <algorithm> // provides std::min, std::max
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides fixed size integers
+#include <cstring> // provides memcmp, memcpy
+#include <functional> // provides std::function
+#include <map> // provides std::map
+#include <string> // provides std::string
+#include <vector> // provides std::vector
+#include <fcntl.h> // provides open
+#include <unistd.h> // provides close, sysconf
+#include <sys/mman.h> // provides mmap, madvise
+#include <sys/stat.h> // provides fstat
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22 // Linux 5.14 - older kernels reject it and pages are touched instead
+#endif
+
+#define MMAP_POPULATE_CHUNK 1048576 // Bytes of sample data populated between progress reports
+#define MMAP_VOICE_SLOTS 1024 // Voices tracked per soundfont - must be a power of 2 and more than synth polyphony
+#define MMAP_ZONE_MODS 32 // Maximum modulators used from each zone
+#define MMAP_GEN_COUNT 59 // SoundFont 2 generators (0..overridingRootKey)
+
+/**	Mode of loading soundfonts */
+enum MMAP_MODE
+{
+    MMAP_OFF = 0, // Use fluidsynth's default loader (samples copied to heap)
+    MMAP_POPULATE = 1, // Map file and read all sample data into page cache during load
+    MMAP_LAZY = 2 // Map file and let the kernel read sample data ahead in the background
+};
+
+/**	Modulator of a zone */
+struct MmapMod
+{
+    fluid_mod_t* mod; // fluidsynth modulator
+    int16_t amount; // Amount (zero amount modulators only override others)
+};
+
+/**	Preset or instrument zone */
+struct MmapZone
+{
+    int index = -1; // Index of instrument (preset zone) or sample (instrument zone), -1 for global zone
+    uint64_t set = 0; // Bitmask of generators set by zone
+    int16_t gen[MMAP_GEN_COUNT] = {}; // Generator amounts
+    uint8_t keyLo = 0, keyHi = 127; // Key range
+    uint8_t velLo = 0, velHi = 127; // Velocity range
+    bool keyRange = false, velRange = false; // True if zone sets range (otherwise global zone range applies)
+    std::vector<MmapMod> mods; // Modulators
+};
+
+class MmapSoundfont;
+
+/**	Preset of a mapped soundfont */
+struct MmapPreset
+{
+    MmapSoundfont* soundfont; // Soundfont containing preset
+    fluid_preset_t* preset = NULL; // fluidsynth preset
+    char name[21]; // Preset name
+    int bank; // MIDI bank
+    int program; // MIDI program
+    std::vector<MmapZone> zones; // Zones (first may be global)
+};
+
+/**	Voice started by a mapped soundfont */
+struct MmapVoice
+{
+    std::atomic<fluid_voice_t*> voice = {NULL}; // fluidsynth voice (NULL if slot unused)
+    std::atomic<unsigned int> id = {0}; // Id of voice when started by soundfont - voices are reused
+};
+
+/**	MmapSoundfont class holds a soundfont whose sample data is used in place from a mapped file */
+class MmapSoundfont
+{
+public:
+    ~MmapSoundfont()
+    {
+        for(auto it = m_mapPresets.begin(); it != m_mapPresets.end(); ++it)
+        {
+            if(it->second->preset)
+                delete_fluid_preset(it->second->preset);
+            FreeMods(it->second->zones);
+            delete it->second;
+        }
+        for(auto it = m_vInstruments.begin(); it != m_vInstruments.end(); ++it)
+            FreeMods(*it);
+        for(auto it = m_vSamples.begin(); it != m_vSamples.end(); ++it)
+            if(*it)
+                delete_fluid_sample(*it);
+        if(m_pData)
+            munmap((void*)m_pData, m_nSize);
+    }
+
+    /**	Map and parse a soundfont
+    *	@param	sFilename Path to soundfont
+    *	@param	nMode Load mode [MMAP_POPULATE | MMAP_LAZY]
+    *	@param	fnProgress Function called with bytes of sample data read into memory whilst populating (may be empty)
+    *	@retval	bool True on success, false if the file is not a soundfont that may be mapped
+    */
+    bool Load(const char* sFilename, int nMode, const std::function<void(size_t)>& fnProgress)
+    {
+        m_sName = sFilename;
+        int nFd = open(sFilename, O_RDONLY | O_CLOEXEC);
+        if(nFd < 0)
+            return false;
+        struct stat fileStat;
+        if(fstat(nFd, &fileStat) != 0 || fileStat.st_size < 12)
+        {
+            close(nFd);
+            return false;
+        }
+        m_nSize = fileStat.st_size;
+        int nFlags = MAP_SHARED;
+        if(nMode == MMAP_POPULATE && !fnProgress)
+            nFlags |= MAP_POPULATE; // Kernel reads whole file before returning
+        void* pData = mmap(NULL, m_nSize, PROT_READ, nFlags, nFd, 0);
+        close(nFd); // Mapping holds its own reference to the file
+        if(pData == MAP_FAILED)
+            return false;
+        m_pData = (const uint8_t*)pData;
+        if(!ReadChunks())
+            return false;
+
+        const Chunk& smpl = m_mapChunks["smpl"];
+        if(nMode == MMAP_POPULATE && fnProgress)
+            Populate(smpl, fnProgress);
+        else if(nMode == MMAP_LAZY)
+            Advise(smpl, MADV_WILLNEED); // Asynchronous read ahead - load does not wait for disk
+        if(!ReadSamples() || !ReadInstruments() || !ReadPresets())
+            return false;
+
+        m_pSoundfont = new_fluid_sfont(OnGetName, OnGetPreset, OnIterationStart, OnIterationNext, OnFree);
+        if(!m_pSoundfont)
+            return false;
+        fluid_sfont_set_data(m_pSoundfont, this);
+        for(auto it = m_mapPresets.begin(); it != m_mapPresets.end(); ++it)
+        {
+            it->second->preset = new_fluid_preset(m_pSoundfont, OnGetPresetName, OnGetBank, OnGetProgram, OnNoteon, OnFreePreset);
+            if(!it->second->preset)
+                return false;
+            fluid_preset_set_data(it->second->preset, it->second);
+        }
+        return true;
+    }
+
+    /**	Get the fluidsynth soundfont
+    *	@retval	fluid_sfont_t* Pointer to soundfont (NULL if not loaded)
+    */
+    fluid_sfont_t* GetSoundfont()
+    {
+        return m_pSoundfont;
+    }
+
+private:
+    /**	Region of mapped file */
+    struct Chunk
+    {
+        const uint8_t* data = NULL; // Start of chunk data
+        size_t size = 0; // Size of chunk data in bytes
+    };
+
+    static uint16_t Get16(const uint8_t* pData)
+    {
+        return pData[0] | (pData[1] << 8);
+    }
+
+    static uint32_t Get32(const uint8_t* pData)
+    {
+        return Get16(pData) | ((uint32_t)Get16(pData + 2) << 16);
+    }
+
+    /**	Find soundfont chunks within mapped file
+    *	@retval	bool True if all required chunks are present and valid
+    */
+    bool ReadChunks()
+    {
+        if(memcmp(m_pData, "RIFF", 4) != 0 || memcmp(m_pData + 8, "sfbk", 4) != 0)
+            return false;
+        // Sizes are summed in 64 bits so that corrupt sizes cannot wrap on 32-bit systems
+        size_t nRiffEnd = std::min((uint64_t)m_nSize, (uint64_t)Get32(m_pData + 4) + 8);
+        // Top level LISTs (INFO, sdta, pdta) each hold sub-chunks
+        for(size_t nPos = 12; nPos + 12 <= nRiffEnd;)
+        {
+            size_t nListEnd = std::min((uint64_t)nRiffEnd, (uint64_t)nPos + 8 + Get32(m_pData + nPos + 4));
+            if(nListEnd <= nPos)
+                return false;
+            for(size_t nSub = nPos + 12; nSub + 8 <= nListEnd;)
+            {
+                uint32_t nSize = Get32(m_pData + nSub + 4);
+                if((uint64_t)nSub + 8 + nSize > nListEnd)
+                    return false;
+                Chunk& chunk = m_mapChunks[std::string((const char*)m_pData + nSub, 4)];
+                chunk.data = m_pData + nSub + 8;
+                chunk.size = nSize;
+                nSub += 8 + nSize + (nSize & 1);
+            }
+            nPos = nListEnd + (nListEnd & 1);
+        }
+        auto itVersion = m_mapChunks.find("ifil");
+        if(itVersion != m_mapChunks.end() && itVersion->second.size >= 2 && Get16(itVersion->second.data) >= 3)
+            return false; // SF3 - samples are compressed
+        const char* asRequired[] = {"smpl", "phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr"};
+        const unsigned int anRecord[] = {2, 38, 4, 10, 4, 22, 4, 10, 4, 46};
+        for(unsigned int nIndex = 0; nIndex < 10; ++nIndex)
+        {
+            auto it = m_mapChunks.find(asRequired[nIndex]);
+            if(it == m_mapChunks.end() || it->second.size % anRecord[nIndex] || it->second.size < anRecord[nIndex]) // Each list ends with a terminal record
+                return false;
+        }
+        if((m_mapChunks["smpl"].data - m_pData) & 1)
+            return false; // Sample data must be aligned to be used in place
+        return true;
+    }
+
+    /**	Apply memory advice to the pages of a chunk
+    *	@param	chunk Chunk
+    *	@param	nAdvice Advice [MADV_*]
+    *	@retval	int Result of madvise
+    */
+    int Advise(const Chunk& chunk, int nAdvice)
+    {
+        size_t nPage = sysconf(_SC_PAGESIZE);
+        uintptr_t nStart = (uintptr_t)chunk.data & ~(nPage - 1);
+        return madvise((void*)nStart, (uintptr_t)chunk.data + chunk.size - nStart, nAdvice);
+    }
+
+    /**	Read all of a chunk into memory, reporting progress
+    *	@param	chunk Chunk to read
+    *	@param	fnProgress Function called with bytes read after each part of chunk
+    */
+    void Populate(const Chunk& chunk, const std::function<void(size_t)>& fnProgress)
+    {
+        Advise(chunk, MADV_WILLNEED);
+        size_t nPage = sysconf(_SC_PAGESIZE);
+        bool bPopulateRead = true;
+        for(size_t nOffset = 0; nOffset < chunk.size; nOffset += MMAP_POPULATE_CHUNK)
+        {
+            Chunk part;
+            part.data = chunk.data + nOffset;
+            part.size = std::min((size_t)MMAP_POPULATE_CHUNK, chunk.size - nOffset);
+            if(!bPopulateRead || Advise(part, MADV_POPULATE_READ) != 0)
+            {
+                bPopulateRead = false;
+                for(size_t nPos = 0; nPos < part.size; nPos += nPage)
+                    (void)*(volatile const uint8_t*)(part.data + nPos); // Fault page in
+            }
+            fnProgress(part.size);
+        }
+    }
+
+    /**	Create fluidsynth samples pointing into mapped sample data
+    *	@retval	bool True on success, false if soundfont must be loaded by another loader
+    */
+    bool ReadSamples()
+    {
+        const Chunk& shdr = m_mapChunks["shdr"];
+        const Chunk& smpl = m_mapChunks["smpl"];
+        auto itSm24 = m_mapChunks.find("sm24");
+        size_t nFrames = smpl.size / 2;
+        const uint8_t* pSm24 = (itSm24 != m_mapChunks.end() && itSm24->second.size >= nFrames) ? itSm24->second.data : NULL;
+        unsigned int nSamples = shdr.size / 46 - 1;
+        m_vSamples.assign(nSamples, NULL);
+        for(unsigned int nSample = 0; nSample < nSamples; ++nSample)
+        {
+            const uint8_t* pRecord = shdr.data + nSample * 46;
+            uint32_t nStart = Get32(pRecord + 20);
+            uint32_t nEnd = Get32(pRecord + 24);
+            uint32_t nLoopStart = Get32(pRecord + 28);
+            uint32_t nLoopEnd = Get32(pRecord + 32);
+            uint32_t nRate = Get32(pRecord + 36);
+            uint8_t nPitch = pRecord[40];
+            int8_t nCorrection = (int8_t)pRecord[41];
+            uint16_t nType = Get16(pRecord + 44);
+            if(nType & 0x8000)
+                return false; // ROM sample
+            if(nType & 0x10)
+                return false; // Compressed sample
+            if(nEnd <= nStart || nEnd > nFrames || !nRate)
+                continue; // Invalid sample - zones using it are ignored
+            fluid_sample_t* pSample = new_fluid_sample();
+            if(!pSample)
+                return false;
+            m_vSamples[nSample] = pSample;
+            char acName[21];
+            memcpy(acName, pRecord, 20);
+            acName[20] = 0;
+            fluid_sample_set_name(pSample, acName);
+            if(fluid_sample_set_sound_data(pSample, (short*)(smpl.data + nStart * 2), pSm24 ? (char*)(pSm24 + nStart) : NULL, nEnd - nStart, nRate, 0) != FLUID_OK)
+                return false;
+            nLoopStart = std::min(std::max(nLoopStart, nStart), nEnd) - nStart;
+            nLoopEnd = std::min(std::max(nLoopEnd, nStart), nEnd) - nStart;
+            fluid_sample_set_loop(pSample, nLoopStart, nLoopEnd);
+            fluid_sample_set_pitch(pSample, (nPitch > 127) ? 60 : nPitch, nCorrection);
+        }
+        return true;
+    }
+
+    /**	Parse instruments
+    *	@retval	bool True on success
+    */
+    bool ReadInstruments()
+    {
+        const Chunk& inst = m_mapChunks["inst"];
+        unsigned int nInstruments = inst.size / 22 - 1;
+        m_vInstruments.resize(nInstruments);
+        for(unsigned int nInst = 0; nInst < nInstruments; ++nInst)
+            if(!ReadZones(m_mapChunks["ibag"], m_mapChunks["imod"], m_mapChunks["igen"], Get16(inst.data + nInst * 22 + 20), Get16(inst.data + nInst * 22 + 42), GEN_SAMPLE, m_vSamples.size(), m_vInstruments[nInst]))
+                return false;
+        return true;
+    }
+
+    /**	Parse presets
+    *	@retval	bool True on success
+    */
+    bool ReadPresets()
+    {
+        const Chunk& phdr = m_mapChunks["phdr"];
+        unsigned int nPresets = phdr.size / 38 - 1;
+        for(unsigned int nPreset = 0; nPreset < nPresets; ++nPreset)
+        {
+            const uint8_t* pRecord = phdr.data + nPreset * 38;
+            uint32_t nKey = (Get16(pRecord + 22) << 7) + (Get16(pRecord + 20) & 0x7F);
+            if(m_mapPresets.count(nKey))
+                continue; // Duplicate bank:program - first is used
+            MmapPreset* pPreset = new MmapPreset;
+            pPreset->soundfont = this;
+            memcpy(pPreset->name, pRecord, 20);
+            pPreset->name[20] = 0;
+            pPreset->program = Get16(pRecord + 20) & 0x7F;
+            pPreset->bank = Get16(pRecord + 22);
+            m_mapPresets[nKey] = pPreset;
+            if(!ReadZones(m_mapChunks["pbag"], m_mapChunks["pmod"], m_mapChunks["pgen"], Get16(pRecord + 24), Get16(pRecord + 62), GEN_INSTRUMENT, m_vInstruments.size(), pPreset->zones))
+                return false;
+        }
+        return true;
+    }
+
+    /**	Parse the zones of a preset or instrument
+    *	@param	bag Bag chunk (pbag or ibag)
+    *	@param	mod Modulator chunk (pmod or imod)
+    *	@param	gen Generator chunk (pgen or igen)
+    *	@param	nFirst Index of first bag
+    *	@param	nEnd Index of bag after last (first bag of next record)
+    *	@param	nLinkGen Generator linking zone to instrument or sample
+    *	@param	nLinkCount Quantity of instruments or samples that may be linked
+    *	@param	vZones Vector to populate with zones
+    *	@retval	bool True on success
+    */
+    bool ReadZones(const Chunk& bag, const Chunk& mod, const Chunk& gen, unsigned int nFirst, unsigned int nEnd, uint16_t nLinkGen, size_t nLinkCount, std::vector<MmapZone>& vZones)
+    {
+        size_t nBags = bag.size / 4, nMods = mod.size / 10, nGens = gen.size / 4;
+        if(nFirst > nEnd || nEnd >= nBags)
+            return false;
+        for(unsigned int nBag = nFirst; nBag < nEnd; ++nBag)
+        {
+            MmapZone zone;
+            unsigned int nGenEnd = std::min((size_t)Get16(bag.data + nBag * 4 + 4), nGens);
+            for(unsigned int nGen = Get16(bag.data + nBag * 4); nGen < nGenEnd; ++nGen)
+            {
+                uint16_t nOper = Get16(gen.data + nGen * 4);
+                const uint8_t* pAmount = gen.data + nGen * 4 + 2;
+                if(nOper == nLinkGen)
+                {
+                    if(Get16(pAmount) < nLinkCount)
+                        zone.index = Get16(pAmount);
+                    break; // Link is the last generator of a zone
+                }
+                if(nOper == GEN_KEYRANGE)
+                {
+                    zone.keyLo = pAmount[0];
+                    zone.keyHi = pAmount[1];
+                    zone.keyRange = true;
+                }
+                else if(nOper == GEN_VELRANGE)
+                {
+                    zone.velLo = pAmount[0];
+                    zone.velHi = pAmount[1];
+                    zone.velRange = true;
+                }
+                else if(nOper < MMAP_GEN_COUNT && nOper != GEN_INSTRUMENT && nOper != GEN_SAMPLE)
+                {
+                    zone.gen[nOper] = (int16_t)Get16(pAmount);
+                    zone.set |= 1ULL << nOper;
+                }
+            }
+            bool bLinked = nGenEnd > Get16(bag.data + nBag * 4) && Get16(gen.data + (nGenEnd - 1) * 4) == nLinkGen;
+            if(zone.index < 0 && (bLinked || nBag != nFirst))
+                continue; // Only the first zone may be global - ignore zones with an invalid or missing link
+            unsigned int nModEnd = std::min((size_t)Get16(bag.data + nBag * 4 + 6), nMods);
+            for(unsigned int nMod = Get16(bag.data + nBag * 4 + 2); nMod < nModEnd && zone.mods.size() < MMAP_ZONE_MODS; ++nMod)
+            {
+                const uint8_t* pRecord = mod.data + nMod * 10;
+                uint16_t nSource = Get16(pRecord);
+                uint16_t nDest = Get16(pRecord + 2);
+                uint16_t nAmountSource = Get16(pRecord + 6);
+                if((nDest & 0x8000) || nDest >= MMAP_GEN_COUNT || Get16(pRecord + 8) != 0 || !IsValidSource(nSource) || !IsValidSource(nAmountSource))
+                    continue; // Linked modulators and transforms are not supported (as fluidsynth)
+                MmapMod zoneMod;
+                zoneMod.mod = new_fluid_mod();
+                if(!zoneMod.mod)
+                    return false;
+                zoneMod.amount = (int16_t)Get16(pRecord + 4);
+                fluid_mod_set_source1(zoneMod.mod, nSource & 0x7F, GetModFlags(nSource));
+                fluid_mod_set_source2(zoneMod.mod, nAmountSource & 0x7F, GetModFlags(nAmountSource));
+                fluid_mod_set_dest(zoneMod.mod, nDest);
+                fluid_mod_set_amount(zoneMod.mod, zoneMod.amount);
+                zone.mods.push_back(zoneMod);
+            }
+            vZones.push_back(zone);
+        }
+        return true;
+    }
+
+    /**	Check if a modulator source is supported
+    *	@param	nSource SoundFont modulator source enumerator
+    *	@retval	bool True if valid
+    */
+    static bool IsValidSource(uint16_t nSource)
+    {
+        if((nSource >> 10) > 3)
+            return false; // Unknown curve type
+        unsigned int nIndex = nSource & 0x7F;
+        if(nSource & 0x80)
+            return nIndex != 0 && nIndex != 6 && nIndex != 32 && nIndex != 38 && (nIndex < 98 || nIndex > 101) && nIndex < 120; // CCs that may not be modulator sources
+        return nIndex == 0 || nIndex == 2 || nIndex == 3 || nIndex == 10 || nIndex == 13 || nIndex == 14 || nIndex == 16;
+    }
+
+    /**	Convert a SoundFont modulator source enumerator to fluidsynth modulator flags
+    *	@param	nSource SoundFont modulator source enumerator
+    *	@retval	int fluidsynth flags [fluid_mod_flags]
+    */
+    static int GetModFlags(uint16_t nSource)
+    {
+        static const int anCurve[] = {FLUID_MOD_LINEAR, FLUID_MOD_CONCAVE, FLUID_MOD_CONVEX, FLUID_MOD_SWITCH};
+        return ((nSource & 0x80) ? FLUID_MOD_CC : FLUID_MOD_GC)
+            | ((nSource & 0x100) ? FLUID_MOD_NEGATIVE : FLUID_MOD_POSITIVE)
+            | ((nSource & 0x200) ? FLUID_MOD_BIPOLAR : FLUID_MOD_UNIPOLAR)
+            | anCurve[(nSource >> 10) & 3];
+    }
+
+    static void FreeMods(std::vector<MmapZone>& vZones)
+    {
+        for(auto itZone = vZones.begin(); itZone != vZones.end(); ++itZone)
+            for(auto itMod = itZone->mods.begin(); itMod != itZone->mods.end(); ++itMod)
+                delete_fluid_mod(itMod->mod);
+    }
+
+    /**	Check if key and velocity are within a zone's range
+    *	@param	zone Zone to check
+    *	@param	pGlobal Global zone providing default range (may be NULL)
+    *	@param	nKey MIDI note
+    *	@param	nVelocity MIDI velocity
+    *	@retval	bool True if in range
+    */
+    static bool IsInRange(const MmapZone& zone, const MmapZone* pGlobal, int nKey, int nVelocity)
+    {
+        const MmapZone& keyZone = (!zone.keyRange && pGlobal) ? *pGlobal : zone;
+        const MmapZone& velZone = (!zone.velRange && pGlobal) ? *pGlobal : zone;
+        return nKey >= keyZone.keyLo && nKey <= keyZone.keyHi && nVelocity >= velZone.velLo && nVelocity <= velZone.velHi;
+    }
+
+    /**	Add modulators of a zone and its global zone to a voice
+    *	@param	pVoice Voice
+    *	@param	pGlobal Global zone (may be NULL)
+    *	@param	zone Zone whose modulators replace identical global modulators
+    *	@param	nMode How to add modulators [FLUID_VOICE_OVERWRITE | FLUID_VOICE_ADD]
+    */
+    static void AddMods(fluid_voice_t* pVoice, const MmapZone* pGlobal, const MmapZone& zone, int nMode)
+    {
+        const MmapMod* apMods[MMAP_ZONE_MODS * 2];
+        unsigned int nCount = 0;
+        if(pGlobal)
+            for(auto it = pGlobal->mods.begin(); it != pGlobal->mods.end(); ++it)
+                apMods[nCount++] = &(*it);
+        unsigned int nGlobalCount = nCount;
+        for(auto it = zone.mods.begin(); it != zone.mods.end(); ++it)
+        {
+            for(unsigned int nIndex = 0; nIndex < nGlobalCount; ++nIndex)
+                if(apMods[nIndex] && fluid_mod_test_identity(apMods[nIndex]->mod, it->mod))
+                    apMods[nIndex] = NULL;
+            apMods[nCount++] = &(*it);
+        }
+        // Zero amount instrument modulators still replace default modulators
+        for(unsigned int nIndex = 0; nIndex < nCount; ++nIndex)
+            if(apMods[nIndex] && (apMods[nIndex]->amount || nMode == FLUID_VOICE_OVERWRITE))
+                fluid_voice_add_mod(pVoice, apMods[nIndex]->mod, nMode);
+    }
+
+    /**	Check if a preset generator may be added to an instrument generator */
+    static bool IsPresetGen(unsigned int nGen)
+    {
+        switch(nGen)
+        {
+            case 0: case 1: case 2: case 3: case 4: case 12: case 45: case 50: // Sample offsets
+            case 46: case 47: case 54: case 57: case 58: // Key, velocity, sample mode, exclusive class, root key
+                return false;
+        }
+        return true;
+    }
+
+    /**	Record a voice started by this soundfont
+    *	@param	pVoice Voice
+    *	@note	Called from audio thread. Voice pool is fixed so each voice uses one slot (reused by later notes).
+    */
+    void Track(fluid_voice_t* pVoice)
+    {
+        unsigned int nId = fluid_voice_get_id(pVoice);
+        size_t nSlot = ((uintptr_t)pVoice >> 4) & (MMAP_VOICE_SLOTS - 1);
+        for(unsigned int nProbe = 0; nProbe < MMAP_VOICE_SLOTS; ++nProbe, nSlot = (nSlot + 1) & (MMAP_VOICE_SLOTS - 1))
+        {
+            fluid_voice_t* pSlotVoice = m_aVoices[nSlot].voice.load(std::memory_order_relaxed);
+            if(pSlotVoice && pSlotVoice != pVoice && fluid_voice_is_playing(pSlotVoice))
+                continue;
+            m_aVoices[nSlot].id.store(nId, std::memory_order_relaxed);
+            m_aVoices[nSlot].voice.store(pVoice, std::memory_order_release);
+            return;
+        }
+    }
+
+    /**	Check if any voice started by this soundfont is still playing
+    *	@retval	bool True if samples are in use
+    */
+    bool IsBusy()
+    {
+        for(unsigned int nSlot = 0; nSlot < MMAP_VOICE_SLOTS; ++nSlot)
+        {
+            fluid_voice_t* pVoice = m_aVoices[nSlot].voice.load(std::memory_order_acquire);
+            if(pVoice && fluid_voice_is_playing(pVoice) && fluid_voice_get_id(pVoice) == m_aVoices[nSlot].id.load(std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    // fluidsynth soundfont callbacks
+    static const char* OnGetName(fluid_sfont_t* pSoundfont)
+    {
+        return ((MmapSoundfont*)fluid_sfont_get_data(pSoundfont))->m_sName.c_str();
+    }
+
+    static fluid_preset_t* OnGetPreset(fluid_sfont_t* pSoundfont, int nBank, int nProgram)
+    {
+        MmapSoundfont* pThis = (MmapSoundfont*)fluid_sfont_get_data(pSoundfont);
+        auto it = pThis->m_mapPresets.find((nBank << 7) + nProgram);
+        return (it == pThis->m_mapPresets.end()) ? NULL : it->second->preset;
+    }
+
+    static void OnIterationStart(fluid_sfont_t* pSoundfont)
+    {
+        MmapSoundfont* pThis = (MmapSoundfont*)fluid_sfont_get_data(pSoundfont);
+        pThis->m_itIteration = pThis->m_mapPresets.begin();
+    }
+
+    static fluid_preset_t* OnIterationNext(fluid_sfont_t* pSoundfont)
+    {
+        MmapSoundfont* pThis = (MmapSoundfont*)fluid_sfont_get_data(pSoundfont);
+        if(pThis->m_itIteration == pThis->m_mapPresets.end())
+            return NULL;
+        return (pThis->m_itIteration++)->second->preset;
+    }
+
+    static int OnFree(fluid_sfont_t* pSoundfont)
+    {
+        MmapSoundfont* pThis = (MmapSoundfont*)fluid_sfont_get_data(pSoundfont);
+        if(pThis->IsBusy())
+            return FLUID_FAILED; // Releasing voices still read mapped samples - fluidsynth retries later
+        delete pThis;
+        delete_fluid_sfont(pSoundfont);
+        return FLUID_OK;
+    }
+
+    // fluidsynth preset callbacks
+    static const char* OnGetPresetName(fluid_preset_t* pPreset)
+    {
+        return ((MmapPreset*)fluid_preset_get_data(pPreset))->name;
+    }
+
+    static int OnGetBank(fluid_preset_t* pPreset)
+    {
+        return ((MmapPreset*)fluid_preset_get_data(pPreset))->bank;
+    }
+
+    static int OnGetProgram(fluid_preset_t* pPreset)
+    {
+        return ((MmapPreset*)fluid_preset_get_data(pPreset))->program;
+    }
+
+    static void OnFreePreset(fluid_preset_t*)
+    {
+        // Presets are freed with their soundfont
+    }
+
+    /**	Start voices for a note, as fluidsynth's default soundfont (SoundFont 2.01 section 9.4)
+    *	@note	Called from audio thread - must not allocate
+    */
+    static int OnNoteon(fluid_preset_t* pFluidPreset, fluid_synth_t* pSynth, int nChannel, int nKey, int nVelocity)
+    {
+        MmapPreset* pPreset = (MmapPreset*)fluid_preset_get_data(pFluidPreset);
+        MmapSoundfont* pThis = pPreset->soundfont;
+        const MmapZone* pGlobal = (!pPreset->zones.empty() && pPreset->zones[0].index < 0) ? &pPreset->zones[0] : NULL;
+        for(auto itZone = pPreset->zones.begin(); itZone != pPreset->zones.end(); ++itZone)
+        {
+            if(itZone->index < 0 || !IsInRange(*itZone, pGlobal, nKey, nVelocity))
+                continue;
+            const std::vector<MmapZone>& vInstZones = pThis->m_vInstruments[itZone->index];
+            const MmapZone* pInstGlobal = (!vInstZones.empty() && vInstZones[0].index < 0) ? &vInstZones[0] : NULL;
+            for(auto itInst = vInstZones.begin(); itInst != vInstZones.end(); ++itInst)
+            {
+                if(itInst->index < 0 || !pThis->m_vSamples[itInst->index] || !IsInRange(*itInst, pInstGlobal, nKey, nVelocity))
+                    continue;
+                fluid_voice_t* pVoice = fluid_synth_alloc_voice(pSynth, pThis->m_vSamples[itInst->index], nChannel, nKey, nVelocity);
+                if(!pVoice)
+                    return FLUID_FAILED;
+                // Instrument generators replace defaults, local replacing global
+                for(unsigned int nGen = 0; nGen < MMAP_GEN_COUNT; ++nGen)
+                {
+                    if(itInst->set & (1ULL << nGen))
+                        fluid_voice_gen_set(pVoice, nGen, itInst->gen[nGen]);
+                    else if(pInstGlobal && (pInstGlobal->set & (1ULL << nGen)))
+                        fluid_voice_gen_set(pVoice, nGen, pInstGlobal->gen[nGen]);
+                }
+                AddMods(pVoice, pInstGlobal, *itInst, FLUID_VOICE_OVERWRITE);
+                // Preset generators are added to instrument generators
+                for(unsigned int nGen = 0; nGen < MMAP_GEN_COUNT; ++nGen)
+                {
+                    if(!IsPresetGen(nGen))
+                        continue;
+                    if(itZone->set & (1ULL << nGen))
+                        fluid_voice_gen_incr(pVoice, nGen, itZone->gen[nGen]);
+                    else if(pGlobal && (pGlobal->set & (1ULL << nGen)))
+                        fluid_voice_gen_incr(pVoice, nGen, pGlobal->gen[nGen]);
+                }
+                AddMods(pVoice, pGlobal, *itZone, FLUID_VOICE_ADD);
+                fluid_synth_start_voice(pSynth, pVoice);
+                pThis->Track(pVoice);
+            }
+        }
+        return FLUID_OK;
+    }
+
+    static const uint16_t GEN_KEYRANGE = 43; // Zone key range
+    static const uint16_t GEN_VELRANGE = 44; // Zone velocity range
+    static const uint16_t GEN_INSTRUMENT = 41; // Preset generator referencing an instrument
+    static const uint16_t GEN_SAMPLE = 53; // Instrument generator referencing a sample
+
+    std::string m_sName; // Path to soundfont (name reported to fluidsynth)
+    const uint8_t* m_pData = NULL; // Mapped file
+    size_t m_nSize = 0; // Size of mapped file
+    std::map<std::string, Chunk> m_mapChunks; // Chunks within mapped file, indexed by id
+    std::vector<fluid_sample_t*> m_vSamples; // fluidsynth samples indexed by sample header (NULL if invalid)
+    std::vector<std::vector<MmapZone>> m_vInstruments; // Zones of each instrument (first may be global)
+    std::map<uint32_t, MmapPreset*> m_mapPresets; // Presets indexed by (bank << 7) + program
+    std::map<uint32_t, MmapPreset*>::iterator m_itIteration; // Preset iteration position
+    fluid_sfont_t* m_pSoundfont = NULL; // fluidsynth soundfont
+    MmapVoice m_aVoices[MMAP_VOICE_SLOTS]; // Voices started by soundfont (to defer free whilst in use)
+};
+
+/**	MmapSoundfontLoader class provides a fluidsynth soundfont loader that maps soundfont files */
+class MmapSoundfontLoader
+{
+public:
+    /**	Create a fluidsynth soundfont loader to add to a synth with fluid_synth_add_sfloader
+    *	@retval	fluid_sfloader_t* Pointer to loader (freed by synth) or NULL on failure
+    *	@note	Add after other loaders - fluidsynth tries the most recently added first and falls back to the others if this declines a file
+    *	@note	This object must outlive the synth
+    */
+    fluid_sfloader_t* NewSfloader()
+    {
+        fluid_sfloader_t* pLoader = new_fluid_sfloader(OnLoad, OnFreeLoader);
+        if(pLoader)
+            fluid_sfloader_set_data(pLoader, this);
+        return pLoader;
+    }
+
+    /**	Set mode of loading
+    *	@param	nMode Load mode [MMAP_MODE]
+    */
+    void SetMode(int nMode)
+    {
+        m_nMode.store(nMode, std::memory_order_relaxed);
+    }
+
+    /**	Get mode of loading
+    *	@retval	int Load mode [MMAP_MODE]
+    */
+    int GetMode()
+    {
+        return m_nMode.load(std::memory_order_relaxed);
+    }
+
+    /**	Set function called with bytes of sample data read into memory whilst populating
+    *	@param	fnProgress Function to call
+    *	@note	Call before adding loader to synth
+    */
+    void SetProgress(std::function<void(size_t)> fnProgress)
+    {
+        m_fnProgress = fnProgress;
+    }
+
+private:
+    static fluid_sfont_t* OnLoad(fluid_sfloader_t* pLoader, const char* sFilename)
+    {
+        MmapSoundfontLoader* pThis = (MmapSoundfontLoader*)fluid_sfloader_get_data(pLoader);
+        int nMode = pThis->GetMode();
+        if(nMode == MMAP_OFF)
+            return NULL;
+        MmapSoundfont* pSoundfont = new MmapSoundfont;
+        if(!pSoundfont->Load(sFilename, nMode, pThis->m_fnProgress))
+        {
+            if(pSoundfont->GetSoundfont())
+                delete_fluid_sfont(pSoundfont->GetSoundfont());
+            delete pSoundfont;
+            return NULL; // Next loader will try
+        }
+        return pSoundfont->GetSoundfont();
+    }
+
+    static void OnFreeLoader(fluid_sfloader_t* pLoader)
+    {
+        delete_fluid_sfloader(pLoader);
+    }
+
+    std::atomic<int> m_nMode = {MMAP_POPULATE}; // Load mode [MMAP_MODE]
+    std::function<void(size_t)> m_fnProgress; // Called with bytes populated
+};
@@ -0,0 +1,444 @@
+/*	Soundfont slimming
+
+	Writes a copy of a SoundFont 2 file containing only the presets that are used, and the instruments and samples they reference.
+	Large General MIDI soundfonts typically have a few of their programs used by presets so most sample data need never be loaded.
+	Slimmed copies are kept in SF_SLIM_ROOT with the same relative path as the soundfont in the sf2 directory.
+	Compressed (SF3) soundfonts are not slimmed.
+*/
+
+#pragma once
+
+#include <algorithm> // provides std::min
+#include <cstdint> // provides fixed size integers
+#include <cstdio> // provides FILE, rename
+#include <cstring> // provides memcmp, memcpy
+#include <map> // provides std::map
+#include <set> // provides std::set
+#include <string> // provides std::string
+#include <vector> // provides std::vector
+#include <sys/stat.h> // provides stat
+
+#define SF_SLIM_ROOT "sfslim/" // Directory holding slimmed soundfonts
+#define SF_SLIM_SAMPLE_PAD 46 // Zero sample points required after each sample
+
+/**	Counts of soundfont content before and after slimming */
+struct SlimStats
+{
+    size_t size = 0; // Size of original file in bytes
+    size_t slimSize = 0; // Size of slimmed file in bytes
+    unsigned int presets = 0; // Presets in original
+    unsigned int slimPresets = 0; // Presets in slimmed copy
+    unsigned int instruments = 0; // Instruments in original
+    unsigned int slimInstruments = 0; // Instruments in slimmed copy
+    unsigned int samples = 0; // Samples in original
+    unsigned int slimSamples = 0; // Samples in slimmed copy
+};
+
+/**	SoundfontSlimmer class writes soundfonts reduced to a set of presets */
+class SoundfontSlimmer
+{
+public:
+    /**	Get path of slimmed copy of a soundfont
+    *	@param	sRelative Path of soundfont relative to sf2 directory
+    *	@retval	string Path to slimmed copy
+    */
+    static std::string GetSlimPath(std::string sRelative)
+    {
+        return SF_SLIM_ROOT + sRelative;
+    }
+
+    /**	Check if a slimmed copy exists and is at least as new as its soundfont
+    *	@param	sPath Path to soundfont
+    *	@param	sSlimPath Path to slimmed copy
+    *	@retval	bool True if slimmed copy may be used
+    */
+    static bool IsCurrent(std::string sPath, std::string sSlimPath)
+    {
+        struct stat fileStat, slimStat;
+        if(stat(sSlimPath.c_str(), &slimStat) != 0 || stat(sPath.c_str(), &fileStat) != 0)
+            return false;
+        return slimStat.st_mtime >= fileStat.st_mtime;
+    }
+
+    /**	Write slimmed copy of a soundfont
+    *	@param	sSource Path to soundfont
+    *	@param	sDest Path to write slimmed copy to (replaced only on success)
+    *	@param	setPrograms Presets to keep, each as (bank << 7) + program
+    *	@retval	bool True on success
+    */
+    bool Slim(std::string sSource, std::string sDest, const std::set<uint32_t>& setPrograms)
+    {
+        m_stats = SlimStats();
+        m_sError = "";
+        if(!Read(sSource))
+            return false;
+        if(!Select(setPrograms))
+            return false;
+        return Write(sDest);
+    }
+
+    /**	Get reason slimming failed
+    *	@retval	string Description of fault (empty on success)
+    */
+    std::string GetError()
+    {
+        return m_sError;
+    }
+
+    /**	Get content counts of last soundfont slimmed */
+    const SlimStats& GetStats()
+    {
+        return m_stats;
+    }
+
+private:
+    bool Fail(std::string sError)
+    {
+        m_sError = sError;
+        return false;
+    }
+
+    static uint16_t Get16(const std::vector<uint8_t>& vData, size_t nOffset)
+    {
+        return vData[nOffset] | (vData[nOffset + 1] << 8);
+    }
+
+    static uint32_t Get32(const std::vector<uint8_t>& vData, size_t nOffset)
+    {
+        return Get16(vData, nOffset) | ((uint32_t)Get16(vData, nOffset + 2) << 16);
+    }
+
+    static void Put16(std::vector<uint8_t>& vData, size_t nOffset, uint16_t nValue)
+    {
+        vData[nOffset] = nValue & 0xFF;
+        vData[nOffset + 1] = nValue >> 8;
+    }
+
+    static void Put32(std::vector<uint8_t>& vData, size_t nOffset, uint32_t nValue)
+    {
+        Put16(vData, nOffset, nValue & 0xFFFF);
+        Put16(vData, nOffset + 2, nValue >> 16);
+    }
+
+    /**	Read soundfont chunks into memory
+    *	@param	sPath Path to soundfont
+    *	@retval	bool True on success
+    */
+    bool Read(std::string sPath)
+    {
+        FILE* pFile = fopen(sPath.c_str(), "rb");
+        if(!pFile)
+            return Fail("Cannot open " + sPath);
+        std::vector<uint8_t> vFile;
+        uint8_t acBuffer[65536];
+        size_t nRead;
+        while((nRead = fread(acBuffer, 1, sizeof(acBuffer), pFile)) > 0)
+            vFile.insert(vFile.end(), acBuffer, acBuffer + nRead);
+        fclose(pFile);
+        m_stats.size = vFile.size();
+        if(vFile.size() < 12 || memcmp(vFile.data(), "RIFF", 4) != 0 || memcmp(vFile.data() + 8, "sfbk", 4) != 0)
+            return Fail("Not a soundfont");
+        // Sizes are summed in 64 bits so that corrupt sizes cannot wrap on 32-bit systems
+        size_t nRiffEnd = std::min((uint64_t)vFile.size(), (uint64_t)Get32(vFile, 4) + 8);
+        m_mapChunks.clear();
+        // Top level LISTs (INFO, sdta, pdta) each hold sub-chunks
+        for(size_t nPos = 12; nPos + 12 <= nRiffEnd;)
+        {
+            size_t nListEnd = std::min((uint64_t)nRiffEnd, (uint64_t)nPos + 8 + Get32(vFile, nPos + 4));
+            if(nListEnd <= nPos)
+                return Fail("Corrupt chunk");
+            std::string sList((const char*)vFile.data() + nPos + 8, 4);
+            if(sList == "INFO")
+                m_vInfo.assign(vFile.begin() + nPos + 12, vFile.begin() + nListEnd);
+            for(size_t nSub = nPos + 12; nSub + 8 <= nListEnd;)
+            {
+                uint32_t nSize = Get32(vFile, nSub + 4);
+                if((uint64_t)nSub + 8 + nSize > nListEnd)
+                    return Fail("Corrupt chunk");
+                std::string sId((const char*)vFile.data() + nSub, 4);
+                m_mapChunks[sId].assign(vFile.begin() + nSub + 8, vFile.begin() + nSub + 8 + nSize);
+                nSub += 8 + nSize + (nSize & 1);
+            }
+            nPos = nListEnd + (nListEnd & 1);
+        }
+        const char* asRequired[] = {"smpl", "phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr"};
+        const unsigned int anRecord[] = {2, 38, 4, 10, 4, 22, 4, 10, 4, 46};
+        for(unsigned int nIndex = 0; nIndex < 10; ++nIndex)
+        {
+            auto it = m_mapChunks.find(asRequired[nIndex]);
+            if(it == m_mapChunks.end() || it->second.size() % anRecord[nIndex] || it->second.size() < anRecord[nIndex]) // Each list ends with a terminal record
+                return Fail(std::string("Missing or corrupt ") + asRequired[nIndex]);
+        }
+        m_stats.presets = m_mapChunks["phdr"].size() / 38 - 1;
+        m_stats.instruments = m_mapChunks["inst"].size() / 22 - 1;
+        m_stats.samples = m_mapChunks["shdr"].size() / 46 - 1;
+        return true;
+    }
+
+    /**	Find presets to keep and the instruments and samples they use
+    *	@param	setPrograms Presets to keep, each as (bank << 7) + program
+    *	@retval	bool True if at least one preset is kept
+    */
+    bool Select(const std::set<uint32_t>& setPrograms)
+    {
+        std::vector<uint8_t>& vPhdr = m_mapChunks["phdr"];
+        std::vector<uint8_t>& vPbag = m_mapChunks["pbag"];
+        std::vector<uint8_t>& vPgen = m_mapChunks["pgen"];
+        std::vector<uint8_t>& vInst = m_mapChunks["inst"];
+        std::vector<uint8_t>& vIbag = m_mapChunks["ibag"];
+        std::vector<uint8_t>& vIgen = m_mapChunks["igen"];
+        std::vector<uint8_t>& vShdr = m_mapChunks["shdr"];
+        m_vPresets.clear();
+        m_setInstruments.clear();
+        m_setSamples.clear();
+        for(unsigned int nPreset = 0; nPreset < m_stats.presets; ++nPreset)
+        {
+            size_t nRecord = nPreset * 38;
+            uint16_t nProgram = Get16(vPhdr, nRecord + 20);
+            uint16_t nBank = Get16(vPhdr, nRecord + 22);
+            if(setPrograms.count(((uint32_t)nBank << 7) + nProgram))
+                m_vPresets.push_back(nPreset);
+        }
+        if(m_vPresets.empty())
+            return Fail("No presets used");
+        for(unsigned int nPreset : m_vPresets)
+            for(unsigned int nBag = Get16(vPhdr, nPreset * 38 + 24); nBag < Get16(vPhdr, nPreset * 38 + 62) && nBag * 4 + 8 <= vPbag.size(); ++nBag)
+                for(unsigned int nGen = Get16(vPbag, nBag * 4); nGen < Get16(vPbag, nBag * 4 + 4); ++nGen)
+                    if(nGen * 4 + 4 <= vPgen.size() && Get16(vPgen, nGen * 4) == GEN_INSTRUMENT && Get16(vPgen, nGen * 4 + 2) < m_stats.instruments)
+                        m_setInstruments.insert(Get16(vPgen, nGen * 4 + 2));
+        for(unsigned int nInst : m_setInstruments)
+            for(unsigned int nBag = Get16(vInst, nInst * 22 + 20); nBag < Get16(vInst, nInst * 22 + 42) && nBag * 4 + 8 <= vIbag.size(); ++nBag)
+                for(unsigned int nGen = Get16(vIbag, nBag * 4); nGen < Get16(vIbag, nBag * 4 + 4); ++nGen)
+                    if(nGen * 4 + 4 <= vIgen.size() && Get16(vIgen, nGen * 4) == GEN_SAMPLE && Get16(vIgen, nGen * 4 + 2) < m_stats.samples)
+                        m_setSamples.insert(Get16(vIgen, nGen * 4 + 2));
+        // Keep both channels of stereo samples
+        std::vector<unsigned int> vPending(m_setSamples.begin(), m_setSamples.end());
+        while(!vPending.empty())
+        {
+            unsigned int nSample = vPending.back();
+            vPending.pop_back();
+            uint16_t nType = Get16(vShdr, nSample * 46 + 44);
+            if(nType & SAMPLE_COMPRESSED)
+                return Fail("Compressed (SF3) soundfont");
+            uint16_t nLink = Get16(vShdr, nSample * 46 + 42);
+            if((nType & (SAMPLE_RIGHT | SAMPLE_LEFT | SAMPLE_LINKED)) && nLink < m_stats.samples && m_setSamples.insert(nLink).second)
+                vPending.push_back(nLink);
+        }
+        return true;
+    }
+
+    /**	Write slimmed soundfont to temporary file then rename
+    *	@param	sDest Path to slimmed copy
+    *	@retval	bool True on success
+    */
+    bool Write(std::string sDest)
+    {
+        std::vector<uint8_t>& vPhdr = m_mapChunks["phdr"];
+        std::vector<uint8_t>& vPbag = m_mapChunks["pbag"];
+        std::vector<uint8_t>& vPmod = m_mapChunks["pmod"];
+        std::vector<uint8_t>& vPgen = m_mapChunks["pgen"];
+        std::vector<uint8_t>& vInst = m_mapChunks["inst"];
+        std::vector<uint8_t>& vIbag = m_mapChunks["ibag"];
+        std::vector<uint8_t>& vImod = m_mapChunks["imod"];
+        std::vector<uint8_t>& vIgen = m_mapChunks["igen"];
+        std::vector<uint8_t>& vShdr = m_mapChunks["shdr"];
+        std::vector<uint8_t>& vSmpl = m_mapChunks["smpl"];
+        auto itSm24 = m_mapChunks.find("sm24");
+        bool bSm24 = itSm24 != m_mapChunks.end() && itSm24->second.size() >= vSmpl.size() / 2;
+
+        // Sample data - copy each kept sample followed by zero padding
+        std::map<unsigned int, unsigned int> mapSample; // New sample index indexed by old index
+        std::vector<uint8_t> vNewSmpl, vNewSm24, vNewShdr;
+        size_t nPoints = vSmpl.size() / 2;
+        unsigned int nIndex = 0;
+        for(unsigned int nSample : m_setSamples)
+            mapSample[nSample] = nIndex++;
+        for(unsigned int nSample : m_setSamples)
+        {
+            size_t nRecord = nSample * 46;
+            uint32_t nStart = Get32(vShdr, nRecord + 20);
+            uint32_t nEnd = Get32(vShdr, nRecord + 24);
+            if(nStart > nEnd || nEnd > nPoints)
+                return Fail("Corrupt sample header");
+            uint32_t nNewStart = vNewSmpl.size() / 2;
+            vNewSmpl.insert(vNewSmpl.end(), vSmpl.begin() + nStart * 2, vSmpl.begin() + nEnd * 2);
+            vNewSmpl.insert(vNewSmpl.end(), SF_SLIM_SAMPLE_PAD * 2, 0);
+            if(bSm24)
+            {
+                vNewSm24.insert(vNewSm24.end(), itSm24->second.begin() + nStart, itSm24->second.begin() + nEnd);
+                vNewSm24.insert(vNewSm24.end(), SF_SLIM_SAMPLE_PAD, 0);
+            }
+            vNewShdr.insert(vNewShdr.end(), vShdr.begin() + nRecord, vShdr.begin() + nRecord + 46);
+            size_t nNew = vNewShdr.size() - 46;
+            int64_t nShift = (int64_t)nNewStart - nStart;
+            for(unsigned int nField = 0; nField < 4; ++nField)
+                Put32(vNewShdr, nNew + 20 + nField * 4, (uint32_t)(Get32(vShdr, nRecord + 20 + nField * 4) + nShift)); // Start, end and loop points
+            uint16_t nLink = Get16(vShdr, nRecord + 42);
+            Put16(vNewShdr, nNew + 42, mapSample.count(nLink) ? mapSample[nLink] : 0);
+        }
+        vNewShdr.insert(vNewShdr.end(), vShdr.end() - 46, vShdr.end()); // Terminal record
+
+        // Instruments - copy zones of each kept instrument, remapping samples
+        std::map<unsigned int, unsigned int> mapInstrument; // New instrument index indexed by old index
+        std::vector<uint8_t> vNewInst, vNewIbag, vNewImod, vNewIgen;
+        nIndex = 0;
+        for(unsigned int nInst : m_setInstruments)
+            mapInstrument[nInst] = nIndex++;
+        for(unsigned int nInst : m_setInstruments)
+        {
+            vNewInst.insert(vNewInst.end(), vInst.begin() + nInst * 22, vInst.begin() + nInst * 22 + 22);
+            Put16(vNewInst, vNewInst.size() - 2, vNewIbag.size() / 4);
+            if(!CopyZones(vIbag, vImod, vIgen, Get16(vInst, nInst * 22 + 20), Get16(vInst, nInst * 22 + 42), GEN_SAMPLE, mapSample, vNewIbag, vNewImod, vNewIgen))
+                return false;
+        }
+        AppendTerminal(vInst, 22, vNewInst, vNewIbag.size() / 4);
+        AppendTerminal(vIbag, 4, vNewIbag, vNewIgen.size() / 4, vNewImod.size() / 10);
+        vNewImod.insert(vNewImod.end(), vImod.end() - 10, vImod.end());
+        vNewIgen.insert(vNewIgen.end(), vIgen.end() - 4, vIgen.end());
+
+        // Presets - copy zones of each kept preset, remapping instruments
+        std::vector<uint8_t> vNewPhdr, vNewPbag, vNewPmod, vNewPgen;
+        for(unsigned int nPreset : m_vPresets)
+        {
+            vNewPhdr.insert(vNewPhdr.end(), vPhdr.begin() + nPreset * 38, vPhdr.begin() + nPreset * 38 + 38);
+            Put16(vNewPhdr, vNewPhdr.size() - 14, vNewPbag.size() / 4);
+            if(!CopyZones(vPbag, vPmod, vPgen, Get16(vPhdr, nPreset * 38 + 24), Get16(vPhdr, nPreset * 38 + 62), GEN_INSTRUMENT, mapInstrument, vNewPbag, vNewPmod, vNewPgen))
+                return false;
+        }
+        AppendTerminal(vPhdr, 38, vNewPhdr, vNewPbag.size() / 4, 0, 24);
+        AppendTerminal(vPbag, 4, vNewPbag, vNewPgen.size() / 4, vNewPmod.size() / 10);
+        vNewPmod.insert(vNewPmod.end(), vPmod.end() - 10, vPmod.end());
+        vNewPgen.insert(vNewPgen.end(), vPgen.end() - 4, vPgen.end());
+
+        // Assemble RIFF
+        std::vector<uint8_t> vSdta, vPdta;
+        AppendChunk(vSdta, "smpl", vNewSmpl);
+        if(bSm24)
+            AppendChunk(vSdta, "sm24", vNewSm24);
+        AppendChunk(vPdta, "phdr", vNewPhdr);
+        AppendChunk(vPdta, "pbag", vNewPbag);
+        AppendChunk(vPdta, "pmod", vNewPmod);
+        AppendChunk(vPdta, "pgen", vNewPgen);
+        AppendChunk(vPdta, "inst", vNewInst);
+        AppendChunk(vPdta, "ibag", vNewIbag);
+        AppendChunk(vPdta, "imod", vNewImod);
+        AppendChunk(vPdta, "igen", vNewIgen);
+        AppendChunk(vPdta, "shdr", vNewShdr);
+        std::vector<uint8_t> vBody = {'s', 'f', 'b', 'k'};
+        AppendList(vBody, "INFO", m_vInfo);
+        AppendList(vBody, "sdta", vSdta);
+        AppendList(vBody, "pdta", vPdta);
+        std::vector<uint8_t> vRiff;
+        AppendChunk(vRiff, "RIFF", vBody);
+
+        std::string sTemp = sDest + ".part";
+        FILE* pFile = fopen(sTemp.c_str(), "wb");
+        if(!pFile)
+            return Fail("Cannot write " + sTemp);
+        bool bOk = fwrite(vRiff.data(), vRiff.size(), 1, pFile) == 1;
+        if(fclose(pFile) != 0 || !bOk || rename(sTemp.c_str(), sDest.c_str()) != 0)
+        {
+            remove(sTemp.c_str());
+            return Fail("Cannot write " + sDest);
+        }
+        m_stats.slimSize = vRiff.size();
+        m_stats.slimPresets = m_vPresets.size();
+        m_stats.slimInstruments = m_setInstruments.size();
+        m_stats.slimSamples = m_setSamples.size();
+        return true;
+    }
+
+    /**	Copy the zones (bags) of a preset or instrument with their modulators and generators
+    *	@param	vBag, vMod, vGen Source bag, modulator and generator chunks
+    *	@param	nFirst, nEnd Range of bags to copy
+    *	@param	nLinkGen Generator that references next level (instrument or sample)
+    *	@param	mapLink New index of each referenced item indexed by old index
+    *	@param	vNewBag, vNewMod, vNewGen Destination chunks
+    *	@retval	bool True on success
+    */
+    bool CopyZones(const std::vector<uint8_t>& vBag, const std::vector<uint8_t>& vMod, const std::vector<uint8_t>& vGen,
+        unsigned int nFirst, unsigned int nEnd, uint16_t nLinkGen, std::map<unsigned int, unsigned int>& mapLink,
+        std::vector<uint8_t>& vNewBag, std::vector<uint8_t>& vNewMod, std::vector<uint8_t>& vNewGen)
+    {
+        if(nFirst > nEnd || nEnd * 4 + 4 > vBag.size())
+            return Fail("Corrupt zone");
+        for(unsigned int nBag = nFirst; nBag < nEnd; ++nBag)
+        {
+            unsigned int nGen = Get16(vBag, nBag * 4), nGenEnd = Get16(vBag, nBag * 4 + 4);
+            unsigned int nMod = Get16(vBag, nBag * 4 + 2), nModEnd = Get16(vBag, nBag * 4 + 6);
+            if(nGen > nGenEnd || nGenEnd * 4 > vGen.size() || nMod > nModEnd || nModEnd * 10 > vMod.size())
+                return Fail("Corrupt zone");
+            vNewBag.resize(vNewBag.size() + 4);
+            Put16(vNewBag, vNewBag.size() - 4, vNewGen.size() / 4);
+            Put16(vNewBag, vNewBag.size() - 2, vNewMod.size() / 10);
+            vNewMod.insert(vNewMod.end(), vMod.begin() + nMod * 10, vMod.begin() + nModEnd * 10);
+            for(; nGen < nGenEnd; ++nGen)
+            {
+                vNewGen.insert(vNewGen.end(), vGen.begin() + nGen * 4, vGen.begin() + nGen * 4 + 4);
+                if(Get16(vGen, nGen * 4) == nLinkGen)
+                {
+                    auto it = mapLink.find(Get16(vGen, nGen * 4 + 2));
+                    if(it == mapLink.end())
+                        return Fail("Corrupt zone");
+                    Put16(vNewGen, vNewGen.size() - 2, it->second);
+                }
+            }
+        }
+        return true;
+    }
+
+    /**	Append terminal record of a chunk with its index fields updated
+    *	@param	vChunk Source chunk
+    *	@param	nRecord Size of record
+    *	@param	vNew Destination chunk
+    *	@param	nIndex Value of first index field
+    *	@param	nIndex2 Value of second index field (bags only)
+    *	@param	nOffset Offset of first index field in record (default is the end of a 2 or 4 byte record or after a 20 character name)
+    */
+    void AppendTerminal(const std::vector<uint8_t>& vChunk, size_t nRecord, std::vector<uint8_t>& vNew, uint16_t nIndex, uint16_t nIndex2 = 0, size_t nOffset = 0)
+    {
+        vNew.insert(vNew.end(), vChunk.end() - nRecord, vChunk.end());
+        size_t nBase = vNew.size() - nRecord;
+        if(nRecord == 4)
+        {
+            Put16(vNew, nBase, nIndex);
+            Put16(vNew, nBase + 2, nIndex2);
+        }
+        else
+            Put16(vNew, nBase + (nOffset ? nOffset : 20), nIndex);
+    }
+
+    /**	Append a chunk with header and padding */
+    void AppendChunk(std::vector<uint8_t>& vDest, const char* sId, const std::vector<uint8_t>& vData)
+    {
+        vDest.insert(vDest.end(), sId, sId + 4);
+        vDest.resize(vDest.size() + 4);
+        Put32(vDest, vDest.size() - 4, vData.size());
+        vDest.insert(vDest.end(), vData.begin(), vData.end());
+        if(vData.size() & 1)
+            vDest.push_back(0);
+    }
+
+    /**	Append a LIST chunk */
+    void AppendList(std::vector<uint8_t>& vDest, const char* sType, const std::vector<uint8_t>& vData)
+    {
+        std::vector<uint8_t> vList(sType, sType + 4);
+        vList.insert(vList.end(), vData.begin(), vData.end());
+        AppendChunk(vDest, "LIST", vList);
+    }
+
+    static const uint16_t GEN_INSTRUMENT = 41; // Preset generator referencing an instrument
+    static const uint16_t GEN_SAMPLE = 53; // Instrument generator referencing a sample
+    static const uint16_t SAMPLE_RIGHT = 2; // Sample type flags
+    static const uint16_t SAMPLE_LEFT = 4;
+    static const uint16_t SAMPLE_LINKED = 8;
+    static const uint16_t SAMPLE_COMPRESSED = 16;
+
+    std::map<std::string, std::vector<uint8_t>> m_mapChunks; // Sub-chunks of sdta and pdta indexed by id
+    std::vector<uint8_t> m_vInfo; // Content of INFO list (copied unchanged)
+    std::vector<unsigned int> m_vPresets; // Indices of presets to keep
+    std::set<unsigned int> m_setInstruments; // Indices of instruments to keep
+    std::set<unsigned int> m_setSamples; // Indices of samples to keep
+    SlimStats m_stats; // Content counts
+    std::string m_sError; // Reason slimming failed
+};
@@ -0,0 +1,414 @@
+/*	Synth command queue
+
+	All changes to the synth are posted as commands to a single lock-free queue which is drained by the audio thread at the start of each block.
+	The audio thread is then the only thread that touches the synth so fluidsynth may run with synth.threadsafe-api disabled.
+	Commands that must return a value (e.g. adding a soundfont) block the caller until the audio thread has executed them.
+	UI commands wait for space if the queue is full. MIDI events are dropped and counted instead so that MIDI input is never blocked.
+*/
+
+#pragma once
+
+#include "fluidsynth.h"
+#include "ringbuffer.hpp"
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint8_t
+#include <cstring> // provides memcpy
+#include <unistd.h> // provides usleep
+
+#define SYNTH_QUEUE_SIZE 1024 // Quantity of commands that may be queued between audio blocks
+#define SYNTH_SYSEX_MAX 32 // Largest SysEx message (excluding F0, F7) that may be queued
+
+enum SYNTH_COMMAND
+{
+    SYNTH_NOTE_ON,
+    SYNTH_NOTE_OFF,
+    SYNTH_CC,
+    SYNTH_PROGRAM_CHANGE,
+    SYNTH_PROGRAM_SELECT,
+    SYNTH_PITCH_BEND,
+    SYNTH_CHANNEL_PRESSURE,
+    SYNTH_KEY_PRESSURE,
+    SYNTH_SYSEX,
+    SYNTH_SYSTEM_RESET,
+    SYNTH_ALL_NOTES_OFF,
+    SYNTH_ALL_SOUNDS_OFF,
+    SYNTH_GAIN,
+    SYNTH_REVERB_ON,
+    SYNTH_REVERB_ROOMSIZE,
+    SYNTH_REVERB_DAMP,
+    SYNTH_REVERB_WIDTH,
+    SYNTH_REVERB_LEVEL,
+    SYNTH_CHORUS_ON,
+    SYNTH_CHORUS_NR,
+    SYNTH_CHORUS_LEVEL,
+    SYNTH_CHORUS_SPEED,
+    SYNTH_CHORUS_DEPTH,
+    SYNTH_CHORUS_TYPE,
+    SYNTH_ADD_SFONT,
+    SYNTH_REMOVE_SFONT,
+    SYNTH_CALLBACK
+};
+
+/**	Completion of a command that returns a value */
+struct SynthCompletion
+{
+    std::atomic<bool> done = {false}; // True when command has been executed
+    int result = FLUID_FAILED; // Value returned by command
+};
+
+/**	Command posted to synth */
+struct SynthCommand
+{
+    uint8_t type = 0; // Command type [SYNTH_COMMAND]
+    uint8_t channel = 0; // MIDI channel
+    int param1 = 0; // First integer parameter, e.g. note, controller, program, soundfont id, SysEx length
+    int param2 = 0; // Second integer parameter, e.g. velocity, value, bank << 8 | program
+    double value = 0; // Floating point parameter, e.g. gain, effect parameter
+    void* ptr = NULL; // Pointer parameter, e.g. soundfont, callback data
+    void (*callback)(fluid_synth_t*, void*) = NULL; // Function to call from audio thread (SYNTH_CALLBACK)
+    SynthCompletion* completion = NULL; // Completion to signal after execution (NULL if caller does not wait)
+    uint8_t sysex[SYNTH_SYSEX_MAX]; // SysEx data
+};
+
+/**	SynthCommandQueue class serialises changes to the synth through the audio thread */
+class SynthCommandQueue
+{
+public:
+    /**	Set the synth that commands are applied to
+    *	@param	pSynth Pointer to fluidsynth instance
+    */
+    void SetSynth(fluid_synth_t* pSynth)
+    {
+        m_pSynth = pSynth;
+    }
+
+    /**	Indicate whether an audio thread is draining the queue
+    *	@param	bRunning True when audio thread is calling Process each block
+    *	@note	Whilst not running, Poll and Call execute commands in the calling thread
+    */
+    void SetRunning(bool bRunning)
+    {
+        m_bRunning = bRunning;
+    }
+
+    /**	Post a command
+    *	@param	nType Command type [SYNTH_COMMAND]
+    *	@param	nChannel MIDI channel
+    *	@param	nParam1 First integer parameter
+    *	@param	nParam2 Second integer parameter
+    *	@param	dValue Floating point parameter
+    *	@retval	bool True on success, false if command was dropped
+    *	@note	Waits for space if queue is full and audio thread is running
+    */
+    bool Send(unsigned int nType, unsigned int nChannel = 0, int nParam1 = 0, int nParam2 = 0, double dValue = 0)
+    {
+        SynthCommand command;
+        command.type = nType;
+        command.channel = nChannel;
+        command.param1 = nParam1;
+        command.param2 = nParam2;
+        command.value = dValue;
+        return Push(command);
+    }
+
+    /**	Post a MIDI event
+    *	@param	pEvent Pointer to MIDI event
+    *	@retval	bool True on success, false if event was dropped or not supported
+    *	@note	Does not wait - event is dropped and counted if queue is full so that MIDI input is never blocked
+    */
+    bool HandleMidiEvent(fluid_midi_event_t* pEvent)
+    {
+        SynthCommand command;
+        command.channel = fluid_midi_event_get_channel(pEvent);
+        switch(fluid_midi_event_get_type(pEvent))
+        {
+        case 0x80: //NOTE_OFF
+            command.type = SYNTH_NOTE_OFF;
+            command.param1 = fluid_midi_event_get_key(pEvent);
+            break;
+        case 0x90: //NOTE_ON
+            command.type = SYNTH_NOTE_ON;
+            command.param1 = fluid_midi_event_get_key(pEvent);
+            command.param2 = fluid_midi_event_get_velocity(pEvent);
+            break;
+        case 0xA0: //KEY_PRESSURE
+            command.type = SYNTH_KEY_PRESSURE;
+            command.param1 = fluid_midi_event_get_key(pEvent);
+            command.param2 = fluid_midi_event_get_value(pEvent);
+            break;
+        case 0xB0: //CONTROL_CHANGE
+            command.type = SYNTH_CC;
+            command.param1 = fluid_midi_event_get_control(pEvent);
+            command.param2 = fluid_midi_event_get_value(pEvent);
+            break;
+        case 0xC0: //PROGRAM_CHANGE
+            command.type = SYNTH_PROGRAM_CHANGE;
+            command.param1 = fluid_midi_event_get_program(pEvent);
+            break;
+        case 0xD0: //CHANNEL_PRESSURE
+            command.type = SYNTH_CHANNEL_PRESSURE;
+            command.param1 = fluid_midi_event_get_program(pEvent);
+            break;
+        case 0xE0: //PITCH_BEND
+            command.type = SYNTH_PITCH_BEND;
+            command.param1 = fluid_midi_event_get_pitch(pEvent);
+            break;
+        case 0xF0: //SYSEX
+        {
+            void* pData;
+            int nSize;
+            if(fluid_midi_event_get_sysex(pEvent, &pData, &nSize) != FLUID_OK || nSize > SYNTH_SYSEX_MAX)
+                return false; // Large SysEx (e.g. bulk tuning dumps) not supported
+            command.type = SYNTH_SYSEX;
+            command.param1 = nSize;
+            memcpy(command.sysex, pData, nSize);
+            break;
+        }
+        case 0xFF: //SYSTEM_RESET
+            command.type = SYNTH_SYSTEM_RESET;
+            break;
+        default:
+            return false;
+        }
+        return TryPush(command);
+    }
+
+    /**	Call a function from the audio thread, e.g. to read synth state safely
+    *	@param	pCallback Function to call
+    *	@param	pData Pointer passed to function
+    *	@param	bWait True to wait for space if queue is full, false to drop and count the call, e.g. from MIDI thread
+    *	@retval	bool True on success
+    */
+    bool Post(void (*pCallback)(fluid_synth_t*, void*), void* pData = NULL, bool bWait = true)
+    {
+        SynthCommand command;
+        command.type = SYNTH_CALLBACK;
+        command.callback = pCallback;
+        command.ptr = pData;
+        return bWait ? Push(command) : TryPush(command);
+    }
+
+    /**	Add a soundfont to the synth and wait for it to be added
+    *	@param	pSoundfont Pointer to soundfont - synth takes ownership on success
+    *	@retval	int fluidsynth soundfont id or FLUID_FAILED on failure
+    *	@note	Call only from UI thread
+    */
+    int AddSoundfont(fluid_sfont_t* pSoundfont)
+    {
+        SynthCommand command;
+        command.type = SYNTH_ADD_SFONT;
+        command.ptr = pSoundfont;
+        return Call(command);
+    }
+
+    /**	Remove a soundfont from the synth without freeing it and wait for it to be removed
+    *	@param	pSoundfont Pointer to soundfont - caller takes ownership
+    *	@note	Call only from UI thread. Voices already playing continue to use the soundfont's samples so free it away from the audio thread, e.g. with SoundfontLoader::Discard.
+    */
+    void RemoveSoundfont(fluid_sfont_t* pSoundfont)
+    {
+        SynthCommand command;
+        command.type = SYNTH_REMOVE_SFONT;
+        command.ptr = pSoundfont;
+        Call(command);
+    }
+
+    /**	Execute queued commands if audio thread is not running
+    *	@note	Call only from UI thread
+    */
+    void Poll()
+    {
+        if(!m_bRunning)
+            Process();
+    }
+
+    /**	Execute all queued commands - call from audio thread at start of each block */
+    void Process()
+    {
+        SynthCommand command;
+        while(m_queue.Pop(command))
+            Execute(command);
+    }
+
+    /**	Get and reset the quantity of commands dropped due to queue being full
+    *	@retval	unsigned int Quantity of dropped commands since last call
+    */
+    unsigned int GetDropped()
+    {
+        return m_nDropped.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    /**	Add a command to the queue, waiting for space if audio thread is running
+    *	@note	Call only from UI thread - use TryPush from threads that must not block
+    */
+    bool Push(const SynthCommand& command)
+    {
+        while(!m_queue.Push(command))
+        {
+            if(!m_bRunning)
+            {
+                m_nDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            usleep(500);
+        }
+        return true;
+    }
+
+    /**	Add a command to the queue without waiting
+    *	@retval	bool True on success, false if queue is full (command is dropped and counted)
+    */
+    bool TryPush(const SynthCommand& command)
+    {
+        if(m_queue.Push(command))
+            return true;
+        m_nDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**	Post a command and wait for it to execute
+    *	@retval	int Result of command
+    */
+    int Call(SynthCommand& command)
+    {
+        SynthCompletion completion;
+        command.completion = &completion;
+        if(!Push(command))
+            return FLUID_FAILED;
+        while(!completion.done.load(std::memory_order_acquire))
+        {
+            if(m_bRunning)
+                usleep(500);
+            else
+                Process();
+        }
+        return completion.result;
+    }
+
+    /**	Apply a command to the synth */
+    void Execute(SynthCommand& command)
+    {
+        int nResult = FLUID_OK;
+        if(!m_pSynth)
+            nResult = FLUID_FAILED;
+        else switch(command.type)
+        {
+        case SYNTH_NOTE_ON:
+            nResult = fluid_synth_noteon(m_pSynth, command.channel, command.param1, command.param2);
+            break;
+        case SYNTH_NOTE_OFF:
+            nResult = fluid_synth_noteoff(m_pSynth, command.channel, command.param1);
+            break;
+        case SYNTH_CC:
+            nResult = fluid_synth_cc(m_pSynth, command.channel, command.param1, command.param2);
+            break;
+        case SYNTH_PROGRAM_CHANGE:
+        {
+            // Several soundfonts may be loaded and fluid_synth_program_change would search newest first so select from channel's soundfont
+            int nSoundfont, nBank, nProgram;
+            nResult = fluid_synth_get_program(m_pSynth, command.channel, &nSoundfont, &nBank, &nProgram);
+            if(nResult == FLUID_OK && fluid_synth_get_sfont_by_id(m_pSynth, nSoundfont))
+                nResult = fluid_synth_program_select(m_pSynth, command.channel, nSoundfont, nBank, command.param1); // Bank is as last set by bank select CC
+            else
+                nResult = fluid_synth_program_change(m_pSynth, command.channel, command.param1); // Channel not yet bound to a soundfont
+            break;
+        }
+        case SYNTH_PROGRAM_SELECT:
+            nResult = fluid_synth_program_select(m_pSynth, command.channel, command.param1, command.param2 >> 8, command.param2 & 0xFF);
+            break;
+        case SYNTH_PITCH_BEND:
+            nResult = fluid_synth_pitch_bend(m_pSynth, command.channel, command.param1);
+            break;
+        case SYNTH_CHANNEL_PRESSURE:
+            nResult = fluid_synth_channel_pressure(m_pSynth, command.channel, command.param1);
+            break;
+        case SYNTH_KEY_PRESSURE:
+            nResult = fluid_synth_key_pressure(m_pSynth, command.channel, command.param1, command.param2);
+            break;
+        case SYNTH_SYSEX:
+            nResult = fluid_synth_sysex(m_pSynth, (const char*)command.sysex, command.param1, NULL, NULL, NULL, 0);
+            break;
+        case SYNTH_SYSTEM_RESET:
+            nResult = fluid_synth_system_reset(m_pSynth);
+            break;
+        case SYNTH_ALL_NOTES_OFF:
+            nResult = fluid_synth_all_notes_off(m_pSynth, command.channel);
+            break;
+        case SYNTH_ALL_SOUNDS_OFF:
+            nResult = fluid_synth_all_sounds_off(m_pSynth, command.channel);
+            break;
+        case SYNTH_GAIN:
+            fluid_synth_set_gain(m_pSynth, command.value);
+            break;
+        case SYNTH_REVERB_ON:
+            fluid_synth_set_reverb_on(m_pSynth, command.param1);
+            break;
+        case SYNTH_REVERB_ROOMSIZE:
+            nResult = fluid_synth_set_reverb_roomsize(m_pSynth, command.value);
+            break;
+        case SYNTH_REVERB_DAMP:
+            nResult = fluid_synth_set_reverb_damp(m_pSynth, command.value);
+            break;
+        case SYNTH_REVERB_WIDTH:
+            nResult = fluid_synth_set_reverb_width(m_pSynth, command.value);
+            break;
+        case SYNTH_REVERB_LEVEL:
+            nResult = fluid_synth_set_reverb_level(m_pSynth, command.value);
+            break;
+        case SYNTH_CHORUS_ON:
+            fluid_synth_set_chorus_on(m_pSynth, command.param1);
+            break;
+        case SYNTH_CHORUS_NR:
+            nResult = fluid_synth_set_chorus_nr(m_pSynth, command.param1);
+            break;
+        case SYNTH_CHORUS_LEVEL:
+            nResult = fluid_synth_set_chorus_level(m_pSynth, command.value);
+            break;
+        case SYNTH_CHORUS_SPEED:
+            nResult = fluid_synth_set_chorus_speed(m_pSynth, command.value);
+            break;
+        case SYNTH_CHORUS_DEPTH:
+            nResult = fluid_synth_set_chorus_depth(m_pSynth, command.value);
+            break;
+        case SYNTH_CHORUS_TYPE:
+            nResult = fluid_synth_set_chorus_type(m_pSynth, command.param1);
+            break;
+        case SYNTH_ADD_SFONT:
+            nResult = fluid_synth_add_sfont(m_pSynth, (fluid_sfont_t*)command.ptr);
+            break;
+        case SYNTH_REMOVE_SFONT:
+        {
+            // fluid_synth_sfunload would free the soundfont in the audio thread (or start a timer thread if voices use it) so only detach it
+            // Detaching resets every channel's program by searching all soundfonts so restore channels using other soundfonts
+            int anSoundfont[16], anBank[16], anProgram[16];
+            for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+                fluid_synth_get_program(m_pSynth, nChannel, &anSoundfont[nChannel], &anBank[nChannel], &anProgram[nChannel]);
+            nResult = fluid_synth_remove_sfont(m_pSynth, (fluid_sfont_t*)command.ptr);
+            if(nResult == FLUID_FAILED)
+                break;
+            for(unsigned int nChannel = 0; nChannel < 16; ++nChannel)
+                if(anSoundfont[nChannel] != nResult)
+                    fluid_synth_program_select(m_pSynth, nChannel, anSoundfont[nChannel], anBank[nChannel], anProgram[nChannel]);
+            nResult = FLUID_OK;
+            break;
+        }
+        case SYNTH_CALLBACK:
+            if(command.callback)
+                command.callback(m_pSynth, command.ptr);
+            break;
+        default:
+            nResult = FLUID_FAILED;
+        }
+        if(command.completion)
+        {
+            command.completion->result = nResult;
+            command.completion->done.store(true, std::memory_order_release);
+        }
+    }
+
+    fluid_synth_t* m_pSynth = NULL; // Synth that commands are applied to
+    std::atomic<bool> m_bRunning = {false}; // True when audio thread is draining queue
+    std::atomic<unsigned int> m_nDropped = {0}; // Quantity of commands dropped since last check
+    MpscRingBuffer<SynthCommand, SYNTH_QUEUE_SIZE> m_queue; // Commands waiting for audio thread
+};
@@ -0,0 +1,119 @@
+/*	Shadow of synth state
+
+	Mirrors values that the UI displays (per-channel controllers, master gain, effect parameters) so they may be read without taking the fluidsynth API lock.
+	Values are written by whichever code path changes the synth (UI, MIDI or audio thread) and read lock-free by the UI.
+*/
+
+#pragma once
+
+#include "fluidsynth.h"
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint8_t
+
+#define SYNTH_STATE_CHANNELS 16 // Quantity of MIDI channels mirrored
+#define SYNTH_STATE_PARAMS 16 // Quantity of application defined parameters mirrored
+
+/**	SynthState class holds a lock-free copy of synth values
+*	@note	Each value is independent - no consistency is guaranteed between values
+*/
+class SynthState
+{
+public:
+    SynthState()
+    {
+        for(unsigned int nChannel = 0; nChannel < SYNTH_STATE_CHANNELS; ++nChannel)
+            for(unsigned int nCC = 0; nCC < 128; ++nCC)
+                m_anCC[nChannel][nCC].store(0, std::memory_order_relaxed);
+        for(unsigned int nParam = 0; nParam < SYNTH_STATE_PARAMS; ++nParam)
+            m_afParams[nParam].store(0, std::memory_order_relaxed);
+    }
+
+    /**	Populate controllers and gain from synth, e.g. at startup or after controller reset
+    *	@param	pSynth Pointer to fluidsynth instance
+    *	@param	nChannel MIDI channel to read or -1 for all channels
+    *	@note	Call only from thread that owns synth, i.e. audio thread (via SynthCommandQueue::Post) or before audio starts
+    */
+    void Sync(fluid_synth_t* pSynth, int nChannel = -1)
+    {
+        if(!pSynth)
+            return;
+        for(unsigned int nChan = 0; nChan < SYNTH_STATE_CHANNELS; ++nChan)
+        {
+            if(nChannel >= 0 && (unsigned int)nChannel != nChan)
+                continue;
+            for(unsigned int nCC = 0; nCC < 128; ++nCC)
+            {
+                int nValue;
+                if(fluid_synth_get_cc(pSynth, nChan, nCC, &nValue) == FLUID_OK)
+                    SetCC(nChan, nCC, nValue);
+            }
+        }
+        if(nChannel < 0)
+            SetGain(fluid_synth_get_gain(pSynth));
+    }
+
+    /**	Set a controller value
+    *	@param	nChannel MIDI channel [0..15]
+    *	@param	nCC MIDI continuous controller [0..127]
+    *	@param	nValue Controller value [0..127]
+    */
+    void SetCC(unsigned int nChannel, unsigned int nCC, unsigned int nValue)
+    {
+        if(nChannel < SYNTH_STATE_CHANNELS && nCC < 128)
+            m_anCC[nChannel][nCC].store(nValue, std::memory_order_relaxed);
+    }
+
+    /**	Get a controller value
+    *	@param	nChannel MIDI channel [0..15]
+    *	@param	nCC MIDI continuous controller [0..127]
+    *	@retval	int Controller value [0..127] or -1 if invalid channel or controller
+    */
+    int GetCC(unsigned int nChannel, unsigned int nCC)
+    {
+        if(nChannel >= SYNTH_STATE_CHANNELS || nCC >= 128)
+            return -1;
+        return m_anCC[nChannel][nCC].load(std::memory_order_relaxed);
+    }
+
+    /**	Set master gain
+    *	@param	fGain Gain
+    */
+    void SetGain(float fGain)
+    {
+        m_fGain.store(fGain, std::memory_order_relaxed);
+    }
+
+    /**	Get master gain
+    *	@retval	float Gain
+    */
+    float GetGain()
+    {
+        return m_fGain.load(std::memory_order_relaxed);
+    }
+
+    /**	Set an application defined parameter, e.g. reverb level
+    *	@param	nParam Index of parameter [0..SYNTH_STATE_PARAMS-1]
+    *	@param	fValue Value
+    */
+    void SetParam(unsigned int nParam, float fValue)
+    {
+        if(nParam < SYNTH_STATE_PARAMS)
+            m_afParams[nParam].store(fValue, std::memory_order_relaxed);
+    }
+
+    /**	Get an application defined parameter
+    *	@param	nParam Index of parameter [0..SYNTH_STATE_PARAMS-1]
+    *	@retval	float Value or 0 if invalid parameter
+    */
+    float GetParam(unsigned int nParam)
+    {
+        if(nParam >= SYNTH_STATE_PARAMS)
+            return 0;
+        return m_afParams[nParam].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint8_t> m_anCC[SYNTH_STATE_CHANNELS][128]; // Controller values indexed by channel, controller
+    std::atomic<float> m_fGain = {0.2f}; // Master gain
+    std::atomic<float> m_afParams[SYNTH_STATE_PARAMS]; // Application defined parameters, e.g. effects
+};
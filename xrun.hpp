@@ -0,0 +1,192 @@
+/*	Audio xrun detection and latency calibration
+
+	XrunMonitor detects buffer underruns by timing the audio callback against the buffer deadline.
+	The driver renders one period per callback and then waits for space in the buffer so consecutive callbacks start one period apart.
+	If the time between callbacks exceeds the whole buffer (period size x periods) the buffer has drained and audio was lost.
+	LatencyCalibration steps the period size down until xruns appear then chooses a size with a safety margin above the failing size.
+*/
+
+#pragma once
+
+#include <algorithm> // provides std::max
+#include <atomic> // provides std::atomic
+#include <cstdint> // provides uint64_t
+
+#define CALIBRATE_START_PERIOD 512 // Period size in frames that calibration starts from
+#define CALIBRATE_MIN_PERIOD 32 // Smallest period size in frames tried by calibration
+#define CALIBRATE_STEP_MS 8000 // Duration each period size is tested for
+#define CALIBRATE_MARGIN 50 // Percent added to the period size that failed to give the chosen period size
+#define CALIBRATE_ALIGN 16 // Period sizes are multiples of this quantity of frames
+
+/**	XrunMonitor class detects and counts audio buffer underruns */
+class XrunMonitor
+{
+public:
+    /**	Configure buffer deadline - call whilst audio is stopped
+    *	@param	nPeriodSize Frames per period
+    *	@param	nPeriods Quantity of periods in audio buffer
+    *	@param	dSampleRate Sample rate in Hz
+    */
+    void SetPeriod(unsigned int nPeriodSize, unsigned int nPeriods, double dSampleRate)
+    {
+        m_nBufferTime = 1000000.0 * nPeriodSize * std::max(nPeriods, 1u) / dSampleRate;
+        m_nLastCallback = 0; // First callback after start may be late
+    }
+
+    /**	Check for xrun - call from audio thread at start of each callback
+    *	@param	nNow Current time in microseconds
+    *	@retval	bool True if the buffer drained since the previous callback
+    */
+    bool Check(uint64_t nNow)
+    {
+        bool bXrun = m_nLastCallback && nNow - m_nLastCallback > m_nBufferTime;
+        m_nLastCallback = nNow;
+        if(!bXrun)
+            return false;
+        m_nDetected.fetch_add(1, std::memory_order_relaxed);
+        if(m_bCounting.load(std::memory_order_relaxed))
+            m_nSession.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**	Enable counting of xruns in session and lifetime totals (disabled whilst xruns are deliberately provoked)
+    *	@param	bCounting True to count xruns
+    */
+    void SetCounting(bool bCounting)
+    {
+        m_bCounting.store(bCounting, std::memory_order_relaxed);
+    }
+
+    /**	Get quantity of xruns detected, including those not counted
+    *	@retval	unsigned int Quantity of xruns since start - compare with a previous value to find new xruns
+    */
+    unsigned int GetDetected()
+    {
+        return m_nDetected.load(std::memory_order_relaxed);
+    }
+
+    /**	Get quantity of xruns this session
+    *	@retval	unsigned int Quantity of counted xruns since start or reset
+    */
+    unsigned int GetSession()
+    {
+        return m_nSession.load(std::memory_order_relaxed);
+    }
+
+    /**	Get quantity of xruns over lifetime of unit
+    *	@retval	uint64_t Quantity of xruns in previous sessions plus this session
+    */
+    uint64_t GetLifetime()
+    {
+        return m_nPrevious + m_nLifetimeSession + GetSession();
+    }
+
+    /**	Set quantity of xruns over lifetime of unit, e.g. from configuration
+    *	@param	nLifetime Quantity of xruns, including any counted this session before it was saved
+    */
+    void SetLifetime(uint64_t nLifetime)
+    {
+        uint64_t nThisSession = m_nLifetimeSession + GetSession();
+        m_nPrevious = (nLifetime > nThisSession) ? nLifetime - nThisSession : 0;
+    }
+
+    /**	Reset session count (lifetime count is retained) */
+    void ResetSession()
+    {
+        m_nLifetimeSession += m_nSession.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    uint64_t m_nBufferTime = 0; // Duration of audio buffer in microseconds
+    uint64_t m_nLastCallback = 0; // Time of previous callback in microseconds (audio thread)
+    std::atomic<bool> m_bCounting = {true}; // True to count xruns in session total
+    std::atomic<unsigned int> m_nDetected = {0}; // Quantity of xruns detected
+    std::atomic<unsigned int> m_nSession = {0}; // Quantity of xruns counted since start or reset
+    uint64_t m_nLifetimeSession = 0; // Quantity of xruns this session before session count was last reset
+    uint64_t m_nPrevious = 0; // Quantity of xruns in previous sessions
+};
+
+/**	LatencyCalibration class chooses the smallest reliable period size */
+class LatencyCalibration
+{
+public:
+    /**	Start calibration
+    *	@param	nPeriodSize Period size to test first
+    */
+    void Start(unsigned int nPeriodSize = CALIBRATE_START_PERIOD)
+    {
+        m_nSize = std::max(nPeriodSize, (unsigned int)CALIBRATE_MIN_PERIOD);
+        m_nLastGood = 0;
+        m_nResult = 0;
+        m_bActive = true;
+    }
+
+    /**	Stop calibration without choosing a period size */
+    void Cancel()
+    {
+        m_bActive = false;
+    }
+
+    /**	Check if calibration is in progress
+    *	@retval	bool True if calibrating
+    */
+    bool IsActive()
+    {
+        return m_bActive;
+    }
+
+    /**	Get period size under test
+    *	@retval	unsigned int Period size in frames
+    */
+    unsigned int GetSize()
+    {
+        return m_nSize;
+    }
+
+    /**	Get chosen period size
+    *	@retval	unsigned int Period size in frames or 0 if calibration has not completed
+    */
+    unsigned int GetResult()
+    {
+        return m_nResult;
+    }
+
+    /**	Record that the period size under test ran without xruns for the test duration
+    *	@retval	bool True if another size should be tested, false if calibration is complete
+    */
+    bool Pass()
+    {
+        if(!m_bActive)
+            return false;
+        m_nLastGood = m_nSize;
+        if(m_nSize <= CALIBRATE_MIN_PERIOD)
+            return Finish();
+        m_nSize = std::max(m_nSize * 3 / 4 / CALIBRATE_ALIGN * CALIBRATE_ALIGN, (unsigned int)CALIBRATE_MIN_PERIOD);
+        return true;
+    }
+
+    /**	Record that an xrun occurred with the period size under test
+    *	@retval	bool Always false - calibration is complete
+    */
+    bool Fail()
+    {
+        if(!m_bActive)
+            return false;
+        return Finish();
+    }
+
+private:
+    /**	Choose period size with safety margin above the smallest size tested */
+    bool Finish()
+    {
+        unsigned int nSize = (m_nSize * (100 + CALIBRATE_MARGIN) / 100 + CALIBRATE_ALIGN - 1) / CALIBRATE_ALIGN * CALIBRATE_ALIGN;
+        m_nResult = std::max(nSize, m_nLastGood);
+        m_bActive = false;
+        return false;
+    }
+
+    unsigned int m_nSize = CALIBRATE_START_PERIOD; // Period size under test
+    unsigned int m_nLastGood = 0; // Smallest period size that passed
+    unsigned int m_nResult = 0; // Chosen period size
+    bool m_bActive = false; // True whilst calibrating
+};